@@ -0,0 +1,159 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file domains.cpp
+\brief runs a scene split across several processes on this machine, each simulating one slab of the world
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "World.h"
+#include "Flock.h"
+#include "Domain.h"
+#include "SceneLoader.h"
+
+/* RunDomain:
+*  ----------
+*	Everything one process does. Every domain loads the whole
+*	scene and keeps its own slab of it.
+*/
+int RunDomain(const char* config, unsigned int frames, unsigned int index, unsigned int numDomains, int left, int right)
+{
+	// Same bounds as the viewer
+	Flock::World world;
+	world.maxX = 60; world.minX = -60;
+	world.maxY = 30; world.minY = -30;
+	world.maxZ = 30; world.minZ = -30;
+
+	Flock::SceneLoader loader(world);
+
+	if(!loader.Load(config))
+	{
+		world.Clear();
+		return 1;
+	}
+
+	Flock::Domain domain(world, index, numDomains, left, right);
+	domain.Partition();
+	world.domain = &domain;
+
+	Imath::V3f centre( 0.0, 0.0, 0.0 );
+
+	unsigned long long ghosts = 0;
+	unsigned long long migrated = 0;
+
+	for(unsigned int f=0; f < frames; ++f)
+	{
+		if(!world.Update( centre ))
+		{
+			std::cout << "Domain " << index << ": stopped at frame " << world.frame << std::endl;
+			break;
+		}
+
+		ghosts += world.stats.ghostBoids;
+		migrated += world.stats.migratedBoids;
+	}
+
+	unsigned int owned = 0;
+	for(unsigned int f=0; f < world.flocks.size(); ++f)
+		owned += world.flocks[f]->boids().size();
+
+	std::cout << "Domain " << index << ": " << owned << " boids, "
+		<< (frames ? double(ghosts) / frames : 0.0) << " ghosts per frame, "
+		<< migrated << " migrated out" << std::endl;
+
+	world.domain = NULL;
+	world.Clear();
+
+	return domain.failed() ? 1 : 0;
+}
+
+// application main loop
+int main(int argc, char **argv)
+{
+	if(argc < 4)
+	{
+		std::cout << "usage " << argv[0] << " [config file] [frames] [domains]" << std::endl;
+		std::cout << "The world is split into [domains] slabs along x, each simulated by its own process" << std::endl;
+		exit(1);
+	}
+
+	unsigned int frames = atoi(argv[2]);
+	unsigned int numDomains = atoi(argv[3]);
+
+	if(numDomains == 0)
+	{
+		std::cout << "Error: there must be at least one domain" << std::endl;
+		exit(1);
+	}
+
+	// One connected pair of sockets for each boundary
+	std::vector<int> sockets(2 * (numDomains - 1));
+
+	for(unsigned int b=0; b + 1 < numDomains; ++b)
+	{
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, &sockets[2*b]) != 0)
+		{
+			std::cout << "Error: unable to create sockets between domains" << std::endl;
+			exit(1);
+		}
+	}
+
+	std::vector<pid_t> children;
+
+	for(unsigned int d=0; d < numDomains; ++d)
+	{
+		pid_t child = fork();
+
+		if(child < 0)
+		{
+			std::cout << "Error: unable to start domain " << d << std::endl;
+			break;
+		}
+
+		if(child == 0)
+		{
+			int left = d > 0 ? sockets[2*(d-1) + 1] : -1;
+			int right = d + 1 < numDomains ? sockets[2*d] : -1;
+
+			for(unsigned int s=0; s < sockets.size(); ++s)
+			{
+				if(sockets[s] != left && sockets[s] != right)
+					close(sockets[s]);
+			}
+
+			_exit(RunDomain(argv[1], frames, d, numDomains, left, right));
+		}
+
+		children.push_back(child);
+	}
+
+	for(unsigned int s=0; s < sockets.size(); ++s)
+		close(sockets[s]);
+
+	int failed = children.size() == numDomains ? 0 : 1;
+
+	for(unsigned int c=0; c < children.size(); ++c)
+	{
+		int status = 0;
+		waitpid(children[c], &status, 0);
+
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed = 1;
+	}
+
+	return failed;
+}
@@ -0,0 +1,68 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file generate.cpp
+\brief writes procedurally generated scene configs for scaling tests
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <string>
+
+#include "SceneGenerator.h"
+
+// application main loop
+int main(int argc, char **argv)
+{
+	if(argc < 2)
+	{
+		std::cout << "usage " << argv[0] << " [output config] [flocks] [boids per flock] [food chain depth]"
+			<< " [objects] [density] [seed] [moving objects] [boid file prefix]" << std::endl;
+		std::cout << "Missing values default to 1 flock of 1000 boids, depth 1, no objects, density 0.05, seed 1, no moving objects" << std::endl;
+		std::cout << "With a boid file prefix each flock's boids are written to a binary file the config loads them from" << std::endl;
+		exit(1);
+	}
+
+	Flock::SceneGenerator::Settings settings;
+
+	if(argc > 2) { settings.numFlocks = atoi(argv[2]); }
+	if(argc > 3) { settings.boidsPerFlock = atoi(argv[3]); }
+	if(argc > 4) { settings.foodChainDepth = atoi(argv[4]); }
+	if(argc > 5) { settings.numObjects = atoi(argv[5]); }
+	if(argc > 6) { settings.density = atof(argv[6]); }
+	if(argc > 7) { settings.seed = strtoul(argv[7], NULL, 10); }
+	if(argc > 8) { settings.numMovingObjects = atoi(argv[8]); }
+
+	std::string boidFilePrefix = argc > 9 ? argv[9] : "";
+
+	if(settings.boidsPerFlock == 0 || settings.density <= 0.0f)
+	{
+		std::cout << "Error: boids per flock and density must be greater than zero" << std::endl;
+		exit(1);
+	}
+
+	std::ofstream config(argv[1], std::ios::out | std::ios::trunc);
+
+	if(!config.is_open())
+	{
+		std::cout << "Unable to write " << argv[1] << std::endl;
+		exit(1);
+	}
+
+	Flock::SceneGenerator generator(settings);
+	if(!generator.Write(config, boidFilePrefix))
+	{
+		std::cout << "Unable to write the boid files" << std::endl;
+		exit(1);
+	}
+
+	return 0;
+}
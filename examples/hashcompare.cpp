@@ -0,0 +1,100 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file hashcompare.cpp
+\brief compares two per-frame hash logs written by World::WriteHashes
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+/* ReadEntry:
+*  ----------
+*	Reads the next "frame flockID hash" line from a log.
+*	Blank lines are skipped.
+*/
+bool ReadEntry(std::ifstream& log, unsigned int& frame, int& flockID, std::string& hash)
+{
+	std::string line;
+
+	while(getline(log, line))
+	{
+		if(line.empty()) { continue; }
+
+		std::istringstream entry(line);
+		if(entry >> frame >> flockID >> hash)
+			return true;
+	}
+
+	return false;
+}
+
+// application main loop
+int main(int argc, char **argv)
+{
+	if(argc < 3)
+	{
+		std::cout << "usage " << argv[0] << " [reference log] [test log]" << std::endl;
+		exit(2);
+	}
+
+	std::ifstream reference(argv[1]);
+	std::ifstream test(argv[2]);
+
+	if(!reference.is_open() || !test.is_open())
+	{
+		std::cout << "File Not Found" << std::endl;
+		exit(2);
+	}
+
+	unsigned int refFrame = 0, testFrame = 0;
+	int refFlock = 0, testFlock = 0;
+	std::string refHash, testHash;
+
+	unsigned int entries = 0;
+
+	while(true)
+	{
+		bool refOk = ReadEntry(reference, refFrame, refFlock, refHash);
+		bool testOk = ReadEntry(test, testFrame, testFlock, testHash);
+
+		if(!refOk && !testOk) { break; }
+
+		if(refOk != testOk)
+		{
+			std::cout << "Logs differ in length: " << (refOk ? argv[2] : argv[1])
+				<< " ends after frame " << (refOk ? testFrame : refFrame) << std::endl;
+			return 1;
+		}
+
+		if(refFrame != testFrame || refFlock != testFlock)
+		{
+			std::cout << "Logs are out of step: frame " << refFrame << " flock " << refFlock
+				<< " against frame " << testFrame << " flock " << testFlock << std::endl;
+			return 1;
+		}
+
+		if(refHash != testHash)
+		{
+			std::cout << "First divergence at frame " << refFrame << " flock " << refFlock
+				<< " (" << refHash << " != " << testHash << ")" << std::endl;
+			return 1;
+		}
+
+		++entries;
+	}
+
+	std::cout << "Logs match (" << entries << " entries)" << std::endl;
+
+	return 0;
+}
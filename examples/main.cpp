@@ -19,6 +19,8 @@
 #include <iomanip>
 #include <cstdlib>
 
+#include <sys/stat.h>
+
 // Custom classes
 #include "Flock.h"
 #include "Boid.h"
@@ -26,6 +28,9 @@
 #include "Goal.h"
 #include "Object.h"
 #include "Particle.h"
+#include "SceneLoader.h"
+#include "BatchRenderer.h"
+#include "Snapshot.h"
 
 // OpenGl and Glut includes for Linux and Mac (Darwin)
 #include <GL/gl.h>
@@ -37,32 +42,34 @@
 // Escape key defined for use in keyboard function
 #define ESCAPE 27
 
-typedef std::vector< Boid* >::iterator BoidIt;
-typedef std::vector< Flock* >::iterator FlockIt;
-
 
 // Screen Dimensions
 int WIDTH = 800;
 int HEIGHT = 600;
 
 std::string Filename;
+std::string CheckpointFilename = "flock.chk";
+
+// Optional per-frame hash log for checking runs are identical
+std::ofstream HashLog;
 
 int Pause = 0;
 bool useflocking = true;
 
-int frame = 0;
+// Reload the flock behaviour whenever the config file changes on disk
+bool watchConfig = true;
+struct stat ConfigStatus;
+bool useBatching = true;
 
-World container;
+Flock::World container;
+Flock::BatchRenderer renderer;
 
-// Vector containers for the Flocks and Boids used in the system
-std::vector<Flock*> flocks;
-std::vector<Boid*> boids;
+// Optional shared memory that other processes can watch the boids through
+Flock::SnapshotPublisher snapshot;
 	
 // CurveFollow *targetCurve;
 // Goal target(container);
 
-std::vector<Object*> objects;
-
 // 
 //  Cam;
 // enum CAMMODE{MOVEEYE,MOVELOOK,MOVEBOTH,MOVESLIDE};
@@ -98,8 +105,8 @@ void Display()
 		container.DrawGround();
 		// targetCurve->DrawCurve();
 		
-		std::vector<Object*>::iterator currentObject = objects.begin();
-		std::vector<Object*>::iterator endObject = objects.end();
+		std::vector<Flock::Object*>::iterator currentObject = container.objects.begin();
+		std::vector<Flock::Object*>::iterator endObject = container.objects.end();
 
 		glBegin( GL_POINTS );
 			glVertex3f( 0.0, 0.0, 0.0 );
@@ -112,14 +119,24 @@ void Display()
 			++currentObject;
 		}
 
-		std::vector<Flock*>::iterator currentFlock = flocks.begin();
-		std::vector<Flock*>::iterator endFlock = flocks.end();
-	
-		// Cycle through all the flocks and call the draw methods for each one
-		while(currentFlock != endFlock)
+		container.movingObjects.Draw(container.minY);
+
+		if(useBatching && renderer.initialised())
 		{
-			(*currentFlock)->Draw();
-			++currentFlock;
+			// All boids, shadows and particles in a few instanced draws
+			renderer.Draw(container);
+		}
+		else
+		{
+			std::vector<Flock::Flock*>::iterator currentFlock = container.flocks.begin();
+			std::vector<Flock::Flock*>::iterator endFlock = container.flocks.end();
+		
+			// Cycle through all the flocks and call the draw methods for each one
+			while(currentFlock != endFlock)
+			{
+				(*currentFlock)->Draw();
+				++currentFlock;
+			}
 		}
 	
 	glPopMatrix();
@@ -127,29 +144,44 @@ void Display()
 	glutSwapBuffers();
 }
 
+/* CheckConfigFile:
+*  -------
+*	Reloads the flock behaviour if the config file has been
+*	saved since it was last read. The boids carry on from
+*	where they are.
+*/
+void CheckConfigFile()
+{
+	struct stat status;
+
+	if(!watchConfig || stat(Filename.c_str(), &status) != 0) { return; }
+
+	if(status.st_mtime == ConfigStatus.st_mtime && status.st_size == ConfigStatus.st_size
+		&& status.st_ino == ConfigStatus.st_ino)
+		return;
+
+	ConfigStatus = status;
+
+	Flock::SceneLoader loader(container);
+	loader.ReloadBehaviour(Filename);
+}
+
 /* Update:
 *  -------
 *	Runs update function for flock and goal.
 */
 void Update(int i)
 {
-	std::vector<Flock*>::iterator currentFlock = flocks.begin();
-	std::vector<Flock*>::iterator endFlock = flocks.end();
+	// Between steps, so the flocks never see half a reload
+	CheckConfigFile();
 
 	if(!Pause) {
 
 		// target.Update();
 		
-		//Cycle through the flocks calling the appropriate behaviours and finally the Update method.
-		while(currentFlock != endFlock)
-		{
-			Imath::V3f centre( 0.0, 0.0, 0.0 );
-			(*currentFlock)->Update( centre );
-			// (*currentFlock)->OBJExport(frame);
-			++currentFlock;
-			
-		}
-		++frame;
+		// Update all the flocks in the world and advance the frame.
+		Imath::V3f centre( 0.0, 0.0, 0.0 );
+		container.Update( centre );
 		
 	}
 	
@@ -171,55 +203,14 @@ void CreateWorld(float px, float nx, float py, float ny, float pz, float nz)
 	container.minZ = nz;
 }
 
-/* CreateObject:
-*  -------------
-*	Creates objects in the scene.
-*/
-void CreateObject(float x, float y, float z)
-{
-	Object* newObject = new Object(container, x, y, z);
-	objects.push_back(newObject);
-}
-
-
 /* cleanup:
 *  -------
 *	Sorts out memory management for the program. Must be called before exiting.
 */
 void cleanup() {
-	{
-		std::vector<Boid*>::iterator itBoid = boids.begin();
-		std::vector<Boid*>::iterator endBoid = boids.end();
-		for(; itBoid != endBoid; ++itBoid)
-		{
-			delete (*itBoid);
-		}
-		boids.clear();
-	}
-	{
-		std::vector<Flock*>::iterator itFlock = flocks.begin();
-		std::vector<Flock*>::iterator endFlock = flocks.end();
-		
-		std::vector<Particle*>::iterator itPart;
-		std::vector<Particle*>::iterator endPart;
-		
-		for(; itFlock != endFlock; ++itFlock)
-		{
-			itPart = (*itFlock)->particles.begin();
-			endPart = (*itFlock)->particles.end();
-			
-			for(; itPart != endPart; ++itPart)
-			{
-				delete (*itPart);
-			}
-				
-			delete (*itFlock);
-		}
-		flocks.clear();
-		
-		container.flocks.clear();
-		container.objects.clear();
-	}
+
+	// The world owns the flocks and objects, and the flocks own their boids.
+	container.Clear();
 }
 
 /* SetTargetPath:
@@ -241,229 +232,17 @@ void SetTargetPath()
 }
 
 
-/* CreateFlock:
-*  ------------
-*	Creates a flock and populates it with the correct number of boids
-*/
-void CreateFlock(int flockID, int numBoids, double x, double y, double z, double spread)
-{
-
-	Flock* newFlock = new Flock(flockID, container);
-	
-	newFlock->numMembers = numBoids;
-	
-	Boid* newBoid = NULL;
-	for(int b=0; b < numBoids; ++b)
-	{
-		newBoid = new Boid(b, flockID, x, y, z, spread);
-		boids.push_back(newBoid);
-	}
-
-	std::vector<Boid*>::iterator currentBoid = boids.begin();
-	std::vector<Boid*>::iterator endBoid = boids.end();
-		
-	while(currentBoid != endBoid)
-	{
-		if(newFlock->flockID == (*currentBoid)->flockID)
-		{
-			newFlock->AddBoid(*currentBoid);
-		}
-		
-		++currentBoid;
-	}
-	
-	flocks.push_back(newFlock);
-
-}
-
-
-/* Update:
-*  -------
-*	Adds all flocks and objects to the STL vectors in the world (container).
-*/
-void CompleteFlocks()
-{
-
-	std::vector<Object*>::iterator currentObject = objects.begin();
-	std::vector<Object*>::iterator endObject = objects.end();
-	
-	while(currentObject != endObject)
-	{
-		container.AddObject((*currentObject));
-
-		++currentObject;
-	}
-
-	FlockIt currentFlock = flocks.begin();
-	FlockIt endFlock = flocks.end();
-
-	while(currentFlock != endFlock)
-	{
-		container.AddFlock((*currentFlock));
-
-		++currentFlock;
-	}
-}
-
-
-/* Tokenize modified from 
-http://oopweb.com/CPP/Documents/CPPHOWTO/Volume/C++Programming-HOWTO-7.html
-C++ Programming HOW-TO
-Al Dev (Alavoor Vasudevan) alavoor[AT]yahoo.com
-v42.9, 17 Sep 2002
-*/
-void Tokenize(const std::string& str, std::vector< std::string >& tokens, const std::string& delimiters = " ")
-{
-	// Skip delimiters at beginning.
-	std::string::size_type lastPos = str.find_first_not_of(delimiters, 0);
-	// Find first "non-delimiter".
-	std::string::size_type pos = str.find_first_of(delimiters, lastPos);
-
-	while( std::string::npos != pos || std::string::npos != lastPos)
-	{
-		// Found a token, add it to the vector.
-		tokens.push_back(str.substr(lastPos, pos - lastPos));
-		// Skip delimiters.  Note the "not_of"
-		lastPos = str.find_first_not_of(delimiters, pos);
-		// Find next "non-delimiter"
-		pos = str.find_first_of(delimiters, lastPos);
-	}
-}
-
 /* ParseConfigFile:
 *  -------
-*	Parses the config file.
+*	Parses the config file straight into the world.
 */
 bool ParseConfigFile()
 {
-	std::fstream FileIn;
-	std::vector< std::string > tokens;
-	
-	// open the file and check to see if it was ok
-	FileIn.open(Filename.c_str(), std::ios::in);
-
-	if (!FileIn.is_open())
-	{
-		std::cout <<"File Not Found"<<std::endl;
-		return false;
-	}
-
-	int flockID = 1;
-	Flock *lastFlock = NULL;
-	
-	// this is the buffer which holds the current line from the file
-	std::string LineBuffer;
-	// now loop till end of the file and parse
-	while(!FileIn.eof())
-	{
-		// get the line in
-		getline(FileIn,LineBuffer,'\n');
-		// then clear the tokens list and tokenize them
-		tokens.clear();
-		
+	stat(Filename.c_str(), &ConfigStatus);
 
-		if(LineBuffer != "")
-		{ 
-			// now create the token list
-			Tokenize(LineBuffer, tokens," \t\n");	
+	Flock::SceneLoader loader(container);
 	
-			// now check for the entries to parse using ==
-			// look for the 
-			if(tokens[0] == "BeginFlocks") { continue; }
-			else if(tokens[0] == "StartFlock")
-			{
-				if(atoi(tokens[1].c_str()) == 0)
-				{
-					std::cout << "Error: Flock of zero size has been specified. Please specify a non-zero size." << std::endl;
-					cleanup();
-					exit(0);
-				}
-				CreateFlock(flockID, atoi(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()), atof(tokens[4].c_str()), atof(tokens[5].c_str()));
-					
-				lastFlock = flocks.back();
-			}
-			else if(tokens[0] == "EndFlock")
-			{
-				++flockID;
-			}
-			else if(tokens[0] == "EndFlocks")
-			{
-				
-			}
-			else if(tokens[0] == "FlockColour") {
-				(*lastFlock).colour.r = atof(tokens[1].c_str());
-				(*lastFlock).colour.g = atof(tokens[2].c_str());
-				(*lastFlock).colour.b = atof(tokens[3].c_str());
-				(*lastFlock).colour.a = atof(tokens[4].c_str());
-			}
-			
-			else if(tokens[0] == "FoodChain") { lastFlock->rank = atoi(tokens[1].c_str()); }
-			
-			else if(tokens[0] == "BankingDepth") { lastFlock->bDepth = atoi(tokens[1].c_str()); }
-			else if(tokens[0] == "BankingScale") { lastFlock->bScale = atoi(tokens[1].c_str()); }
-
-			else if(tokens[0] == "MaxHunt") { lastFlock->maxHunt = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleHunt") { lastFlock->scaleHunt = atof(tokens[1].c_str()); }
-			
-			else if(tokens[0] == "MaxFlee") { lastFlock->maxFlee = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleFlee") { lastFlock->scaleFlee = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "FleeTestRadius") { lastFlock->fleeTR = atof(tokens[1].c_str()); }
-			
-			else if(tokens[0] == "MaxVelocity") { lastFlock->maxVel = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "MinVelocity") { (*lastFlock).minVel = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "MaxAcceleration") { (*lastFlock).maxAcc = atof(tokens[1].c_str()); }
-	
-			else if(tokens[0] == "MaxCollisionAvoidance") { (*lastFlock).maxCA = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleCollisionAvoidance") { (*lastFlock).scaleCA = atof(tokens[1].c_str()); }
-
-			else if(tokens[0] == "MaxVelocityMatching") { (*lastFlock).maxVM = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleVelocityMatching") { (*lastFlock).scaleVM = atof(tokens[1].c_str()); }
-
-			else if(tokens[0] == "MaxGoalCentring") { (*lastFlock).maxGoalFC = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleGoalCentring") { (*lastFlock).scaleGoalFC = atof(tokens[1].c_str()); }
-
-			else if(tokens[0] == "MaxLocalFlockCentring") { (*lastFlock).maxLocalFC = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleLocalFlockCentring") { (*lastFlock).scaleLocalFC = atof(tokens[1].c_str()); }
-
-			else if(tokens[0] == "MaxGlobalFlockCentring") { (*lastFlock).maxGlobalFC = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleGlobalFlockCentring") { (*lastFlock).scaleGlobalFC = atof(tokens[1].c_str()); }
-
-			else if(tokens[0] == "MaxObjectAvoidance") { (*lastFlock).maxOA = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ScaleObjectAvoidance") { (*lastFlock).scaleOA = atof(tokens[1].c_str()); }
-	
-			else if(tokens[0] == "BoidTestRadius") { (*lastFlock).boidTR = atof(tokens[1].c_str()); }
-			else if(tokens[0] == "ObjectTestRadius") { (*lastFlock).objectTR = atof(tokens[1].c_str()); }
-
-			else if(tokens[0] == "StartObject") 
-			{ 
-				CreateObject(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()));
-			}
-			
-			else if(tokens[0] == "EndObject") 
-			{ 
-				
-			}
-
-			else if(tokens[0] == "CreateWorld") 
-			{ 
-				CreateWorld(atof(tokens[1].c_str()), atof(tokens[2].c_str()), atof(tokens[3].c_str()), atof(tokens[4].c_str()), atof(tokens[5].c_str()), atof(tokens[6].c_str()));
-			}			
-			
-			
-			else if(tokens[0] == "//") { /* ignore comments */ }
-
-			else 
-			{ 
-				std::cout <<"Unknown token "<<tokens[0]<<std::endl;
-			}
-		}
-	}
-
-	CompleteFlocks();
-	
-	FileIn.close();
-		
-	return true;
+	return loader.Load(Filename);
 }
 
 
@@ -497,12 +276,6 @@ void MouseMotion(int x, int y)
 
 void Keyboard(unsigned char ch, int x, int y) 
 {
-	std::vector<Flock*>::iterator currentFlock = flocks.begin();
-	std::vector<Flock*>::iterator endFlock = flocks.end();
-
-	std::vector<Boid*>::iterator currentBoid= boids.begin();
-	std::vector<Boid*>::iterator endBoid = boids.end();
-
 	switch(ch)
 	{
 		case ESCAPE: 
@@ -525,6 +298,27 @@ void Keyboard(unsigned char ch, int x, int y)
 				Pause = 0;
 		break;
 
+		case 'i':
+		case 'I':
+			useBatching ^= true;
+		break;
+
+		case 'c':
+		case 'C':
+			container.SaveCheckpoint(CheckpointFilename);
+		break;
+
+		case 'r':
+		case 'R':
+			container.LoadCheckpoint(CheckpointFilename);
+		break;
+
+		case 'w':
+		case 'W':
+			watchConfig ^= true;
+			std::cout << (watchConfig ? "Watching " : "Stopped watching ") << Filename << std::endl;
+		break;
+
 		case ' ':
 			// Cycle through the flocks calling the appropriate behaviours and finally the Update method.
 			cleanup();
@@ -689,12 +483,26 @@ int main(int argc, char **argv)
 {
 	if(argc < 2)
 	{
-		std::cout <<"usage " << argv[0] << " [config file]"<<std::endl;
+		std::cout <<"usage " << argv[0] << " [config file] [hash log] [snapshot name]"<<std::endl;
+		std::cout <<"Use - for no hash log. Each frame is published to the shared memory [snapshot name] if given"<<std::endl;
+		std::cout <<"Saving the config file reloads the flock behaviour settings in place, w turns this on and off"<<std::endl;
 		exit(1);
 	}
 
 	// Create default world.
 	CreateWorld(60, -60, 30, -30, 30, -30);
+
+	if(argc > 2 && std::string(argv[2]) != "-")
+	{
+		HashLog.open(argv[2], std::ios::out | std::ios::trunc);
+		container.hashLog = &HashLog;
+	}
+
+	// Eight frames of up to 4096 boids
+	if(argc > 3 && snapshot.Open(argv[3], 8, 4096))
+	{
+		container.snapshot = &snapshot;
+	}
 	
 	SetTargetPath();
 	
@@ -715,8 +523,17 @@ int main(int argc, char **argv)
 
 	InitialiseGL();
 
+	if(!renderer.Initialise())
+	{
+		std::cout << "Falling back to immediate mode drawing" << std::endl;
+	}
+
 	Filename = argv[1];
-	ParseConfigFile();	
+	if(!ParseConfigFile())
+	{
+		cleanup();
+		exit(1);
+	}
 
 	glutMainLoop();
 	
@@ -0,0 +1,89 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file render.cpp
+\brief runs a scene with no display and writes what the viewer would show as an image sequence
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "World.h"
+#include "SceneLoader.h"
+#include "OffscreenRenderer.h"
+
+// application main loop
+int main(int argc, char **argv)
+{
+	if(argc < 4)
+	{
+		std::cout << "usage " << argv[0] << " [config file] [frames] [output prefix] [width] [height] [every nth frame]" << std::endl;
+		std::cout << "Images are 640 by 480 by default and written as [output prefix].0001.ppm onwards" << std::endl;
+		exit(1);
+	}
+
+	unsigned int frames = atoi(argv[2]);
+	std::string prefix = argv[3];
+	unsigned int width = argc > 4 ? atoi(argv[4]) : 640;
+	unsigned int height = argc > 5 ? atoi(argv[5]) : 480;
+	unsigned int every = argc > 6 ? atoi(argv[6]) : 1;
+
+	if(width == 0 || height == 0 || every == 0)
+	{
+		std::cout << "Error: width, height and frame step must be greater than zero" << std::endl;
+		exit(1);
+	}
+
+	// Same bounds as the viewer
+	Flock::World world;
+	world.maxX = 60; world.minX = -60;
+	world.maxY = 30; world.minY = -30;
+	world.maxZ = 30; world.minZ = -30;
+
+	Flock::SceneLoader loader(world);
+
+	if(!loader.Load(argv[1]))
+	{
+		world.Clear();
+		exit(1);
+	}
+
+	Flock::OffscreenRenderer renderer(width, height);
+
+	if(!renderer.Start(prefix))
+	{
+		world.Clear();
+		exit(1);
+	}
+
+	Imath::V3f centre( 0.0, 0.0, 0.0 );
+
+	// The world is copied on this thread and drawn on the renderer's, so the
+	// next updates overlap with the drawing of the last frame
+	for(unsigned int f=1; f <= frames; ++f)
+	{
+		world.Update( centre );
+
+		if(f % every == 0)
+			renderer.Submit(world, f);
+	}
+
+	renderer.Stop();
+
+	std::cout << renderer.framesWritten() << " images written";
+	if(renderer.framesFailed())
+		std::cout << ", " << renderer.framesFailed() << " failed";
+	std::cout << std::endl;
+
+	world.Clear();
+
+	return renderer.framesFailed() ? 1 : 0;
+}
@@ -0,0 +1,397 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file rendercompare.cpp
+\brief draws a scene with the per-boid immediate mode Draw methods and again with BatchRenderer,
+	in a surfaceless EGL context with no window or display, and reports how far the images differ
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+#include <GL/glut.h>
+
+#include "World.h"
+#include "Flock.h"
+#include "SceneLoader.h"
+#include "BatchRenderer.h"
+
+/*! Largest difference in any channel, out of 255, for two pixels to count as the same colour */
+const int Tolerance = 8;
+
+/* glutSolidCone:
+*  --------------
+*	GLUT can't be initialised without an X display, so the
+*	two solid shapes the Draw methods use are drawn here the
+*	way freeglut builds them. The side normals are shared at
+*	each corner, as freeglut has them, so the boid's sides are
+*	smooth shaded where the batched mesh is flat.
+*/
+void glutSolidCone(double base, double height, GLint slices, GLint stacks)
+{
+	if(slices < 1 || stacks < 1) { return; }
+
+	double slant = std::sqrt(base * base + height * height);
+	float cosn = height / slant;
+	float sinn = base / slant;
+	double step = -2.0 * M_PI / slices;
+
+	glBegin(GL_TRIANGLE_FAN);
+		glNormal3f(0.0f, 0.0f, -1.0f);
+		glVertex3f(0.0f, 0.0f, 0.0f);
+		for(int j=slices; j >= 0; --j)
+			glVertex3f(std::cos(step * j) * base, std::sin(step * j) * base, 0.0f);
+	glEnd();
+
+	for(int i=0; i < stacks; ++i)
+	{
+		double r0 = base * (stacks - i) / stacks;
+		double r1 = base * (stacks - i - 1) / stacks;
+		double z0 = height * i / stacks;
+		double z1 = height * (i + 1) / stacks;
+
+		glBegin(GL_QUAD_STRIP);
+			for(int j=0; j <= slices; ++j)
+			{
+				float c = std::cos(step * j);
+				float s = std::sin(step * j);
+
+				glNormal3f(c * cosn, s * cosn, sinn);
+				glVertex3f(c * r0, s * r0, z0);
+				glVertex3f(c * r1, s * r1, z1);
+			}
+		glEnd();
+	}
+}
+
+
+/* glutSolidSphere:
+*  ----------------
+*	Bands of quads from pole to pole, with the normals
+*	pointing out from the centre.
+*/
+void glutSolidSphere(double radius, GLint slices, GLint stacks)
+{
+	if(slices < 1 || stacks < 1) { return; }
+
+	double slice = -2.0 * M_PI / slices;
+	double stack = M_PI / stacks;
+
+	for(int i=0; i < stacks; ++i)
+	{
+		glBegin(GL_QUAD_STRIP);
+			for(int j=0; j <= slices; ++j)
+			{
+				for(int k=i; k <= i + 1; ++k)
+				{
+					float x = std::cos(slice * j) * std::sin(stack * k);
+					float y = std::sin(slice * j) * std::sin(stack * k);
+					float z = std::cos(stack * k);
+
+					glNormal3f(x, y, z);
+					glVertex3f(x * radius, y * radius, z * radius);
+				}
+			}
+		glEnd();
+	}
+}
+
+
+/* CreateContext:
+*  --------------
+*	Makes a compatibility profile context current with no
+*	surface at all, through Mesa's surfaceless platform, so
+*	the comparison runs on machines without a display.
+*/
+bool CreateContext(EGLDisplay& display, EGLContext& context)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+	if(!getPlatformDisplay)
+	{
+		std::cout << "Error: EGL platform displays are not available" << std::endl;
+		return false;
+	}
+
+	display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+	EGLint major = 0, minor = 0;
+
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cout << "Error: no surfaceless EGL display" << std::endl;
+		return false;
+	}
+
+	EGLint attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE };
+
+	if(!eglBindAPI(EGL_OPENGL_API)
+		|| (context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes)) == EGL_NO_CONTEXT)
+	{
+		std::cout << "Error: unable to create an OpenGL 3.3 compatibility context" << std::endl;
+		eglTerminate(display);
+		return false;
+	}
+
+	if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::cout << "Error: unable to make the context current without a surface" << std::endl;
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+		return false;
+	}
+
+	return true;
+}
+
+
+/* CreateTarget:
+*  -------------
+*	With no surface, everything is drawn into a framebuffer
+*	object with colour and depth renderbuffers.
+*/
+bool CreateTarget(unsigned int width, unsigned int height)
+{
+	GLuint framebuffer, colour, depth;
+
+	glGenRenderbuffers(1, &colour);
+	glBindRenderbuffer(GL_RENDERBUFFER, colour);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Error: unable to create a " << width << " by " << height << " framebuffer" << std::endl;
+		return false;
+	}
+
+	glViewport(0, 0, width, height);
+
+	return true;
+}
+
+
+/* InitialiseGL:
+*  -------------
+*	The same state the viewer sets up, so both paths light
+*	and project the boids as they would on screen.
+*/
+void InitialiseGL(unsigned int width, unsigned int height)
+{
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glShadeModel(GL_SMOOTH);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHT0);
+
+	GLfloat AmbColour[]={0.2,0.2,0.2};
+	glLightModelfv(GL_LIGHT_MODEL_AMBIENT,AmbColour);
+
+	glMatrixMode(GL_MODELVIEW);
+	gluPerspective( 45, double(width) / height, 0.5, 150 );
+	gluLookAt( 30.0, 30.0, 30.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 );
+
+	glEnable(GL_LIGHTING);
+	glEnable(GL_COLOR_MATERIAL);
+	glColorMaterial(GL_FRONT,GL_AMBIENT_AND_DIFFUSE);
+}
+
+
+/* ReadImage:
+*  ----------
+*	Reads back the framebuffer as rows of RGB, top row first.
+*/
+void ReadImage(unsigned int width, unsigned int height, std::vector<unsigned char>& image)
+{
+	std::vector<unsigned char> rows(width * height * 3);
+
+	glFinish();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &rows[0]);
+
+	image.resize(rows.size());
+
+	for(unsigned int y=0; y < height; ++y)
+		std::copy(rows.begin() + (height - 1 - y) * width * 3, rows.begin() + (height - y) * width * 3, image.begin() + y * width * 3);
+}
+
+
+bool WritePPM(const std::string& filename, unsigned int width, unsigned int height, const std::vector<unsigned char>& image)
+{
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if(!out.is_open())
+	{
+		std::cout << "Unable to write " << filename << std::endl;
+		return false;
+	}
+
+	out << "P6\n" << width << " " << height << "\n255\n";
+	out.write(reinterpret_cast<const char*>(&image[0]), image.size());
+
+	return out.good();
+}
+
+
+// application main loop
+int main(int argc, char **argv)
+{
+	if(argc < 3)
+	{
+		std::cout << "usage " << argv[0] << " [config file] [frames] [output prefix] [width] [height] [allowed percent]" << std::endl;
+		std::cout << "Runs the scene for the given frames, then draws it with the immediate mode Draw methods and with"
+			<< " BatchRenderer. The exit status is 1 if more than the allowed percent of the pixels drawn, 1 by default,"
+			<< " are drawn by only one of them" << std::endl;
+		std::cout << "Pixels whose colour differs by more than " << Tolerance << " out of 255 are counted too. GLUT smooth"
+			<< " shades the sides of the boids where the batched boids are flat, so these are reported but not checked" << std::endl;
+		std::cout << "Use - as the prefix to write no images, otherwise [output prefix].fixed.ppm, .batch.ppm and"
+			<< " .diff.ppm are written. Images are 640 by 480 by default" << std::endl;
+		exit(2);
+	}
+
+	unsigned int frames = atoi(argv[2]);
+	std::string prefix = argc > 3 ? argv[3] : "-";
+	unsigned int width = argc > 4 ? atoi(argv[4]) : 640;
+	unsigned int height = argc > 5 ? atoi(argv[5]) : 480;
+	double allowed = argc > 6 ? atof(argv[6]) : 1.0;
+
+	if(width == 0 || height == 0)
+	{
+		std::cout << "Error: width and height must be greater than zero" << std::endl;
+		exit(2);
+	}
+
+	// Same bounds as the viewer
+	Flock::World world;
+	world.maxX = 60; world.minX = -60;
+	world.maxY = 30; world.minY = -30;
+	world.maxZ = 30; world.minZ = -30;
+
+	Flock::SceneLoader loader(world);
+
+	if(!loader.Load(argv[1]))
+	{
+		world.Clear();
+		exit(2);
+	}
+
+	Imath::V3f centre( 0.0, 0.0, 0.0 );
+
+	for(unsigned int f=0; f < frames; ++f)
+		world.Update( centre );
+
+	EGLDisplay display;
+	EGLContext context;
+
+	if(!CreateContext(display, context))
+	{
+		world.Clear();
+		exit(2);
+	}
+
+	int status = 2;
+
+	{
+		Flock::BatchRenderer renderer;
+
+		if(CreateTarget(width, height) && renderer.Initialise())
+		{
+			InitialiseGL(width, height);
+
+			std::vector<unsigned char> fixed, batch;
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			for(unsigned int k=0; k < world.flocks.size(); ++k)
+				world.flocks[k]->Draw();
+
+			ReadImage(width, height, fixed);
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			renderer.Draw(world);
+			ReadImage(width, height, batch);
+
+			// Each pixel's largest channel difference, and whether only one image drew anything there.
+			// The difference image is red where the colours differ and green where only one drew
+			std::vector<unsigned char> diff(fixed.size(), 0);
+			unsigned int differing = 0, uncovered = 0, drawn = 0;
+			int largest = 0;
+
+			for(unsigned int p=0; p < width * height; ++p)
+			{
+				const unsigned char* a = &fixed[p * 3];
+				const unsigned char* b = &batch[p * 3];
+
+				int difference = std::max(std::abs(a[0] - b[0]), std::max(std::abs(a[1] - b[1]), std::abs(a[2] - b[2])));
+				bool inFixed = a[0] || a[1] || a[2];
+				bool inBatch = b[0] || b[1] || b[2];
+
+				if(inFixed || inBatch) { ++drawn; }
+				if(inFixed != inBatch) { ++uncovered; }
+
+				if(difference > Tolerance)
+				{
+					++differing;
+					diff[p * 3] = inFixed == inBatch ? 255 : 0;
+					diff[p * 3 + 1] = inFixed == inBatch ? 0 : 255;
+				}
+
+				largest = std::max(largest, difference);
+			}
+
+			double percent = drawn ? 100.0 * uncovered / drawn : 0.0;
+
+			std::cout << drawn << " pixels drawn, " << uncovered << " (" << percent << "%) by only one path, "
+				<< differing << " differ in colour by more than " << Tolerance << ", largest difference " << largest
+				<< ", " << renderer.drawCalls() << " instanced draws" << std::endl;
+
+			if(prefix != "-")
+			{
+				WritePPM(prefix + ".fixed.ppm", width, height, fixed);
+				WritePPM(prefix + ".batch.ppm", width, height, batch);
+				WritePPM(prefix + ".diff.ppm", width, height, diff);
+			}
+
+			status = percent > allowed ? 1 : 0;
+		}
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+
+	world.Clear();
+
+	return status;
+}
@@ -0,0 +1,447 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file scaling.cpp
+\brief measures how World::Update scales with boid count, spread, flock count and threads, or
+	how far the batch integrator strays from the per-boid update
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "World.h"
+#include "Boid.h"
+#include "SceneGenerator.h"
+
+/*! Measurements from a single run, passed back from the child process */
+struct Result
+{
+	bool ok;
+	double seconds;
+	double nsPerBoidStep;
+	double neighbourTestsPerFrame;
+	double objectTestsPerFrame;
+	long peakRSS;
+
+	/*! Largest scratch arena in bytes, and the heap allocations the arenas made after the warm up */
+	unsigned long long arenaPeak;
+	unsigned long long arenaHeapAllocations;
+
+	/*! Largest difference in any boid's position, and in its velocity relative to its speed, after
+		a step of the batch integrator against the per-boid update from the same state */
+	double positionDifference;
+	double velocityDifference;
+};
+
+/*! One point in the sweep */
+struct Run
+{
+	unsigned int boids;
+	float spread;
+	unsigned int flocks;
+	unsigned int threads;
+};
+
+unsigned int Frames = 10;
+unsigned int Warmup = 2;
+unsigned int Objects = 0;
+unsigned int MovingObjects = 0;
+bool Json = false;
+bool Compare = false;
+bool Verlet = false;
+
+
+/* ParseList:
+*  ----------
+*	Splits a comma separated list of numbers.
+*/
+template< typename T >
+std::vector< T > ParseList(const char* text)
+{
+	std::vector< T > values;
+	std::istringstream list(text);
+	std::string item;
+
+	while(getline(list, item, ','))
+	{
+		if(!item.empty())
+			values.push_back(T(atof(item.c_str())));
+	}
+
+	return values;
+}
+
+
+double Now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+
+/* Measure:
+*  --------
+*	Builds the scene for a run and times a fixed number of
+*	world updates after a short warm up.
+*/
+Result Measure(const Run& run)
+{
+	Result result;
+	memset(&result, 0, sizeof(result));
+
+#ifdef _OPENMP
+	omp_set_num_threads(run.threads);
+#endif
+
+	Flock::SceneGenerator::Settings settings;
+	settings.numFlocks = run.flocks;
+	settings.boidsPerFlock = run.boids / run.flocks;
+	settings.numObjects = Objects;
+	settings.numMovingObjects = MovingObjects;
+	settings.spread = run.spread;
+
+	if(settings.boidsPerFlock == 0) { return result; }
+
+	Flock::World world;
+	Flock::SceneGenerator(settings).Generate(world);
+
+	if(Verlet) { world.integrator = Flock::World::VelocityVerlet; }
+
+	Imath::V3f target(0.0f, 0.0f, 0.0f);
+
+	for(unsigned int f=0; f < Warmup; ++f)
+		world.Update(target);
+
+	Flock::World::Stats total;
+
+	double start = Now();
+
+	for(unsigned int f=0; f < Frames; ++f)
+	{
+		world.Update(target);
+
+		total.boidSteps += world.stats.boidSteps;
+		total.neighbourTests += world.stats.neighbourTests;
+		total.objectTests += world.stats.objectTests;
+		total.arenaPeak = std::max(total.arenaPeak, world.stats.arenaPeak);
+		total.arenaHeapAllocations += world.stats.arenaHeapAllocations;
+	}
+
+	result.seconds = Now() - start;
+
+	world.Clear();
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	result.ok = true;
+	result.nsPerBoidStep = total.boidSteps ? result.seconds * 1e9 / total.boidSteps : 0.0;
+	result.neighbourTestsPerFrame = double(total.neighbourTests) / Frames;
+	result.objectTestsPerFrame = double(total.objectTests) / Frames;
+	result.peakRSS = usage.ru_maxrss;
+	result.arenaPeak = total.arenaPeak;
+	result.arenaHeapAllocations = total.arenaHeapAllocations;
+
+	return result;
+}
+
+
+/* CompareIntegrators:
+*  -------------------
+*	Before every frame the world is checkpointed and loaded
+*	into a second world that uses the batch integrator. Both
+*	are stepped once and every boid compared, so each frame
+*	measures a single step from the same state rather than
+*	two runs drifting apart.
+*/
+Result CompareIntegrators(const Run& run)
+{
+	Result result;
+	memset(&result, 0, sizeof(result));
+
+#ifdef _OPENMP
+	omp_set_num_threads(run.threads);
+#endif
+
+	Flock::SceneGenerator::Settings settings;
+	settings.numFlocks = run.flocks;
+	settings.boidsPerFlock = run.boids / run.flocks;
+	settings.numObjects = Objects;
+	settings.numMovingObjects = MovingObjects;
+	settings.spread = run.spread;
+
+	if(settings.boidsPerFlock == 0) { return result; }
+
+	char checkpoint[] = "/tmp/scalingXXXXXX";
+	int file = mkstemp(checkpoint);
+	if(file < 0) { return result; }
+	close(file);
+
+	Flock::World world;
+	Flock::SceneGenerator(settings).Generate(world);
+
+	world.batchIntegration = false;
+	if(Verlet) { world.integrator = Flock::World::VelocityVerlet; }
+
+	Imath::V3f target(0.0f, 0.0f, 0.0f);
+
+	for(unsigned int f=0; f < Warmup; ++f)
+		world.Update(target);
+
+	result.ok = true;
+
+	double start = Now();
+
+	for(unsigned int f=0; f < Frames && result.ok; ++f)
+	{
+		Flock::World batch;
+
+		if(!world.SaveCheckpoint(checkpoint) || !batch.LoadCheckpoint(checkpoint))
+		{
+			result.ok = false;
+			break;
+		}
+
+		batch.batchIntegration = true;
+
+		Imath::V3f batchTarget = target;
+
+		world.Update(target);
+		batch.Update(batchTarget);
+
+		for(unsigned int k=0; k < world.flocks.size() && result.ok; ++k)
+		{
+			const Flock::Flock::BoidList& boids = world.flocks[k]->boids();
+			const Flock::Flock::BoidList& batchBoids = batch.flocks[k]->boids();
+
+			if(boids.size() != batchBoids.size())
+			{
+				result.ok = false;
+				break;
+			}
+
+			for(unsigned int b=0; b < boids.size(); ++b)
+			{
+				if(boids[b]->id() != batchBoids[b]->id())
+				{
+					result.ok = false;
+					break;
+				}
+
+				Imath::V3f posDiff = boids[b]->pos() - batchBoids[b]->pos();
+				Imath::V3f velDiff = boids[b]->vel() - batchBoids[b]->vel();
+				float speed = boids[b]->vel().length();
+
+				for(unsigned int c=0; c < 3; ++c)
+					result.positionDifference = std::max(result.positionDifference, double(std::fabs(posDiff[c])));
+
+				if(speed > 0.0f)
+					result.velocityDifference = std::max(result.velocityDifference, double(velDiff.length() / speed));
+			}
+		}
+
+		batch.Clear();
+	}
+
+	result.seconds = Now() - start;
+
+	world.Clear();
+	unlink(checkpoint);
+
+	return result;
+}
+
+
+/* MeasureInChild:
+*  ---------------
+*	Each run happens in its own process so that the peak
+*	memory reported belongs to that run alone.
+*/
+Result MeasureInChild(const Run& run)
+{
+	Result result;
+	memset(&result, 0, sizeof(result));
+
+	int channel[2];
+	if(pipe(channel) != 0) { return result; }
+
+	pid_t child = fork();
+
+	if(child == 0)
+	{
+		close(channel[0]);
+		Result measured = Compare ? CompareIntegrators(run) : Measure(run);
+		ssize_t written = write(channel[1], &measured, sizeof(measured));
+		_exit(written == sizeof(measured) ? 0 : 1);
+	}
+
+	close(channel[1]);
+
+	if(child > 0)
+	{
+		if(read(channel[0], &result, sizeof(result)) != sizeof(result))
+			result.ok = false;
+
+		waitpid(child, NULL, 0);
+	}
+
+	close(channel[0]);
+
+	return result;
+}
+
+
+void WriteResult(std::ostream& out, const Run& run, const Result& result, bool first)
+{
+	if(Compare && Json)
+	{
+		out << (first ? "" : ",\n") << "  { \"boids\": " << run.boids << ", \"spread\": " << run.spread
+			<< ", \"flocks\": " << run.flocks << ", \"threads\": " << run.threads
+			<< ", \"frames\": " << Frames << ", \"ok\": " << (result.ok ? "true" : "false")
+			<< ", \"integrator\": \"" << (Verlet ? "verlet" : "euler") << "\""
+			<< ", \"max_position_difference\": " << result.positionDifference
+			<< ", \"max_relative_velocity_difference\": " << result.velocityDifference << " }";
+	}
+	else if(Compare)
+	{
+		out << run.boids << "," << run.spread << "," << run.flocks << "," << run.threads << ","
+			<< Frames << "," << (result.ok ? 1 : 0) << "," << (Verlet ? "verlet" : "euler") << ","
+			<< result.positionDifference << "," << result.velocityDifference << "\n";
+	}
+	else if(Json)
+	{
+		out << (first ? "" : ",\n") << "  { \"boids\": " << run.boids << ", \"spread\": " << run.spread
+			<< ", \"flocks\": " << run.flocks << ", \"threads\": " << run.threads
+			<< ", \"frames\": " << Frames << ", \"ok\": " << (result.ok ? "true" : "false")
+			<< ", \"seconds\": " << result.seconds << ", \"ns_per_boid_step\": " << result.nsPerBoidStep
+			<< ", \"neighbour_tests_per_frame\": " << result.neighbourTestsPerFrame
+			<< ", \"object_tests_per_frame\": " << result.objectTestsPerFrame
+			<< ", \"peak_rss_kb\": " << result.peakRSS << ", \"arena_peak_bytes\": " << result.arenaPeak
+			<< ", \"arena_heap_allocations\": " << result.arenaHeapAllocations << " }";
+	}
+	else
+	{
+		out << run.boids << "," << run.spread << "," << run.flocks << "," << run.threads << ","
+			<< Frames << "," << (result.ok ? 1 : 0) << "," << result.seconds << "," << result.nsPerBoidStep << ","
+			<< result.neighbourTestsPerFrame << "," << result.objectTestsPerFrame << "," << result.peakRSS << ","
+			<< result.arenaPeak << "," << result.arenaHeapAllocations << "\n";
+	}
+
+	out.flush();
+}
+
+
+// application main loop
+int main(int argc, char **argv)
+{
+	std::vector< unsigned int > boidCounts = ParseList< unsigned int >("1000,10000");
+	std::vector< float > spreads = ParseList< float >("0");
+	std::vector< unsigned int > flockCounts = ParseList< unsigned int >("1");
+	std::vector< unsigned int > threadCounts = ParseList< unsigned int >("1");
+
+	std::string outputName;
+
+	for(int a=1; a < argc; ++a)
+	{
+		std::string option = argv[a];
+		bool hasValue = a + 1 < argc;
+
+		if(option == "-boids" && hasValue) { boidCounts = ParseList< unsigned int >(argv[++a]); }
+		else if(option == "-spreads" && hasValue) { spreads = ParseList< float >(argv[++a]); }
+		else if(option == "-flocks" && hasValue) { flockCounts = ParseList< unsigned int >(argv[++a]); }
+		else if(option == "-threads" && hasValue) { threadCounts = ParseList< unsigned int >(argv[++a]); }
+		else if(option == "-frames" && hasValue) { Frames = atoi(argv[++a]); }
+		else if(option == "-warmup" && hasValue) { Warmup = atoi(argv[++a]); }
+		else if(option == "-objects" && hasValue) { Objects = atoi(argv[++a]); }
+		else if(option == "-moving" && hasValue) { MovingObjects = atoi(argv[++a]); }
+		else if(option == "-o" && hasValue) { outputName = argv[++a]; }
+		else if(option == "-json") { Json = true; }
+		else if(option == "-compare") { Compare = true; }
+		else if(option == "-verlet") { Verlet = true; }
+		else
+		{
+			std::cout << "usage " << argv[0] << " [-boids 1000,10000] [-spreads 0] [-flocks 1] [-threads 1]"
+				<< " [-frames 10] [-warmup 2] [-objects 0] [-moving 0] [-verlet] [-compare] [-json] [-o output]" << std::endl;
+			std::cout << "A spread of 0 sizes each flock from the generator's default density" << std::endl;
+			std::cout << "-compare reports the largest difference between a step of the batch integrator and"
+				<< " the per-boid update from the same state, in place of the timings" << std::endl;
+			exit(1);
+		}
+	}
+
+	if(Frames == 0) { Frames = 1; }
+
+#ifndef _OPENMP
+	if(threadCounts.size() > 1 || (threadCounts.size() == 1 && threadCounts[0] != 1))
+		std::cerr << "Built without OpenMP, every run uses one thread" << std::endl;
+#endif
+
+	std::ofstream outputFile;
+	if(!outputName.empty())
+	{
+		outputFile.open(outputName.c_str(), std::ios::out | std::ios::trunc);
+		if(!outputFile.is_open())
+		{
+			std::cout << "Unable to write " << outputName << std::endl;
+			exit(1);
+		}
+	}
+	std::ostream& out = outputName.empty() ? std::cout : outputFile;
+
+	if(Json)
+		out << "[\n";
+	else if(Compare)
+		out << "boids,spread,flocks,threads,frames,ok,integrator,max_position_difference,max_relative_velocity_difference\n";
+	else
+		out << "boids,spread,flocks,threads,frames,ok,seconds,ns_per_boid_step,"
+			<< "neighbour_tests_per_frame,object_tests_per_frame,peak_rss_kb,arena_peak_bytes,arena_heap_allocations\n";
+
+	bool first = true;
+
+	for(unsigned int b=0; b < boidCounts.size(); ++b)
+	for(unsigned int s=0; s < spreads.size(); ++s)
+	for(unsigned int f=0; f < flockCounts.size(); ++f)
+	for(unsigned int t=0; t < threadCounts.size(); ++t)
+	{
+		Run run;
+		run.boids = boidCounts[b];
+		run.spread = spreads[s];
+		run.flocks = flockCounts[f] ? flockCounts[f] : 1;
+		run.threads = threadCounts[t] ? threadCounts[t] : 1;
+
+		Result result = MeasureInChild(run);
+
+		WriteResult(out, run, result, first);
+		first = false;
+	}
+
+	if(Json)
+		out << "\n]\n";
+
+	return 0;
+}
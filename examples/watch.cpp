@@ -0,0 +1,110 @@
+/*
+*	Programming for Graphics - Flocking system
+*
+*	Michael Jones
+*/
+
+/*!
+\file watch.cpp
+\brief follows a running simulation through its shared memory snapshot, printing a summary of the latest frame
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+#include <iostream>
+#include <map>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <ImathVec.h>
+
+#include "Snapshot.h"
+
+// application main loop
+int main(int argc, char **argv)
+{
+	if(argc < 2)
+	{
+		std::cout << "usage " << argv[0] << " [snapshot name] [seconds]" << std::endl;
+		std::cout << "Prints the centre of each flock in the latest frame once a second, for 10 seconds by default" << std::endl;
+		exit(1);
+	}
+
+	unsigned int seconds = argc > 2 ? atoi(argv[2]) : 10;
+
+	Flock::SnapshotReader reader;
+
+	if(!reader.Open(argv[1]))
+	{
+		std::cout << "Error: no snapshot called " << argv[1] << std::endl;
+		exit(1);
+	}
+
+	unsigned int torn = 0;
+
+	for(unsigned int s=0; s < seconds; ++s)
+	{
+		if(s > 0) { sleep(1); }
+
+		// Everything is read straight out of the shared memory, and thrown away if
+		// the simulation came round and overwrote the frame in the meantime
+		uint32_t sequence = 0;
+		const Flock::SnapshotSlot* slot = NULL;
+
+		std::map< unsigned int, Imath::V3f > centres;
+		std::map< unsigned int, unsigned int > counts;
+		unsigned int frame = 0, numBoids = 0, totalBoids = 0;
+
+		while(true)
+		{
+			slot = reader.Latest(sequence);
+			if(!slot) { break; }
+
+			centres.clear();
+			counts.clear();
+
+			frame = slot->frame;
+			numBoids = slot->numBoids;
+			totalBoids = slot->totalBoids;
+
+			const Flock::SnapshotBoid* boid = slot->boids();
+
+			for(unsigned int b=0; b < numBoids; ++b, ++boid)
+			{
+				centres[boid->flock] += Imath::V3f(boid->pos[0], boid->pos[1], boid->pos[2]);
+				++counts[boid->flock];
+			}
+
+			if(reader.Valid(slot, sequence)) { break; }
+
+			++torn;
+		}
+
+		if(!slot)
+		{
+			std::cout << "Nothing published yet" << std::endl;
+			continue;
+		}
+
+		std::cout << "Frame " << frame << ": " << numBoids << " boids";
+		if(totalBoids > numBoids)
+			std::cout << " of " << totalBoids;
+		std::cout << std::endl;
+
+		std::map< unsigned int, Imath::V3f >::iterator centre = centres.begin();
+
+		for(; centre != centres.end(); ++centre)
+		{
+			Imath::V3f average = centre->second / float(counts[centre->first]);
+			std::cout << "  flock " << centre->first << " centred on "
+				<< average.x << " " << average.y << " " << average.z << std::endl;
+		}
+	}
+
+	if(torn)
+		std::cout << torn << " frames were overwritten while being read and read again" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+#include "Arena.h"
+#include "Memory.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+/*!
+\file Arena.cpp
+\brief contains methods for the arena class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/* Constructor:
+*  ------------
+*	Takes the first block up front, so a world that never
+*	needs more does all its heap allocation here.
+*/
+Arena::Arena(size_t blockSize)
+ :	m_block( 0 ),
+	m_offset( 0 ),
+	m_used( 0 ),
+	m_peak( 0 ),
+	m_heapAllocations( 0 ),
+	m_scope( 0 ),
+	m_scopes( 0 )
+{
+	Block block;
+	block.size = std::max(blockSize, size_t(64));
+	block.memory = static_cast<char*>(malloc(block.size));
+	TrackAllocation(ScratchMemory, block.size);
+
+	m_blocks.push_back(block);
+}
+
+
+Arena::~Arena()
+{
+	for(unsigned int b=0; b < m_blocks.size(); ++b)
+	{
+		free(m_blocks[b].memory);
+		TrackDeallocation(ScratchMemory, m_blocks[b].size);
+	}
+}
+
+
+/* Allocate:
+*  ---------
+*	Bumps the offset into the current block. Failing that the
+*	next block is tried, and only if it is too small is a new
+*	block, at least twice the size of the last, put in after
+*	the current one.
+*/
+void* Arena::Allocate(size_t bytes, size_t alignment)
+{
+	while(true)
+	{
+		Block& block = m_blocks[m_block];
+
+		size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+
+		if(start + bytes <= block.size)
+		{
+			m_used += start + bytes - m_offset;
+			m_offset = start + bytes;
+			m_peak = std::max(m_peak, m_used);
+
+			return block.memory + start;
+		}
+
+		// Whatever is left at the end of this block goes unused
+		m_used += block.size - m_offset;
+
+		if(m_block + 1 < m_blocks.size() && m_blocks[m_block + 1].size >= bytes + alignment)
+		{
+			++m_block;
+			m_offset = 0;
+			continue;
+		}
+
+		Block added;
+		added.size = std::max(m_blocks.back().size * 2, bytes + alignment);
+		added.memory = static_cast<char*>(malloc(added.size));
+		TrackAllocation(ScratchMemory, added.size);
+		++m_heapAllocations;
+
+		m_blocks.insert(m_blocks.begin() + m_block + 1, added);
+		++m_block;
+		m_offset = 0;
+	}
+}
+
+
+Arena::Mark Arena::Position() const
+{
+	Mark mark;
+	mark.block = m_block;
+	mark.offset = m_offset;
+	mark.used = m_used;
+
+	return mark;
+}
+
+
+void Arena::Rewind(const Mark& mark)
+{
+	m_block = mark.block;
+	m_offset = mark.offset;
+	m_used = mark.used;
+}
+
+
+/* Reset:
+*  ------
+*	Rewinds to the start of the first block, merging the
+*	blocks into one first if there is more than one.
+*/
+void Arena::Reset()
+{
+	assert(m_scope == 0 && "arena reset inside an ArenaScope");
+
+	m_heapAllocations = 0;
+	m_scopes = 0;
+
+	if(m_blocks.size() > 1)
+	{
+		size_t total = capacity();
+
+		for(unsigned int b=0; b < m_blocks.size(); ++b)
+		{
+			free(m_blocks[b].memory);
+			TrackDeallocation(ScratchMemory, m_blocks[b].size);
+		}
+
+		m_blocks.resize(1);
+		m_blocks[0].size = total;
+		m_blocks[0].memory = static_cast<char*>(malloc(total));
+		TrackAllocation(ScratchMemory, total);
+		m_heapAllocations = 1;
+	}
+
+	m_block = 0;
+	m_offset = 0;
+	m_used = 0;
+	m_peak = 0;
+}
+
+
+size_t Arena::capacity() const
+{
+	size_t total = 0;
+
+	for(unsigned int b=0; b < m_blocks.size(); ++b)
+	{
+		total += m_blocks[b].size;
+	}
+
+	return total;
+}
+
+} // Flock
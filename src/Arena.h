@@ -0,0 +1,198 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <cassert>
+
+/*!
+\file Arena.h
+\brief bump allocator for the scratch memory the behaviours use within a step, and an STL
+	allocator that draws from it
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class Arena
+{
+public:
+
+	/*! A point to go back to with Rewind, freeing everything allocated since */
+	struct Mark
+	{
+		size_t block;
+		size_t offset;
+		size_t used;
+	};
+
+	/*! \brief this constructor method creates an arena that starts with one block
+		\param blockSize - the size in bytes of the first block */
+	Arena(size_t blockSize = 64 * 1024);
+
+	/*! \brief destructor frees every block */
+	~Arena();
+
+	/*! \brief method used to take memory from the arena. It stays allocated until the arena is
+		rewound past it or reset. A new block is only taken from the heap when the ones already
+		held are full
+		\param bytes - the size wanted
+		\param alignment - a power of two the address must be a multiple of
+		\return the memory */
+	void* Allocate(size_t bytes, size_t alignment);
+
+	/*! \brief returns a mark for the memory allocated so far */
+	Mark Position() const;
+
+	/*! \brief method used to free everything allocated since a mark was taken. Marks have
+		to be rewound to in the reverse order they were taken */
+	void Rewind(const Mark& mark);
+
+	/*! \brief method used to free everything in the arena, ready for the next step. If the last
+		step needed more than one block they are replaced by a single block big enough for all
+		of it, so that a step of the same size needs nothing more from the heap */
+	void Reset();
+
+	/*! \brief returns the bytes allocated from the arena right now, including padding */
+	size_t used() const { return m_used; };
+
+	/*! \brief returns the most bytes allocated at once since the last Reset */
+	size_t peak() const { return m_peak; };
+
+	/*! \brief returns the bytes held in blocks */
+	size_t capacity() const;
+
+	/*! \brief returns the number of blocks taken from the heap since the last Reset */
+	unsigned int heapAllocations() const { return m_heapAllocations; };
+
+	/*! \brief returns the innermost ArenaScope open on the arena, each scope numbered as it is
+		opened, or zero outside every scope */
+	unsigned int scope() const { return m_scope; };
+
+private:
+
+	friend class ArenaScope;
+
+	/*! Not copyable, the blocks belong to one arena */
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	struct Block
+	{
+		char* memory;
+		size_t size;
+	};
+
+	std::vector<Block> m_blocks;
+
+	/*! The block being allocated from and how far into it the next allocation starts */
+	size_t m_block;
+	size_t m_offset;
+
+	size_t m_used;
+	size_t m_peak;
+	unsigned int m_heapAllocations;
+
+	/*! The innermost open scope, and the number of scopes opened since the last Reset */
+	unsigned int m_scope;
+	unsigned int m_scopes;
+};
+
+/*! Frees everything allocated from an arena within a scope when the scope ends. Containers
+	using the arena must be declared after it, so they are destroyed first, and may only grow
+	while it is the innermost scope open. Memory taken inside a nested scope would be freed
+	when that scope ends, so debug builds assert on it */
+class ArenaScope
+{
+public:
+
+	explicit ArenaScope(Arena& arena)
+	 :	m_arena( arena ),
+		m_mark( arena.Position() ),
+		m_outer( arena.m_scope )
+	{
+		m_arena.m_scope = ++m_arena.m_scopes;
+	};
+
+	~ArenaScope()
+	{
+		m_arena.Rewind(m_mark);
+		m_arena.m_scope = m_outer;
+	};
+
+private:
+
+	ArenaScope(const ArenaScope&);
+	ArenaScope& operator=(const ArenaScope&);
+
+	Arena& m_arena;
+	Arena::Mark m_mark;
+
+	/*! The scope that was innermost when this one was opened */
+	unsigned int m_outer;
+};
+
+/*! STL allocator drawing from an arena. Deallocating does nothing; the memory comes back when
+	the arena is rewound or reset, so containers using it should be sized once with reserve.
+	The allocator belongs to the scope innermost when it was made and can only allocate while
+	that scope is still innermost */
+template< typename T >
+class ArenaAllocator
+{
+public:
+
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template< typename U >
+	struct rebind { typedef ArenaAllocator< U > other; };
+
+	explicit ArenaAllocator(Arena& arena) : m_arena( &arena ), m_scope( arena.scope() ) {};
+
+	template< typename U >
+	ArenaAllocator(const ArenaAllocator< U >& other) : m_arena( other.arena() ), m_scope( other.scope() ) {};
+
+	pointer address(reference value) const { return &value; };
+	const_pointer address(const_reference value) const { return &value; };
+
+	pointer allocate(size_type count, const void* = 0)
+	{
+		assert(m_arena->scope() == m_scope && "arena container grown inside a nested ArenaScope");
+
+		return static_cast< pointer >( m_arena->Allocate(count * sizeof(T), __alignof__(T)) );
+	};
+
+	void deallocate(pointer, size_type) {};
+
+	size_type max_size() const { return size_type(-1) / sizeof(T); };
+
+	void construct(pointer p, const T& value) { new( p ) T( value ); };
+	void destroy(pointer p) { p->~T(); };
+
+	Arena* arena() const { return m_arena; };
+
+	unsigned int scope() const { return m_scope; };
+
+private:
+
+	Arena* m_arena;
+	unsigned int m_scope;
+};
+
+template< typename T, typename U >
+bool operator==(const ArenaAllocator< T >& first, const ArenaAllocator< U >& second) { return first.arena() == second.arena(); }
+
+template< typename T, typename U >
+bool operator!=(const ArenaAllocator< T >& first, const ArenaAllocator< U >& second) { return first.arena() != second.arena(); }
+
+}; // Flock
+
+#endif
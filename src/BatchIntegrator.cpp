@@ -0,0 +1,242 @@
+#include "BatchIntegrator.h"
+
+#include "Boid.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+/*!
+\file BatchIntegrator.cpp
+\brief contains methods for the batch integrator class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+#ifdef __AVX__
+
+/* ReciprocalSqrt:
+*  ---------------
+*	The hardware estimate is good to about 12 bits, one Newton
+*	step takes it close to full float precision. Zero lengths
+*	give zero rather than infinity so the clamps leave them be.
+*/
+inline __m256 ReciprocalSqrt(__m256 x)
+{
+	__m256 estimate = _mm256_rsqrt_ps(x);
+	__m256 refined = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), estimate),
+		_mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(x, _mm256_mul_ps(estimate, estimate))));
+
+	return _mm256_and_ps(refined, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+#else
+
+inline float ReciprocalSqrt(float x)
+{
+	return x > 0.0f ? 1.0f / std::sqrt(x) : 0.0f;
+}
+
+#endif
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Starts with nothing gathered.
+*/
+BatchIntegrator::BatchIntegrator()
+ :	m_count( 0 )
+{
+
+}
+
+
+/* Gather:
+*  -------
+*	Copies the boids into one array per component. The padding
+*	at the end is all zeros, which the kernel passes through
+*	unchanged.
+*/
+void BatchIntegrator::Gather(const std::vector< Boid*, TrackedAllocator<Boid*, BoidMemory> >& boids, unsigned int count)
+{
+	m_count = count;
+
+	unsigned int padded = (m_count + Width - 1) / Width * Width;
+
+	for(unsigned int s=0; s < NumStreams; ++s)
+	{
+		m_streams[s].resize(padded);
+		std::fill(m_streams[s].begin() + m_count, m_streams[s].end(), 0.0f);
+	}
+
+	#pragma omp parallel for schedule(static)
+	for(int b=0; b < int(m_count); ++b)
+	{
+		const Boid& boid = *boids[b];
+
+		m_streams[PosX][b] = boid.pos().x;
+		m_streams[PosY][b] = boid.pos().y;
+		m_streams[PosZ][b] = boid.pos().z;
+
+		m_streams[VelX][b] = boid.vel().x;
+		m_streams[VelY][b] = boid.vel().y;
+		m_streams[VelZ][b] = boid.vel().z;
+
+		m_streams[AccX][b] = boid.acc().x;
+		m_streams[AccY][b] = boid.acc().y;
+		m_streams[AccZ][b] = boid.acc().z;
+
+		m_streams[LastAccX][b] = boid.lastAcc().x;
+		m_streams[LastAccY][b] = boid.lastAcc().y;
+		m_streams[LastAccZ][b] = boid.lastAcc().z;
+	}
+}
+
+
+/* Integrate:
+*  ----------
+*	The same steps as Boid::update. The speed clamp finds the
+*	scale for both limits from one reciprocal square root: the
+*	upper limit applies first, and if the clamped speed is still
+*	below the lower limit that wins, as in the scalar code.
+*/
+void BatchIntegrator::Integrate(float maxAcc, float maxVel, float minVel, float timeStep, bool verlet)
+{
+	unsigned int padded = m_streams[PosX].size();
+
+	if(padded == 0) { return; }
+
+	// Semi-implicit Euler uses the current acceleration alone, Verlet averages in the last one
+	float accStep = verlet ? 0.5f * timeStep : timeStep;
+	float lastAccStep = verlet ? 0.5f * timeStep : 0.0f;
+	float posAccStep = verlet ? 0.5f * timeStep * timeStep : 0.0f;
+
+	float* px = &m_streams[PosX][0];
+	float* py = &m_streams[PosY][0];
+	float* pz = &m_streams[PosZ][0];
+	float* vx = &m_streams[VelX][0];
+	float* vy = &m_streams[VelY][0];
+	float* vz = &m_streams[VelZ][0];
+	float* ax = &m_streams[AccX][0];
+	float* ay = &m_streams[AccY][0];
+	float* az = &m_streams[AccZ][0];
+	const float* lx = &m_streams[LastAccX][0];
+	const float* ly = &m_streams[LastAccY][0];
+	const float* lz = &m_streams[LastAccZ][0];
+	float* preClamp = &m_streams[PreClampAcc][0];
+
+#ifdef __AVX__
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 maxAccV = _mm256_set1_ps(maxAcc);
+	const __m256 maxAcc2 = _mm256_set1_ps(maxAcc * maxAcc);
+	const __m256 maxVelV = _mm256_set1_ps(maxVel);
+	const __m256 minVelV = _mm256_set1_ps(minVel);
+	const __m256 dt = _mm256_set1_ps(timeStep);
+	const __m256 accStepV = _mm256_set1_ps(accStep);
+	const __m256 lastAccStepV = _mm256_set1_ps(lastAccStep);
+	const __m256 posAccStepV = _mm256_set1_ps(posAccStep);
+
+	for(unsigned int b=0; b < padded; b += Width)
+	{
+		__m256 accX = _mm256_loadu_ps(ax + b);
+		__m256 accY = _mm256_loadu_ps(ay + b);
+		__m256 accZ = _mm256_loadu_ps(az + b);
+
+		// Clamp the acceleration, keeping its length for banking
+		__m256 acc2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(accX, accX), _mm256_mul_ps(accY, accY)), _mm256_mul_ps(accZ, accZ));
+		__m256 accInverse = ReciprocalSqrt(acc2);
+
+		_mm256_storeu_ps(preClamp + b, _mm256_mul_ps(acc2, accInverse));
+
+		__m256 scale = _mm256_blendv_ps(one, _mm256_mul_ps(maxAccV, accInverse), _mm256_cmp_ps(acc2, maxAcc2, _CMP_GT_OQ));
+
+		accX = _mm256_mul_ps(accX, scale);
+		accY = _mm256_mul_ps(accY, scale);
+		accZ = _mm256_mul_ps(accZ, scale);
+
+		// Increment velocity by acceleration
+		__m256 velX = _mm256_add_ps(_mm256_loadu_ps(vx + b),
+			_mm256_add_ps(_mm256_mul_ps(accX, accStepV), _mm256_mul_ps(_mm256_loadu_ps(lx + b), lastAccStepV)));
+		__m256 velY = _mm256_add_ps(_mm256_loadu_ps(vy + b),
+			_mm256_add_ps(_mm256_mul_ps(accY, accStepV), _mm256_mul_ps(_mm256_loadu_ps(ly + b), lastAccStepV)));
+		__m256 velZ = _mm256_add_ps(_mm256_loadu_ps(vz + b),
+			_mm256_add_ps(_mm256_mul_ps(accZ, accStepV), _mm256_mul_ps(_mm256_loadu_ps(lz + b), lastAccStepV)));
+
+		// Clamp the speed between the limits
+		__m256 vel2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(velX, velX), _mm256_mul_ps(velY, velY)), _mm256_mul_ps(velZ, velZ));
+		__m256 velInverse = ReciprocalSqrt(vel2);
+		__m256 speed = _mm256_mul_ps(vel2, velInverse);
+
+		scale = _mm256_blendv_ps(one, _mm256_mul_ps(maxVelV, velInverse), _mm256_cmp_ps(speed, maxVelV, _CMP_GT_OQ));
+		scale = _mm256_blendv_ps(scale, _mm256_mul_ps(minVelV, velInverse),
+			_mm256_cmp_ps(_mm256_min_ps(speed, maxVelV), minVelV, _CMP_LT_OQ));
+
+		velX = _mm256_mul_ps(velX, scale);
+		velY = _mm256_mul_ps(velY, scale);
+		velZ = _mm256_mul_ps(velZ, scale);
+
+		// Increment position by velocity
+		_mm256_storeu_ps(px + b, _mm256_add_ps(_mm256_loadu_ps(px + b),
+			_mm256_add_ps(_mm256_mul_ps(velX, dt), _mm256_mul_ps(accX, posAccStepV))));
+		_mm256_storeu_ps(py + b, _mm256_add_ps(_mm256_loadu_ps(py + b),
+			_mm256_add_ps(_mm256_mul_ps(velY, dt), _mm256_mul_ps(accY, posAccStepV))));
+		_mm256_storeu_ps(pz + b, _mm256_add_ps(_mm256_loadu_ps(pz + b),
+			_mm256_add_ps(_mm256_mul_ps(velZ, dt), _mm256_mul_ps(accZ, posAccStepV))));
+
+		_mm256_storeu_ps(vx + b, velX);
+		_mm256_storeu_ps(vy + b, velY);
+		_mm256_storeu_ps(vz + b, velZ);
+
+		_mm256_storeu_ps(ax + b, accX);
+		_mm256_storeu_ps(ay + b, accY);
+		_mm256_storeu_ps(az + b, accZ);
+	}
+#else
+	// Without AVX the same steps are written out per boid, simple enough for the
+	// compiler to vectorise at whatever width the target has
+	for(unsigned int b=0; b < padded; ++b)
+	{
+		float acc2 = ax[b]*ax[b] + ay[b]*ay[b] + az[b]*az[b];
+		float accInverse = ReciprocalSqrt(acc2);
+
+		preClamp[b] = acc2 * accInverse;
+
+		float scale = acc2 > maxAcc * maxAcc ? maxAcc * accInverse : 1.0f;
+
+		ax[b] *= scale;
+		ay[b] *= scale;
+		az[b] *= scale;
+
+		vx[b] += ax[b] * accStep + lx[b] * lastAccStep;
+		vy[b] += ay[b] * accStep + ly[b] * lastAccStep;
+		vz[b] += az[b] * accStep + lz[b] * lastAccStep;
+
+		float vel2 = vx[b]*vx[b] + vy[b]*vy[b] + vz[b]*vz[b];
+		float velInverse = ReciprocalSqrt(vel2);
+		float speed = vel2 * velInverse;
+
+		scale = speed > maxVel ? maxVel * velInverse : 1.0f;
+		scale = std::min(speed, maxVel) < minVel ? minVel * velInverse : scale;
+
+		vx[b] *= scale;
+		vy[b] *= scale;
+		vz[b] *= scale;
+
+		px[b] += vx[b] * timeStep + ax[b] * posAccStep;
+		py[b] += vy[b] * timeStep + ay[b] * posAccStep;
+		pz[b] += vz[b] * timeStep + az[b] * posAccStep;
+	}
+#endif
+}
+
+} // Flock
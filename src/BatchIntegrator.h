@@ -0,0 +1,78 @@
+#ifndef __BATCHINTEGRATOR_H__
+#define __BATCHINTEGRATOR_H__
+
+#include <vector>
+
+#include "Memory.h"
+
+#include <ImathVec.h>
+
+/*!
+\file BatchIntegrator.h
+\brief integrates the motion of a whole flock at once, eight boids to an instruction where AVX is available
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class Boid;
+
+class BatchIntegrator
+{
+public:
+
+	/*! Number of boids handled together. The arrays are padded to a multiple of this */
+	static const unsigned int Width = 8;
+
+	/*! Default empty constructor for the class */
+	BatchIntegrator();
+
+	/*! \brief method used to copy the position, velocity and accelerations of the boids into
+		the integrator's arrays, one array per component
+		\param boids - the boids to integrate
+		\param count - the number of boids, from the start of the list, to integrate */
+	void Gather(const std::vector< Boid*, TrackedAllocator<Boid*, BoidMemory> >& boids, unsigned int count);
+
+	/*! \brief method used to clamp the acceleration, integrate the velocity, clamp the speed
+		between the limits and integrate the position of every boid gathered. Does the same as
+		Boid::update but each clamp uses a single approximate reciprocal square root
+		\param maxAcc - the largest acceleration allowed
+		\param maxVel - the largest speed allowed
+		\param minVel - the smallest speed allowed
+		\param timeStep - the length of the step in seconds
+		\param verlet - true for velocity Verlet, false for semi-implicit Euler */
+	void Integrate(float maxAcc, float maxVel, float minVel, float timeStep, bool verlet);
+
+	Imath::V3f pos(unsigned int b) const { return Imath::V3f(m_streams[PosX][b], m_streams[PosY][b], m_streams[PosZ][b]); };
+	Imath::V3f vel(unsigned int b) const { return Imath::V3f(m_streams[VelX][b], m_streams[VelY][b], m_streams[VelZ][b]); };
+
+	/*! \brief returns the clamped acceleration of a boid */
+	Imath::V3f acc(unsigned int b) const { return Imath::V3f(m_streams[AccX][b], m_streams[AccY][b], m_streams[AccZ][b]); };
+
+	/*! \brief returns the length of a boid's acceleration before it was clamped, used for banking */
+	float preClampAcc(unsigned int b) const { return m_streams[PreClampAcc][b]; };
+
+private:
+
+	enum Stream
+	{
+		PosX, PosY, PosZ,
+		VelX, VelY, VelZ,
+		AccX, AccY, AccZ,
+		LastAccX, LastAccY, LastAccZ,
+		PreClampAcc,
+		NumStreams
+	};
+
+	/*! Number of boids gathered */
+	unsigned int m_count;
+
+	/*! Each component of every boid's state, padded with zeros to a multiple of Width */
+	std::vector<float> m_streams[NumStreams];
+};
+
+}; // Flock
+
+#endif
@@ -0,0 +1,501 @@
+#define GL_GLEXT_PROTOTYPES
+
+#include "BatchRenderer.h"
+
+#include "World.h"
+#include "Flock.h"
+#include "Boid.h"
+#include "Particle.h"
+#include "Transform.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+/*!
+\file BatchRenderer.cpp
+\brief contains methods for the batch renderer class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+/*! Attribute locations used by the shader */
+enum Attribute
+{
+	PositionAttribute,
+	NormalAttribute,
+	Row0Attribute,
+	Row1Attribute,
+	Row2Attribute,
+	ColourAttribute
+};
+
+/*! The instance transform replaces the glTranslate/glRotate/glScale calls of the
+	immediate mode path. Normals go through the cofactors of the transform, which is
+	the inverse transpose up to a scale, so the squashed boids light correctly.
+	Lighting follows light 0 with the colour driving the ambient and diffuse
+	material, as the viewer sets up with glColorMaterial. */
+const char* s_vertexShader =
+	"#version 120\n"
+	"attribute vec3 position;\n"
+	"attribute vec3 normal;\n"
+	"attribute vec4 row0;\n"
+	"attribute vec4 row1;\n"
+	"attribute vec4 row2;\n"
+	"attribute vec4 colour;\n"
+	"varying vec4 shade;\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 local = vec4(position, 1.0);\n"
+	"	vec4 world = vec4(dot(row0, local), dot(row1, local), dot(row2, local), 1.0);\n"
+	"	vec3 worldNormal = vec3(dot(cross(row1.xyz, row2.xyz), normal),\n"
+	"		dot(cross(row2.xyz, row0.xyz), normal), dot(cross(row0.xyz, row1.xyz), normal));\n"
+	"	vec3 eyeNormal = normalize(gl_NormalMatrix * worldNormal);\n"
+	"	vec4 eye = gl_ModelViewMatrix * world;\n"
+	"	vec4 light = gl_LightSource[0].position;\n"
+	"	vec3 toLight = normalize(light.w == 0.0 ? light.xyz : light.xyz - eye.xyz);\n"
+	"	float diffuse = max(dot(eyeNormal, toLight), 0.0);\n"
+	"	vec3 lit = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb\n"
+	"		+ gl_LightSource[0].diffuse.rgb * diffuse;\n"
+	"	shade = vec4(colour.rgb * lit, colour.a);\n"
+	"	gl_Position = gl_ProjectionMatrix * eye;\n"
+	"}\n";
+
+const char* s_fragmentShader =
+	"#version 120\n"
+	"varying vec4 shade;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = shade;\n"
+	"}\n";
+
+/*! A mesh vertex, position then normal */
+struct Vertex
+{
+	float position[3];
+	float normal[3];
+};
+
+/* AddTriangle:
+*  ------------
+*	Appends a flat shaded triangle to a vertex list.
+*/
+void AddTriangle(std::vector<Vertex>& vertices, const float* a, const float* b, const float* c)
+{
+	float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	float n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] };
+
+	float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+	if(length > 0.0f) { n[0] /= length; n[1] /= length; n[2] /= length; }
+
+	const float* corners[3] = { a, b, c };
+
+	for(unsigned int i=0; i < 3; ++i)
+	{
+		Vertex vertex;
+		memcpy(vertex.position, corners[i], sizeof(vertex.position));
+		memcpy(vertex.normal, n, sizeof(vertex.normal));
+		vertices.push_back(vertex);
+	}
+}
+
+GLuint CompileShader(GLenum type, const char* source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+	if(!compiled)
+	{
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		std::cout << "Error: batch renderer shader failed to compile: " << log << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Nothing is created until there is a context to create it in.
+*/
+BatchRenderer::BatchRenderer()
+ :	m_program( 0 ),
+	m_meshBuffer( 0 ),
+	m_instanceBuffer( 0 ),
+	m_instanceCapacity( 0 ),
+	m_drawCalls( 0 )
+{
+
+}
+
+
+/* Destructor:
+*  -----------
+*	Frees any OpenGL objects.
+*/
+BatchRenderer::~BatchRenderer()
+{
+	Release();
+}
+
+
+/* Initialise:
+*  -----------
+*	Checks for instancing, compiles the shader and uploads the
+*	boid, shadow and particle meshes into a single buffer.
+*/
+bool BatchRenderer::Initialise()
+{
+	Release();
+
+	const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	int major = 0, minor = 0;
+
+	if(!version || sscanf(version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 33)
+	{
+		std::cout << "OpenGL 3.3 is needed for instanced drawing, found "
+			<< (version ? version : "none") << std::endl;
+		return false;
+	}
+
+	GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, s_vertexShader);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, s_fragmentShader);
+
+	if(!vertexShader || !fragmentShader)
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return false;
+	}
+
+	m_program = glCreateProgram();
+	glAttachShader(m_program, vertexShader);
+	glAttachShader(m_program, fragmentShader);
+
+	glBindAttribLocation(m_program, PositionAttribute, "position");
+	glBindAttribLocation(m_program, NormalAttribute, "normal");
+	glBindAttribLocation(m_program, Row0Attribute, "row0");
+	glBindAttribLocation(m_program, Row1Attribute, "row1");
+	glBindAttribLocation(m_program, Row2Attribute, "row2");
+	glBindAttribLocation(m_program, ColourAttribute, "colour");
+
+	glLinkProgram(m_program);
+
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &linked);
+
+	if(!linked)
+	{
+		char log[1024];
+		glGetProgramInfoLog(m_program, sizeof(log), NULL, log);
+		std::cout << "Error: batch renderer shader failed to link: " << log << std::endl;
+		Release();
+		return false;
+	}
+
+	std::vector<Vertex> vertices;
+
+	// Boid: the four sided cone of glutSolidCone(0.5, 1, 4, 1), base included
+	{
+		float apex[3] = { 0.0f, 0.0f, 1.0f };
+		float centre[3] = { 0.0f, 0.0f, 0.0f };
+		float base[4][3] = { { 0.0f, 0.5f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { 0.0f, -0.5f, 0.0f }, { -0.5f, 0.0f, 0.0f } };
+
+		m_boidMesh.first = vertices.size();
+
+		for(unsigned int i=0; i < 4; ++i)
+		{
+			AddTriangle(vertices, base[(i + 1) % 4], base[i], apex);
+			AddTriangle(vertices, base[i], base[(i + 1) % 4], centre);
+		}
+
+		m_boidMesh.count = vertices.size() - m_boidMesh.first;
+	}
+
+	// Boid shadow: the flat triangle drawn under each boid
+	{
+		float a[3] = { 0.0f, 0.0f, 1.0f };
+		float b[3] = { 0.5f, 0.0f, -0.3f };
+		float c[3] = { -0.5f, 0.0f, -0.3f };
+
+		m_boidShadowMesh.first = vertices.size();
+		AddTriangle(vertices, a, b, c);
+		m_boidShadowMesh.count = vertices.size() - m_boidShadowMesh.first;
+	}
+
+	// Particle: an octahedron, about as round as glutSolidSphere(0.1, 3, 3)
+	{
+		float r = 0.1f;
+		float points[6][3] = { { r, 0, 0 }, { 0, 0, r }, { -r, 0, 0 }, { 0, 0, -r }, { 0, r, 0 }, { 0, -r, 0 } };
+
+		m_particleMesh.first = vertices.size();
+
+		for(unsigned int i=0; i < 4; ++i)
+		{
+			AddTriangle(vertices, points[(i + 1) % 4], points[i], points[4]);
+			AddTriangle(vertices, points[i], points[(i + 1) % 4], points[5]);
+		}
+
+		m_particleMesh.count = vertices.size() - m_particleMesh.first;
+	}
+
+	// Particle shadow: a small square on the ground
+	{
+		float a[3] = { 0.1f, 0.0f, 0.1f };
+		float b[3] = { 0.1f, 0.0f, -0.1f };
+		float c[3] = { -0.1f, 0.0f, -0.1f };
+		float d[3] = { -0.1f, 0.0f, 0.1f };
+
+		m_particleShadowMesh.first = vertices.size();
+		AddTriangle(vertices, a, b, c);
+		AddTriangle(vertices, a, c, d);
+		m_particleShadowMesh.count = vertices.size() - m_particleShadowMesh.first;
+	}
+
+	glGenBuffers(1, &m_meshBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_meshBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_instanceBuffer);
+	m_instanceCapacity = 0;
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+
+/* Gather:
+*  -------
+*	Builds the transform of each boid, shadow and particle to
+*	match Boid::Draw and Particle::Draw. Boids use their axes
+*	directly rather than going through Euler angles.
+*/
+void BatchRenderer::Gather(const World& world)
+{
+	m_boids.clear();
+	m_boidShadows.clear();
+	m_particles.clear();
+	m_particleShadows.clear();
+
+	const float toDegrees = 57.295779524f;
+	const float floor = world.minY + 0.1f;
+
+	Instance instance;
+
+	std::vector<Flock*>::const_iterator currentFlock = world.flocks.begin();
+	std::vector<Flock*>::const_iterator endFlock = world.flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		const Imath::Color4<float>& colour = (*currentFlock)->colour();
+
+		const Flock::BoidList& boids = (*currentFlock)->boids();
+
+		for(unsigned int b=0; b < boids.size(); ++b)
+		{
+			const Imath::V3f& pos = boids[b]->pos();
+
+			Imath::V3f side, up, forward;
+			boids[b]->Orientation(side, up, forward);
+
+			Transform body;
+			body.Translate(pos.x, pos.y, pos.z);
+			body.Basis(side, up, forward);
+			body.Scale(1.0f, 0.3f, 0.3f);
+			body.CopyTo(instance.rows);
+
+			// Flock::Draw passes the channels in r, b, g order, kept so both paths match
+			instance.colour[0] = colour.r;
+			instance.colour[1] = colour.b;
+			instance.colour[2] = colour.g;
+			instance.colour[3] = colour.a;
+
+			m_boids.push_back(instance);
+
+			Transform shadow;
+			shadow.Translate(pos.x, floor, pos.z);
+			shadow.Face(forward);
+			shadow.Scale(1.0f, 1.0f, std::fabs(0.5f - (std::asin(forward.y) * toDegrees / 90.0f) / 2));
+			shadow.CopyTo(instance.rows);
+
+			instance.colour[0] = 0.1f;
+			instance.colour[1] = 0.3f;
+			instance.colour[2] = 0.1f;
+			instance.colour[3] = 1.0f;
+
+			m_boidShadows.push_back(instance);
+		}
+
+		const Flock::ParticleList& particles = (*currentFlock)->particles();
+
+		for(unsigned int p=0; p < particles.size(); ++p)
+		{
+			const Particle& particle = *particles[p];
+
+			Transform body;
+			body.Translate(particle.Pos.x, particle.Pos.y, particle.Pos.z);
+			body.CopyTo(instance.rows);
+
+			instance.colour[0] = particle.colour.r;
+			instance.colour[1] = particle.colour.g;
+			instance.colour[2] = particle.colour.b;
+			instance.colour[3] = particle.colour.a;
+
+			m_particles.push_back(instance);
+
+			Transform shadow;
+			shadow.Translate(particle.Pos.x, particle.floorHeight + 0.1f, particle.Pos.z);
+			shadow.CopyTo(instance.rows);
+
+			instance.colour[0] = 0.1f;
+			instance.colour[1] = 0.3f;
+			instance.colour[2] = 0.1f;
+			instance.colour[3] = 1.0f;
+
+			m_particleShadows.push_back(instance);
+		}
+	}
+}
+
+
+/* Draw:
+*  -----
+*	Uploads all the instances into one buffer and draws each
+*	kind of mesh with a single instanced draw.
+*/
+void BatchRenderer::Draw(const World& world)
+{
+	m_drawCalls = 0;
+
+	if(!initialised()) { return; }
+
+	Gather(world);
+
+	InstanceList* lists[4] = { &m_boids, &m_boidShadows, &m_particles, &m_particleShadows };
+	const Mesh* meshes[4] = { &m_boidMesh, &m_boidShadowMesh, &m_particleMesh, &m_particleShadowMesh };
+
+	unsigned int total = 0;
+	for(unsigned int l=0; l < 4; ++l) { total += lists[l]->size(); }
+
+	if(total == 0) { return; }
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+
+	// Orphan the old storage so the upload doesn't wait on last frame's draws
+	unsigned int bytes = total * sizeof(Instance);
+	if(bytes > m_instanceCapacity)
+	{
+		TrackDeallocation(ExportMemory, m_instanceCapacity);
+		m_instanceCapacity = bytes + bytes / 2;
+		TrackAllocation(ExportMemory, m_instanceCapacity);
+	}
+	glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity, NULL, GL_STREAM_DRAW);
+
+	unsigned int offset = 0;
+	for(unsigned int l=0; l < 4; ++l)
+	{
+		if(lists[l]->empty()) { continue; }
+
+		glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(Instance), lists[l]->size() * sizeof(Instance), &(*lists[l])[0]);
+		offset += lists[l]->size();
+	}
+
+	glUseProgram(m_program);
+
+	for(unsigned int a=PositionAttribute; a <= ColourAttribute; ++a)
+		glEnableVertexAttribArray(a);
+
+	offset = 0;
+	for(unsigned int l=0; l < 4; ++l)
+	{
+		DrawInstances(*meshes[l], offset, lists[l]->size());
+		offset += lists[l]->size();
+	}
+
+	for(unsigned int a=PositionAttribute; a <= ColourAttribute; ++a)
+	{
+		glVertexAttribDivisor(a, 0);
+		glDisableVertexAttribArray(a);
+	}
+
+	glUseProgram(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+/* DrawInstances:
+*  --------------
+*	Points the attributes at the mesh and at this list's
+*	part of the instance buffer, then draws.
+*/
+void BatchRenderer::DrawInstances(const Mesh& mesh, unsigned int first, unsigned int count)
+{
+	if(count == 0) { return; }
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_meshBuffer);
+	glVertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, position));
+	glVertexAttribPointer(NormalAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, normal));
+
+	size_t base = first * sizeof(Instance);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+
+	for(unsigned int row=0; row < 3; ++row)
+	{
+		glVertexAttribPointer(Row0Attribute + row, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			(const GLvoid*)(base + offsetof(Instance, rows) + row * 4 * sizeof(float)));
+		glVertexAttribDivisor(Row0Attribute + row, 1);
+	}
+
+	glVertexAttribPointer(ColourAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+		(const GLvoid*)(base + offsetof(Instance, colour)));
+	glVertexAttribDivisor(ColourAttribute, 1);
+
+	glDrawArraysInstanced(GL_TRIANGLES, mesh.first, mesh.count, count);
+	++m_drawCalls;
+}
+
+
+/* Release:
+*  --------
+*	Deletes the shader and buffers if they were created.
+*/
+void BatchRenderer::Release()
+{
+	if(m_program) { glDeleteProgram(m_program); }
+	if(m_meshBuffer) { glDeleteBuffers(1, &m_meshBuffer); }
+	if(m_instanceBuffer) { glDeleteBuffers(1, &m_instanceBuffer); }
+
+	TrackDeallocation(ExportMemory, m_instanceCapacity);
+
+	m_program = 0;
+	m_meshBuffer = 0;
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+}
+
+} // Flock
@@ -0,0 +1,99 @@
+#ifndef __BATCHRENDERER_H__
+#define __BATCHRENDERER_H__
+
+#include <vector>
+
+#include "Memory.h"
+
+/*!
+\file BatchRenderer.h
+\brief draws every boid, shadow and particle in the world with a few instanced draws
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+
+class BatchRenderer
+{
+public:
+
+	/*! Default empty constructor for the class. No OpenGL calls are made until Initialise */
+	BatchRenderer();
+
+	/*! \brief destructor frees the buffers and shader, so must run while the context is current */
+	~BatchRenderer();
+
+	/*! \brief method used to compile the shader and create the buffers. Needs a current
+		OpenGL 3.3 context, or a compatibility context with instanced arrays
+		\return false if instancing is not available, in which case the per-boid Draw
+		methods should be used instead */
+	bool Initialise();
+
+	/*! \brief method used to draw all the boids, their shadows and the particles of every flock.
+		Uses the current modelview and projection matrices and the state of light 0, like the
+		immediate mode Draw methods it replaces
+		\param world - the world to draw */
+	void Draw(const World& world);
+
+	bool initialised() const { return m_program != 0; };
+
+	/*! \brief returns the number of instanced draw calls made by the last Draw */
+	unsigned int drawCalls() const { return m_drawCalls; };
+
+private:
+
+	/*! Per instance data. The first three rows of an affine transform, then a colour */
+	struct Instance
+	{
+		float rows[3][4];
+		float colour[4];
+	};
+
+	typedef std::vector< Instance, TrackedAllocator<Instance, ExportMemory> > InstanceList;
+
+	/*! A run of vertices in the mesh buffer */
+	struct Mesh
+	{
+		int first;
+		int count;
+	};
+
+	/*! \brief method to fill the instance lists from the world */
+	void Gather(const World& world);
+
+	/*! \brief method to draw one mesh once for each instance in a list
+		\param mesh - the mesh to draw
+		\param first - the index of the first instance in the instance buffer
+		\param count - the number of instances */
+	void DrawInstances(const Mesh& mesh, unsigned int first, unsigned int count);
+
+	/*! \brief frees the OpenGL objects */
+	void Release();
+
+	unsigned int m_program;
+	unsigned int m_meshBuffer;
+	unsigned int m_instanceBuffer;
+
+	/*! Size in bytes of the instance buffer's storage, counted as ExportMemory */
+	unsigned int m_instanceCapacity;
+
+	Mesh m_boidMesh;
+	Mesh m_boidShadowMesh;
+	Mesh m_particleMesh;
+	Mesh m_particleShadowMesh;
+
+	InstanceList m_boids;
+	InstanceList m_boidShadows;
+	InstanceList m_particles;
+	InstanceList m_particleShadows;
+
+	unsigned int m_drawCalls;
+};
+
+}; // Flock
+
+#endif
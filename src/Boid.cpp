@@ -1,7 +1,9 @@
 #include "Boid.h"
 #include "Flock.h"
+#include "Serialise.h"
 
 #include <iostream>
+#include <map>
 #include <math.h>
 
 #include <GL/gl.h>
@@ -25,11 +27,11 @@ namespace Flock {
 *  ---------------------
 *	Sets default values for the boids
 */
-Boid::Boid( unsigned bID, int fID,  double x, double y, double z, double spread)
+Boid::Boid( unsigned bID, int fID,  double x, double y, double z, double spread, unsigned long worldSeed )
  :	m_id( bID ),
 	m_flock_id( fID )
 {
-	Imath::Rand48 rand( bID );
+	Imath::Rand48 rand( Seed( worldSeed, fID, bID ) );
 
 	// Create a spread of positions around an average
 	m_pos.x = x + rand.nextf(-1.0, 1.0) * spread/2;
@@ -39,15 +41,135 @@ Boid::Boid( unsigned bID, int fID,  double x, double y, double z, double spread)
 	// Create a spread of velocities
 	// Vel.setValue(RandomPosNum(5) - 2.5, RandomPosNum(5) - 2.5, RandomPosNum(5) - 2.5, 0);
 	m_vel.setValue( rand.nextf( -2.5, 2.5 ), rand.nextf( -2.5, 2.5 ), rand.nextf( -2.5, 2.5 ) );
-	
-	// Pitch
-	m_dir.x = -atan(m_vel.y/sqrt(m_vel.x*m_vel.x + m_vel.z*m_vel.z));
 
-	// Yaw 
-	m_dir.y = atan2(m_vel.x, m_vel.z);
+	Rest();
+}
+
+Boid::Boid( unsigned bID, int fID, const Imath::V3f& pos, const Imath::V3f& vel )
+ :	m_id( bID ),
+	m_flock_id( fID ),
+	m_pos( pos ),
+	m_vel( vel )
+{
+	Rest();
+}
+
+/* Rest:
+*  -----
+*	Shared by the constructors once the position and velocity
+*	are set.
+*/
+void Boid::Rest()
+{
+	// Start level, the heading follows the velocity
+	m_bankCos = 1.0f;
+	m_bankSin = 0.0f;
 
 	// Zero the inital acceleration
 	m_acc.setValue(0.0, 0.0, 0.0 );
+	m_lastAcc.setValue(0.0, 0.0, 0.0 );
+
+	m_quietSteps = 0;
+	m_sleepCountdown = 0;
+	m_neighbourhood = 0;
+	m_neighbourhoodChanged = false;
+	m_targetFlock = 0;
+	m_targetID = 0;
+	m_targetHold = 0;
+	m_ghost = false;
+}
+
+/* Seed:
+*  -----
+*	With a zero world seed every boid is seeded by its ID
+*	alone, as it always has been. Otherwise the IDs are
+*	mixed into the world seed so flocks don't share spreads.
+*/
+unsigned long Boid::Seed( unsigned long worldSeed, int flockID, unsigned bID )
+{
+	if( worldSeed == 0 ) { return bID; }
+
+	unsigned long seed = worldSeed;
+	seed = seed * 2654435761UL + (unsigned long)flockID;
+	seed = seed * 2654435761UL + (unsigned long)bID;
+
+	return seed ^ (seed >> 16);
+}
+
+namespace {
+
+/*! Bytes in a slab of boids and the number of its boids not yet deleted */
+struct Slab
+{
+	size_t bytes;
+	size_t live;
+};
+
+/*! Every slab, by its first slot. Never destroyed, so boids can be deleted at any point of exit */
+typedef std::map< const char*, Slab > SlabMap;
+SlabMap& Slabs()
+{
+	static SlabMap* slabs = new SlabMap;
+	return *slabs;
+}
+
+} // namespace
+
+/* AllocateSlab:
+*  -------------
+*	Flocks made in bulk take one slab for the lot, so their
+*	boids cost one allocation and sit next to each other.
+*/
+Boid* Boid::AllocateSlab( size_t count )
+{
+	Slab slab;
+	slab.bytes = count * sizeof( Boid );
+	slab.live = count;
+
+	char* memory = static_cast< char* >( ::operator new( slab.bytes ) );
+	TrackAllocation( BoidMemory, slab.bytes );
+
+	#pragma omp critical(BoidSlabs)
+	Slabs()[ memory ] = slab;
+
+	return reinterpret_cast< Boid* >( memory );
+}
+
+/* new / delete:
+*  -------------
+*	A boid made on its own is a slab of one. Deleting a boid
+*	finds its slab, which goes back to the heap once empty.
+*/
+void* Boid::operator new( size_t bytes )
+{
+	return AllocateSlab( 1 );
+}
+
+void Boid::operator delete( void* memory, size_t bytes )
+{
+	if( !memory ) { return; }
+
+	const char* empty = NULL;
+	size_t emptyBytes = 0;
+
+	#pragma omp critical(BoidSlabs)
+	{
+		SlabMap::iterator slab = Slabs().upper_bound( static_cast< const char* >( memory ) );
+		--slab;
+
+		if( --slab->second.live == 0 )
+		{
+			empty = slab->first;
+			emptyBytes = slab->second.bytes;
+			Slabs().erase( slab );
+		}
+	}
+
+	if( empty )
+	{
+		TrackDeallocation( BoidMemory, emptyBytes );
+		::operator delete( const_cast< char* >( empty ) );
+	}
 }
 
 void Clamp( Imath::V3f &value, float maxValue) 
@@ -59,14 +181,25 @@ void Clamp( Imath::V3f &value, float maxValue)
 	}
 }
 
-void Boid::update( const Flock::Behaviour& behaviour )
+/* update:
+*  -------
+*	The default semi-implicit Euler updates the velocity first
+*	and moves the boid with the new velocity. Velocity Verlet
+*	finishes the last step's velocity using the average of the
+*	last and current accelerations, then moves the boid with the
+*	velocity and the current acceleration.
+*/
+void Boid::update( const Flock::Behaviour& behaviour, float timeStep, World::Integrator integrator )
 {
 	float preClampAcc = m_acc.length();
 
 	Clamp(m_acc, behaviour.maxAcc);
 
 	// Increment velocity by acceleration
-	m_vel = m_vel + m_acc*0.04;
+	if(integrator == World::VelocityVerlet)
+		m_vel = m_vel + (m_lastAcc + m_acc)*(0.5f*timeStep);
+	else
+		m_vel = m_vel + m_acc*timeStep;
 
 	Clamp(m_vel, behaviour.maxVel);
 
@@ -78,24 +211,49 @@ void Boid::update( const Flock::Behaviour& behaviour )
 	}
 
 	// increment position by velocity
-	m_pos += m_vel*0.04;
-	
+	if(integrator == World::VelocityVerlet)
+		m_pos += m_vel*timeStep + m_acc*(0.5f*timeStep*timeStep);
+	else
+		m_pos += m_vel*timeStep;
+
+	Bank( behaviour, preClampAcc );
+}
+
+/* Integrated:
+*  -----------
+*	Takes the results of a batched integration, then banks
+*	the same way as update.
+*/
+void Boid::Integrated( const Imath::V3f& pos, const Imath::V3f& vel, const Imath::V3f& acc,
+	float preClampAcc, const Flock::Behaviour& behaviour )
+{
+	m_pos = pos;
+	m_vel = vel;
+	m_acc = acc;
+
+	Bank( behaviour, preClampAcc );
+}
+
+/* Bank:
+*  -----
+*	Rolls the boid into its turn by an average of the sideways
+*	acceleration over the last few steps, then clears the
+*	acceleration ready for the next step.
+*/
+void Boid::Bank( const Flock::Behaviour& behaviour, float preClampAcc )
+{
 	float vx = m_vel.x;
-	float vy = m_vel.y;
 	float vz = m_vel.z;
 	
-	// Pitch
-	m_dir.x = -atan(vy/sqrt(vx*vx + vz*vz));
-
-	// Yaw - Working
-	m_dir.y = atan2(vx, vz);
+	// Pitch and yaw follow from the velocity whenever they are needed, see Orientation
 	
 	// Roll
-	Imath::V3f up(0.0, 1.0, 0.0);
+	float horizontal = sqrt(vx*vx + vz*vz);
 	
-	// calculate local xAxis for boid
-	Imath::V3f xAxis = m_vel.cross(up);  
-	xAxis.normalize();
+	// calculate local xAxis for boid, the velocity crossed with up
+	Imath::V3f xAxis( 0.0f, 0.0f, 0.0f );
+	if( horizontal > 0.0f )
+		xAxis.setValue( -vz/horizontal, 0.0f, vx/horizontal );
 	
 	float totalAcc = behaviour.localFC.max + behaviour.globalFC.max + behaviour.goalFC.max
 		+ behaviour.collisionAvoidance.max + behaviour.objectAvoidance.max
@@ -110,13 +268,13 @@ void Boid::update( const Flock::Behaviour& behaviour )
 	// Save roll in roll vector
 	m_old_roll.insert(m_old_roll.begin(), tilt);
 	
-	// remove last roll if necessary
-	if( m_old_roll.size() > behaviour.bankingDepth )
+	// remove the oldest rolls, more than one if the depth has been lowered
+	while( m_old_roll.size() > behaviour.bankingDepth )
 		m_old_roll.pop_back();
 	
 
-	std::vector<float>::iterator currentRoll = m_old_roll.begin();
-	std::vector<float>::iterator endRoll = m_old_roll.end();
+	RollHistory::iterator currentRoll = m_old_roll.begin();
+	RollHistory::iterator endRoll = m_old_roll.end();
 
 	int count = 0;
 	float roll = 0;
@@ -130,11 +288,138 @@ void Boid::update( const Flock::Behaviour& behaviour )
 
 	roll = roll / count;
 	
-	m_dir.z = -atan2(roll, -9.8);
+	// Bank by -atan2(roll, -9.8), kept as its cosine and sine
+	float bank = sqrt(roll*roll + 96.04f);
+	m_bankCos = -9.8f/bank;
+	m_bankSin = -roll/bank;
 
+	m_lastAcc = m_acc;
 	m_acc.setValue( 0.0f, 0.0f, 0.0f );
 }
 
+/* dir:
+*  ----
+*	Converts the orientation to Euler angles, for the code
+*	that still draws with glRotate.
+*/
+Imath::V3f Boid::dir() const
+{
+	return Imath::V3f( -atan(m_vel.y/sqrt(m_vel.x*m_vel.x + m_vel.z*m_vel.z)),
+		atan2(m_vel.x, m_vel.z), atan2(m_bankSin, m_bankCos) );
+}
+
+/* Orientation:
+*  ------------
+*	Builds the boid's axes without any trig. The unbanked side
+*	axis is horizontal and at right angles to the velocity,
+*	then both side and up are turned by the bank.
+*/
+void Boid::Orientation( Imath::V3f& side, Imath::V3f& up, Imath::V3f& forward ) const
+{
+	float horizontal = sqrt(m_vel.x*m_vel.x + m_vel.z*m_vel.z);
+	float speed = sqrt(horizontal*horizontal + m_vel.y*m_vel.y);
+
+	Imath::V3f flatSide( 1.0f, 0.0f, 0.0f );
+
+	if( horizontal > 0.0f )
+		flatSide.setValue( m_vel.z/horizontal, 0.0f, -m_vel.x/horizontal );
+
+	if( speed > 0.0f )
+		forward = m_vel/speed;
+	else
+		forward.setValue( 0.0f, 0.0f, 1.0f );
+
+	Imath::V3f flatUp = forward.cross(flatSide);
+
+	side = flatSide*m_bankCos + flatUp*m_bankSin;
+	up = flatUp*m_bankCos - flatSide*m_bankSin;
+}
+
+/* Settle:
+*  -------
+*	A boid falls asleep once its acceleration has stayed
+*	below the threshold, with the same flock mates around it,
+*	for enough steps in a row. A sleeping boid that is pushed,
+*	by containment, fleeing or a moving object, or that a
+*	disturbed neighbour came close to, wakes fully. Otherwise it wakes for one
+*	step every so often and goes back to sleep if nothing
+*	has changed.
+*/
+void Boid::Settle( const World::Sleeping& sleeping, bool woken )
+{
+	if( asleep() )
+	{
+		if( woken || m_acc.length() > 0.0f )
+		{
+			wake();
+		}
+		else if( --m_sleepCountdown == 0 )
+		{
+			m_quietSteps = sleeping.settleSteps - 1;
+		}
+		return;
+	}
+
+	if( m_acc.length() < sleeping.threshold && !m_neighbourhoodChanged )
+		++m_quietSteps;
+	else
+		m_quietSteps = 0;
+
+	if( m_quietSteps >= sleeping.settleSteps )
+		m_sleepCountdown = sleeping.wakeInterval;
+}
+
+/* Save:
+*  -----
+*	Writes every member of the boid, including the banking
+*	history, so that a restored boid continues identically.
+*/
+void Boid::Save( std::ostream& out ) const
+{
+	Write( out, m_id );
+	Write( out, m_flock_id );
+	Write( out, m_pos );
+	Write( out, m_vel );
+	Write( out, m_acc );
+	Write( out, m_lastAcc );
+	Write( out, m_bankCos );
+	Write( out, m_bankSin );
+	WriteVector( out, m_old_roll );
+	Write( out, m_quietSteps );
+	Write( out, m_sleepCountdown );
+	Write( out, m_neighbourhood );
+	Write( out, m_neighbourhoodChanged );
+	Write( out, m_targetFlock );
+	Write( out, m_targetID );
+	Write( out, m_targetHold );
+}
+
+/* Load:
+*  -----
+*	Reads back the members in the order written by Save.
+*/
+bool Boid::Load( std::istream& in )
+{
+	Read( in, m_id );
+	Read( in, m_flock_id );
+	Read( in, m_pos );
+	Read( in, m_vel );
+	Read( in, m_acc );
+	Read( in, m_lastAcc );
+	Read( in, m_bankCos );
+	Read( in, m_bankSin );
+
+	ReadVector( in, m_old_roll );
+	Read( in, m_quietSteps );
+	Read( in, m_sleepCountdown );
+	Read( in, m_neighbourhood );
+	Read( in, m_neighbourhoodChanged );
+	Read( in, m_targetFlock );
+	Read( in, m_targetID );
+
+	return Read( in, m_targetHold );
+}
+
 /* Draw:
 *  ---------------------
 *	Runs the OpenGL commands required to display the boid.
@@ -142,6 +427,7 @@ void Boid::update( const Flock::Behaviour& behaviour )
 void Boid::Draw(float floorHeight) const
 {
 	float pitch, yaw, roll;
+	Imath::V3f dir = this->dir();
 	
 	// Draw boid
 	
@@ -152,13 +438,13 @@ void Boid::Draw(float floorHeight) const
 		glTranslatef( m_pos.x, m_pos.y, m_pos.z );
 		
 		// Convert from radians to degrees
-		pitch = m_dir.x * 57.295779524;
-		yaw = m_dir.y * 57.295779524;
-		roll = m_dir.z * 57.295779524;
+		pitch = dir.x * 57.295779524;
+		yaw = dir.y * 57.295779524;
+		roll = dir.z * 57.295779524;
 	
 		// Rotate the boid appropriately 
 		glRotatef(pitch, 1.0, 0.0, 0.0);
-		glRotatef(yaw, 0.0, cos(m_dir.x), - sin(m_dir.x));
+		glRotatef(yaw, 0.0, cos(dir.x), - sin(dir.x));
 		glRotatef(roll, 0.0, 0.0, 1.0);
 		
 		glScalef(1.0, 0.3, 0.3);
@@ -179,8 +465,8 @@ void Boid::Draw(float floorHeight) const
 		// Rotate shadow
 		glRotatef(yaw, 0.0, 1.0, 0.0);
 		
-		pitch = fabs(0.5 + (m_dir.x * 57.295779524/90.0)/2);
-		yaw = m_dir.y * 57.295779524/180.0;
+		pitch = fabs(0.5 + (dir.x * 57.295779524/90.0)/2);
+		yaw = dir.y * 57.295779524/180.0;
 		
 		// Scale it a little with the pitch
 		glScalef(1, 1, pitch);
@@ -2,10 +2,12 @@
 #define __BOID_H__
 
 #include "Flock.h"
+#include "Memory.h"
 
 #include <ImathVec.h>
 
 #include <vector>
+#include <iosfwd>
 
 
 /*!
@@ -28,8 +30,39 @@ public:
 		\param x - the x co-ordinate of the position around which the flock is created
 		\param y - the y co-ordinate of the position around which the flock is created
 		\param z - the z co-ordinate of the position around which the flock is created
-		\param spread - the spread of the flock around the position at which it is created */
-	Boid( unsigned bID, int flockID, double x, double y, double z, double spread );
+		\param spread - the spread of the flock around the position at which it is created
+		\param worldSeed - seed for the whole world, combined with the flock and boid IDs. 
+		Zero gives the original per-boid seeding */
+	Boid( unsigned bID, int flockID, double x, double y, double z, double spread, unsigned long worldSeed = 0 );
+
+	/*! \brief this constructor method creates a boid at a given position and velocity, as read from a boid file
+		\param bID - the ID of the boid being created
+		\param flockID - the flock ID for the boid being created
+		\param pos - the starting position of the boid
+		\param vel - the starting velocity of the boid */
+	Boid( unsigned bID, int flockID, const Imath::V3f& pos, const Imath::V3f& vel );
+
+	/*! \brief returns the seed used for the random initial state of a boid. Depends only on 
+		the IDs so the result doesn't change with creation order.
+		\param worldSeed - seed for the whole world, zero keeps the original seeding by boid ID
+		\param flockID - the flock ID of the boid
+		\param bID - the ID of the boid within its flock */
+	static unsigned long Seed( unsigned long worldSeed, int flockID, unsigned bID );
+
+	/*! \brief allocation functions that give each boid a slab of its own, see AllocateSlab */
+	static void* operator new( size_t bytes );
+	static void operator delete( void* memory, size_t bytes );
+
+	/*! \brief placement forms, for making boids in the slots of a slab */
+	static void* operator new( size_t, void* slot ) { return slot; };
+	static void operator delete( void*, void* ) {};
+
+	/*! \brief method used to take room for many boids in one allocation, counted against
+		BoidMemory. Every slot must be given a boid with placement new, after which each boid
+		is deleted as usual. The slab is freed when the last of its boids is deleted
+		\param count - the number of boids to make room for, at least one
+		\return the first of count uninitialised slots */
+	static Boid* AllocateSlab( size_t count );
 	
 	/*! \brief this method draws the boid at location Pos and with orientation
 		defined by the current velocity
@@ -37,18 +70,120 @@ public:
 		drawing simple shadows on the ground */
 	void Draw(float floorHeight) const;
 
-	unsigned int id() { return m_id; };
+	unsigned int id() const { return m_id; };
+
+	int flockID() const { return m_flock_id; };
 
 	const Imath::V3f& pos() const { return m_pos; };
 
 	const Imath::V3f& vel() const { return m_vel; };
 
+	/*! \brief returns the pitch, yaw and roll of the boid in radians. Worked out from the
+		velocity and bank when asked, so only call it where Euler angles are really needed */
+	Imath::V3f dir() const;
+
+	/*! \brief method to get the boid's orientation as the axes of its local frame. The same
+		rotation as the pitch, yaw and roll of dir, found with one square root and no trig
+		\param side - filled out with the local x axis
+		\param up - filled out with the local y axis
+		\param forward - filled out with the local z axis, which the boid points along */
+	void Orientation( Imath::V3f& side, Imath::V3f& up, Imath::V3f& forward ) const;
+
 	void accelerate( const Imath::V3f& acc ) { m_acc += acc; };
 
-	void update( const Flock::Behaviour& behaviour );
+	/*! \brief returns the acceleration gathered so far this step */
+	const Imath::V3f& acc() const { return m_acc; };
+
+	/*! \brief returns the clamped acceleration used in the last update */
+	const Imath::V3f& lastAcc() const { return m_lastAcc; };
+
+	/*! \brief true while the boid is coasting on its last acceleration instead of running the behaviours */
+	bool asleep() const { return m_sleepCountdown > 0; };
+
+	/*! \brief true if the boid has been quiet since at least its last update */
+	bool settling() const { return m_quietSteps > 0; };
+
+	/*! \brief records a signature of the flock mates near the boid, so Settle can tell if they change
+		\param signature - a value summarising the IDs of the nearby flock mates */
+	void setNeighbourhood( unsigned int signature )
+	{
+		m_neighbourhoodChanged = ( signature != m_neighbourhood );
+		m_neighbourhood = signature;
+	};
+
+	/*! \brief decides whether the boid sleeps through the next steps. Called before update with the
+		acceleration gathered from the behaviours. Boids that stay quiet for long enough fall asleep,
+		and wake when pushed, when woken by a neighbour or briefly every few steps to look around
+		\param sleeping - the world's sleep settings
+		\param woken - true if a disturbed neighbour came close during this step */
+	void Settle( const World::Sleeping& sleeping, bool woken );
+
+	/*! \brief wakes the boid so that it runs the behaviours at the next step */
+	void wake() { m_sleepCountdown = 0; m_quietSteps = 0; };
+
+	/*! \brief method used to remember the prey the boid is chasing
+		\param flockID - the flock ID of the prey
+		\param boidID - the ID of the prey within its flock
+		\param hold - the number of steps to chase it for, including this one */
+	void setTarget( int flockID, unsigned int boidID, unsigned int hold )
+	{
+		m_targetFlock = flockID;
+		m_targetID = boidID;
+		m_targetHold = hold > 0 ? hold - 1 : 0;
+	};
+
+	/*! \brief true if the boid should carry on chasing the prey it chased last step */
+	bool holdingTarget() const { return m_targetHold > 0; };
+
+	/*! \brief uses up one of the steps the boid keeps its prey for */
+	void holdTarget() { --m_targetHold; };
+
+	int targetFlock() const { return m_targetFlock; };
+	unsigned int targetID() const { return m_targetID; };
+
+	/*! \brief true if the boid is a copy of one simulated by a neighbouring domain, there
+		only for the boids nearby to see for a single step */
+	bool ghost() const { return m_ghost; };
+	void setGhost( bool ghost ) { m_ghost = ghost; };
+
+	/*! \brief this method integrates the acceleration gathered from the behaviours and
+		updates the boid's orientation, then clears the acceleration
+		\param behaviour - the limits on the boid's motion
+		\param timeStep - the length of the step in seconds
+		\param integrator - the integration scheme to use */
+	void update( const Flock::Behaviour& behaviour, float timeStep = 0.04f,
+		World::Integrator integrator = World::SemiImplicitEuler );
+
+	/*! \brief used instead of update when the flock integrates its boids as a batch. Stores
+		the new motion and then updates the orientation and clears the acceleration like update
+		\param pos - the new position
+		\param vel - the new velocity
+		\param acc - the clamped acceleration
+		\param preClampAcc - the length of the acceleration before it was clamped
+		\param behaviour - the flock's behaviour, used for banking */
+	void Integrated( const Imath::V3f& pos, const Imath::V3f& vel, const Imath::V3f& acc,
+		float preClampAcc, const Flock::Behaviour& behaviour );
+
+	/*! \brief writes the complete state of the boid to a binary checkpoint stream
+		\param out - the stream to write to */
+	void Save( std::ostream& out ) const;
+
+	/*! \brief restores the state written by Save, overwriting every member
+		\param in - the stream to read from
+		\return false if the stream ended early */
+	bool Load( std::istream& in );
 
 private:
 
+	/*! \brief updates the roll from the sideways part of the clamped acceleration, then
+		stores and clears the acceleration
+		\param behaviour - the flock's banking settings
+		\param preClampAcc - the length of the acceleration before it was clamped */
+	void Bank( const Flock::Behaviour& behaviour, float preClampAcc );
+
+	/*! \brief sets everything but the IDs, position and velocity to the state of a new boid */
+	void Rest();
+
 	/*! Integer ID for the boid within the flock */
 	unsigned m_id;
 
@@ -63,14 +198,38 @@ private:
 	
 	/*! 3-dimensional vector specifying the boid's acceleration at the latest time step */
 	Imath::V3f m_acc;
+
+	/*! The clamped acceleration used in the previous step, needed by the Verlet integrator */
+	Imath::V3f m_lastAcc;
 	
-	/*! 3-dimensional vector in which each component is the boid's rotation
-	 * around a particular access. For example, Dir.x is the pitch of the boid
-	 * in radians, ie. the rotation around the x axis */
-	Imath::V3f m_dir;
+	/*! Cosine and sine of the boid's roll. Its heading comes straight from the
+	 * velocity, so this is all of the orientation that needs storing */
+	float m_bankCos;
+	float m_bankSin;
 	
 	/*! An STL vector of the old rotation values associated with the roll of the boid */
-	std::vector<float> m_old_roll;
+	typedef std::vector< float, TrackedAllocator<float, BankingMemory> > RollHistory;
+	RollHistory m_old_roll;
+
+	/*! Number of steps in a row the boid's acceleration and neighbourhood have stayed quiet */
+	unsigned int m_quietSteps;
+
+	/*! Steps left before a sleeping boid wakes to look around. Zero when awake */
+	unsigned int m_sleepCountdown;
+
+	/*! Signature of the flock mates near the boid at its last behaviour run */
+	unsigned int m_neighbourhood;
+
+	/*! True if the signature changed at the last behaviour run */
+	bool m_neighbourhoodChanged;
+
+	/*! Flock and boid IDs of the prey being chased, and the steps left before looking for the nearest again */
+	int m_targetFlock;
+	unsigned int m_targetID;
+	unsigned int m_targetHold;
+
+	/*! True for copies of boids from a neighbouring domain. Never saved, ghosts only last a step */
+	bool m_ghost;
 };
 
 }; // Flock
@@ -0,0 +1,194 @@
+#include "BoidFile.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*!
+\file BoidFile.cpp
+\brief contains methods for the boid file reader and writer classes
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/*! Identifies boid files and the layout version they were written with */
+static const char s_boidFileMagic[4] = { 'F', 'B', 'D', 'S' };
+static const uint32_t s_boidFileVersion = 1;
+
+/* Constructor:
+*  ------------
+*	Starts with no file open.
+*/
+BoidFileReader::BoidFileReader()
+ :	m_file( -1 ),
+	m_count( 0 ),
+	m_window( NULL ),
+	m_windowSize( 0 )
+{
+
+}
+
+
+BoidFileReader::~BoidFileReader()
+{
+	Close();
+}
+
+
+/* Open:
+*  -----
+*	Only the header is read. The size of the file has to match
+*	the count it gives, so a truncated file is caught before
+*	any boids are made from it.
+*/
+bool BoidFileReader::Open(const std::string& filename)
+{
+	Close();
+
+	m_file = open(filename.c_str(), O_RDONLY);
+
+	if(m_file < 0)
+	{
+		std::cout << "Boid file " << filename << " not found" << std::endl;
+		return false;
+	}
+
+	BoidFileHeader header;
+	struct stat status;
+
+	if(read(m_file, &header, sizeof(header)) != ssize_t(sizeof(header)) || fstat(m_file, &status) != 0
+		|| memcmp(header.magic, s_boidFileMagic, sizeof(s_boidFileMagic)) != 0 || header.version != s_boidFileVersion)
+	{
+		std::cout << "Error: " << filename << " is not a boid file" << std::endl;
+		Close();
+		return false;
+	}
+
+	// The count is checked against the records there is room for before it is multiplied, so a
+	// corrupt count can't wrap round to a size that matches
+	uint64_t room = (uint64_t(status.st_size) - sizeof(BoidFileHeader)) / sizeof(BoidFileRecord);
+
+	if(header.count > room || uint64_t(status.st_size) != sizeof(BoidFileHeader) + header.count * sizeof(BoidFileRecord))
+	{
+		std::cout << "Error: boid file " << filename << " does not hold the " << header.count << " boids it should" << std::endl;
+		Close();
+		return false;
+	}
+
+	m_count = header.count;
+
+	return true;
+}
+
+
+void BoidFileReader::Close()
+{
+	Unmap();
+
+	if(m_file >= 0) { close(m_file); }
+
+	m_file = -1;
+	m_count = 0;
+}
+
+
+/* Map:
+*  ----
+*	Mappings have to start on a page, so the window starts at
+*	the page holding the first record. The kernel is told the
+*	window will be read straight through.
+*/
+const BoidFileRecord* BoidFileReader::Map(uint64_t first, uint64_t number)
+{
+	Unmap();
+
+	if(m_file < 0 || first + number > m_count || number == 0) { return NULL; }
+
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	uint64_t start = sizeof(BoidFileHeader) + first * sizeof(BoidFileRecord);
+	uint64_t offset = start / page * page;
+
+	m_windowSize = start - offset + number * sizeof(BoidFileRecord);
+	m_window = mmap(NULL, m_windowSize, PROT_READ, MAP_PRIVATE, m_file, offset);
+
+	if(m_window == MAP_FAILED)
+	{
+		m_window = NULL;
+		m_windowSize = 0;
+		return NULL;
+	}
+
+	madvise(m_window, m_windowSize, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+	return reinterpret_cast<const BoidFileRecord*>(static_cast<const char*>(m_window) + (start - offset));
+}
+
+
+void BoidFileReader::Unmap()
+{
+	if(m_window) { munmap(m_window, m_windowSize); }
+
+	m_window = NULL;
+	m_windowSize = 0;
+}
+
+
+/* Open:
+*  -----
+*	Writes the header with a count of zero, filled in by Close.
+*/
+bool BoidFileWriter::Open(const std::string& filename)
+{
+	m_out.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	m_count = 0;
+
+	if(!m_out.is_open())
+	{
+		std::cout << "Unable to write boid file " << filename << std::endl;
+		return false;
+	}
+
+	BoidFileHeader header;
+	memcpy(header.magic, s_boidFileMagic, sizeof(s_boidFileMagic));
+	header.version = s_boidFileVersion;
+	header.count = 0;
+
+	m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	return m_out.good();
+}
+
+
+void BoidFileWriter::Add(const Imath::V3f& pos, const Imath::V3f& vel)
+{
+	BoidFileRecord record;
+	record.pos[0] = pos.x; record.pos[1] = pos.y; record.pos[2] = pos.z;
+	record.vel[0] = vel.x; record.vel[1] = vel.y; record.vel[2] = vel.z;
+
+	m_out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	++m_count;
+}
+
+
+bool BoidFileWriter::Close()
+{
+	if(!m_out.is_open()) { return false; }
+
+	m_out.seekp(offsetof(BoidFileHeader, count));
+	m_out.write(reinterpret_cast<const char*>(&m_count), sizeof(m_count));
+
+	bool good = m_out.good();
+	m_out.close();
+
+	return good;
+}
+
+} // Flock
@@ -0,0 +1,105 @@
+#ifndef __BOIDFILE_H__
+#define __BOIDFILE_H__
+
+#include <string>
+#include <fstream>
+#include <stdint.h>
+
+#include <ImathVec.h>
+
+/*!
+\file BoidFile.h
+\brief binary files of initial boid positions and velocities, read a chunk at a time through a
+	memory mapped window so flocks of millions of boids can be loaded without reading the whole
+	file in first
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+/*! Start of a boid file, followed by count records */
+struct BoidFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t count;
+};
+
+/*! One boid's initial state */
+struct BoidFileRecord
+{
+	float pos[3];
+	float vel[3];
+};
+
+class BoidFileReader
+{
+public:
+
+	/*! Default empty constructor for the class */
+	BoidFileReader();
+
+	/*! \brief destructor unmaps the window and closes the file */
+	~BoidFileReader();
+
+	/*! \brief method used to open a boid file and check its header
+		\param filename - the path of the file
+		\return false if the file could not be opened, is not a boid file or is truncated */
+	bool Open(const std::string& filename);
+
+	/*! \brief method used to unmap any records still mapped and close the file. Called by Open and
+		the destructor, and safe to call when no file is open */
+	void Close();
+
+	/*! \brief returns the number of boids in the file */
+	uint64_t count() const { return m_count; };
+
+	/*! \brief method used to map a run of records, unmapping the last run mapped. The records
+		stay valid until the next call to Map or Close
+		\param first - the index of the first record
+		\param number - the number of records, which must not run past the end of the file
+		\return the records, or null if they could not be mapped */
+	const BoidFileRecord* Map(uint64_t first, uint64_t number);
+
+private:
+
+	BoidFileReader(const BoidFileReader&);
+	BoidFileReader& operator=(const BoidFileReader&);
+
+	void Unmap();
+
+	int m_file;
+	uint64_t m_count;
+
+	/*! The window currently mapped, which starts on a page boundary at or before the records asked for */
+	void* m_window;
+	size_t m_windowSize;
+};
+
+class BoidFileWriter
+{
+public:
+
+	/*! \brief method used to create a boid file, replacing any already there
+		\param filename - the path of the file
+		\return false if the file could not be created */
+	bool Open(const std::string& filename);
+
+	/*! \brief method used to add a boid's initial state to the file */
+	void Add(const Imath::V3f& pos, const Imath::V3f& vel);
+
+	/*! \brief method used to fill in the number of boids in the header and close the file
+		\return false if anything could not be written */
+	bool Close();
+
+private:
+
+	std::ofstream m_out;
+	uint64_t m_count;
+};
+
+}; // Flock
+
+#endif
@@ -0,0 +1,151 @@
+#include "DistanceField.h"
+
+#include "Object.h"
+#include "ObjectBVH.h"
+
+#include <cmath>
+#include <algorithm>
+
+/*!
+\file DistanceField.cpp
+\brief contains methods for the distance field class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/* Constructor:
+*  ------------
+*	Creates an empty field
+*/
+DistanceField::DistanceField()
+ :	m_min( 0.0f, 0.0f, 0.0f ),
+	m_cellSize( 1.0f )
+{
+	m_size[0] = m_size[1] = m_size[2] = 0;
+}
+
+
+/* Bake:
+*  -----
+*	Finds the distance from each grid point to the surface of the
+*	nearest static object. Only objects within the band are looked
+*	at, so the cost depends on how crowded the objects are rather
+*	than how many there are.
+*/
+void DistanceField::Bake(const std::vector<Object*>& objects, const ObjectBVH& tree,
+		const Imath::V3f& min, const Imath::V3f& max, float cellSize, float band)
+{
+	m_min = min;
+	m_cellSize = cellSize > 0.0f ? cellSize : 1.0f;
+
+	Imath::V3f extent = max - min;
+
+	// Coarsen the grid until it fits
+	for(;;)
+	{
+		double points = 1.0;
+
+		for(unsigned int i=0; i < 3; ++i)
+		{
+			m_size[i] = (unsigned int)std::ceil(std::max(extent[i], 0.0f) / m_cellSize) + 1;
+			if(m_size[i] < 2) { m_size[i] = 2; }
+			points *= m_size[i];
+		}
+
+		if(points <= MaxPoints) { break; }
+
+		m_cellSize *= float(std::max(std::pow(points / MaxPoints, 1.0 / 3.0), 1.01));
+	}
+
+	m_distances.assign(m_size[0] * m_size[1] * m_size[2], band);
+
+	float searchRadius = band + Object::radius();
+
+	#pragma omp parallel
+	{
+		std::vector<unsigned int> nearby;
+
+		#pragma omp for schedule(static)
+		for(int z=0; z < int(m_size[2]); ++z)
+		{
+			for(unsigned int y=0; y < m_size[1]; ++y)
+			{
+				for(unsigned int x=0; x < m_size[0]; ++x)
+				{
+					Imath::V3f point = m_min + Imath::V3f(x, y, z) * m_cellSize;
+
+					tree.Query(point, searchRadius, nearby);
+
+					float distance = band;
+
+					for(unsigned int o=0; o < nearby.size(); ++o)
+					{
+						const Object* object = objects[nearby[o]];
+
+						if(object->moving()) { continue; }
+
+						distance = std::min(distance, (point - object->pos()).length() - Object::radius());
+					}
+
+					m_distances[(z * m_size[1] + y) * m_size[0] + x] = distance;
+				}
+			}
+		}
+	}
+}
+
+
+/* Sample:
+*  -------
+*	Blends the eight grid points around the position. The gradient
+*	is the derivative of the same blend, so it is consistent with
+*	the distance returned.
+*/
+bool DistanceField::Sample(const Imath::V3f& position, float& distance, Imath::V3f& gradient) const
+{
+	if(m_distances.empty()) { return false; }
+
+	unsigned int cell[3];
+	float t[3];
+
+	for(unsigned int i=0; i < 3; ++i)
+	{
+		float f = (position[i] - m_min[i]) / m_cellSize;
+		f = std::min(std::max(f, 0.0f), float(m_size[i] - 1));
+
+		cell[i] = std::min((unsigned int)f, m_size[i] - 2);
+		t[i] = f - cell[i];
+	}
+
+	unsigned int x = cell[0], y = cell[1], z = cell[2];
+
+	float c000 = At(x, y, z),         c100 = At(x + 1, y, z);
+	float c010 = At(x, y + 1, z),     c110 = At(x + 1, y + 1, z);
+	float c001 = At(x, y, z + 1),     c101 = At(x + 1, y, z + 1);
+	float c011 = At(x, y + 1, z + 1), c111 = At(x + 1, y + 1, z + 1);
+
+	// Blend along x first
+	float c00 = c000 + (c100 - c000) * t[0];
+	float c10 = c010 + (c110 - c010) * t[0];
+	float c01 = c001 + (c101 - c001) * t[0];
+	float c11 = c011 + (c111 - c011) * t[0];
+
+	float c0 = c00 + (c10 - c00) * t[1];
+	float c1 = c01 + (c11 - c01) * t[1];
+
+	distance = c0 + (c1 - c0) * t[2];
+
+	float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * t[1];
+	float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * t[1];
+
+	gradient.x = (dx0 + (dx1 - dx0) * t[2]) / m_cellSize;
+	gradient.y = ((c10 - c00) + ((c11 - c01) - (c10 - c00)) * t[2]) / m_cellSize;
+	gradient.z = (c1 - c0) / m_cellSize;
+
+	return true;
+}
+
+} // Flock
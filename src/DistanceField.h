@@ -0,0 +1,80 @@
+#ifndef __DISTANCEFIELD_H__
+#define __DISTANCEFIELD_H__
+
+#include <vector>
+
+#include <ImathVec.h>
+
+/*!
+\file DistanceField.h
+\brief signed distance grid baked from the static objects in the world
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class Object;
+class ObjectBVH;
+
+class DistanceField
+{
+public:
+
+	/*! Default empty constructor for the class */
+	DistanceField();
+
+	/*! \brief method used to bake the distance to the nearest static object surface at every point
+		of a regular grid. Distances are only exact within 'band' of a surface, further away
+		they are clamped to 'band'. Objects with a velocity are left out.
+		\param objects - the objects in the world
+		\param tree - a hierarchy built over the same objects, used to find nearby objects quickly
+		\param min - the lowest corner of the grid
+		\param max - the highest corner of the grid
+		\param cellSize - the spacing between grid points. Increased if the grid would be too large
+		\param band - the distance from a surface beyond which the field is not needed */
+	void Bake(const std::vector<Object*>& objects, const ObjectBVH& tree,
+			const Imath::V3f& min, const Imath::V3f& max, float cellSize, float band);
+
+	/*! \brief method used to look up the field with trilinear interpolation. Points outside the
+		grid use the nearest edge of the grid
+		\param position - the point to look up
+		\param distance - filled out with the distance to the nearest surface, negative inside an object
+		\param gradient - filled out with the gradient of the distance, pointing away from the surface
+		\return false if the field has not been baked */
+	bool Sample(const Imath::V3f& position, float& distance, Imath::V3f& gradient) const;
+
+	bool empty() const { return m_distances.empty(); };
+
+	/*! \brief empties the field so that it will be baked again */
+	void Clear() { m_distances.clear(); };
+
+	float cellSize() const { return m_cellSize; };
+
+private:
+
+	/*! \brief returns the grid value at grid point (x, y, z) */
+	float At(unsigned int x, unsigned int y, unsigned int z) const
+	{
+		return m_distances[(z * m_size[1] + y) * m_size[0] + x];
+	}
+
+	/*! Largest number of grid points Bake will create */
+	static const unsigned int MaxPoints = 1 << 24;
+
+	/*! Position of the first grid point */
+	Imath::V3f m_min;
+
+	float m_cellSize;
+
+	/*! Number of grid points along each axis */
+	unsigned int m_size[3];
+
+	/*! Distance at each grid point, x varying fastest */
+	std::vector<float> m_distances;
+};
+
+}; // Flock
+
+#endif
@@ -0,0 +1,421 @@
+#include "Domain.h"
+
+#include "World.h"
+#include "Flock.h"
+#include "Boid.h"
+#include "Serialise.h"
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cfloat>
+#include <cerrno>
+
+#include <stdint.h>
+#include <unistd.h>
+
+/*!
+\file Domain.cpp
+\brief contains methods for the domain class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/* Constructor:
+*  ------------
+*	Works out the slab from the world's bounds. The slabs at
+*	either end carry on past the bounds, as boids can stray
+*	outside them before being pushed back.
+*/
+Domain::Domain(World& world, unsigned int index, unsigned int numDomains, int left, int right)
+ :	m_world( world ),
+	m_index( index ),
+	m_numDomains( numDomains ? numDomains : 1 ),
+	m_left( left ),
+	m_right( right ),
+	m_halo( 0.0f ),
+	m_failed( false )
+{
+	float width = (world.maxX - world.minX) / m_numDomains;
+
+	m_lower = index == 0 ? -FLT_MAX : world.minX + width * index;
+	m_upper = index + 1 >= m_numDomains ? FLT_MAX : world.minX + width * (index + 1);
+}
+
+
+/* Destructor:
+*  -----------
+*	The domain owns the sockets it was given.
+*/
+Domain::~Domain()
+{
+	if(m_left >= 0) { close(m_left); }
+	if(m_right >= 0) { close(m_right); }
+}
+
+
+/* Partition:
+*  ----------
+*	The ghost zone has to cover the furthest any boid looks
+*	at another: flock mates within the boid test radius,
+*	predators within the flee radius and prey close enough to
+*	catch. Objects are loaded into every domain so the object
+*	test radius doesn't need covering.
+*/
+void Domain::Partition()
+{
+	m_halo = 0.7f;
+
+	for(unsigned int f=0; f < m_world.flocks.size(); ++f)
+	{
+		Flock* flock = m_world.flocks[f];
+
+		m_halo = std::max(m_halo, std::max(flock->boidTestRadius(), flock->fleeTestRadius()));
+
+		std::vector<unsigned char> outside(flock->boids().size());
+
+		for(unsigned int b=0; b < outside.size(); ++b)
+		{
+			float x = flock->boids()[b]->pos().x;
+			outside[b] = (x < m_lower || x >= m_upper);
+		}
+
+		std::vector<Boid*> removed;
+		flock->Release(outside, removed);
+
+		for(unsigned int b=0; b < removed.size(); ++b)
+			delete removed[b];
+	}
+}
+
+
+/* BeginStep:
+*  ----------
+*	The flock centre has to be the centre of the whole flock,
+*	so the sums over each domain are added up first. Then the
+*	boids near each boundary are copied across as ghosts.
+*/
+bool Domain::BeginStep()
+{
+	if(m_failed) { return false; }
+
+	unsigned int numFlocks = m_world.flocks.size();
+
+	std::vector<double> sums(numFlocks * 4, 0.0);
+
+	for(unsigned int f=0; f < numFlocks; ++f)
+	{
+		const Flock::BoidList& boids = m_world.flocks[f]->boids();
+
+		for(unsigned int b=0; b < boids.size(); ++b)
+		{
+			sums[f*4] += boids[b]->pos().x;
+			sums[f*4 + 1] += boids[b]->pos().y;
+			sums[f*4 + 2] += boids[b]->pos().z;
+		}
+		sums[f*4 + 3] = boids.size();
+	}
+
+	if(!AllReduce(sums)) { return false; }
+
+	for(unsigned int f=0; f < numFlocks; ++f)
+	{
+		double count = sums[f*4 + 3];
+
+		if(count > 0.0)
+			m_world.flocks[f]->shareCentre(Imath::V3f(sums[f*4] / count, sums[f*4 + 1] / count, sums[f*4 + 2] / count));
+	}
+
+	std::string toLeft, toRight, fromLeft, fromRight;
+	Pack(toLeft, toRight, m_lower + m_halo, m_upper - m_halo, true);
+
+	if(!Exchange(toLeft, toRight, fromLeft, fromRight)) { return false; }
+
+	return Unpack(fromLeft, true) && Unpack(fromRight, true);
+}
+
+
+/* EndStep:
+*  --------
+*	Ghosts are dropped whether or not they were killed, then
+*	any boid that has left the slab moves to the next one.
+*	A boid can only cross one boundary per step this way,
+*	which the slabs are far too wide for boids to outrun.
+*/
+bool Domain::EndStep()
+{
+	for(unsigned int f=0; f < m_world.flocks.size(); ++f)
+	{
+		std::vector<Boid*> removed;
+		m_world.flocks[f]->ReleaseGhosts(removed);
+
+		for(unsigned int b=0; b < removed.size(); ++b)
+			delete removed[b];
+	}
+
+	if(m_failed) { return false; }
+
+	std::string toLeft, toRight, fromLeft, fromRight;
+	Pack(toLeft, toRight, m_lower, m_upper, false);
+
+	if(!Exchange(toLeft, toRight, fromLeft, fromRight)) { return false; }
+
+	return Unpack(fromLeft, false) && Unpack(fromRight, false);
+}
+
+
+/* Pack:
+*  -----
+*	Each buffer holds, for every flock in turn, a count then
+*	the boids as written by Boid::Save. The flocks are the
+*	same in every domain as they all loaded the same scene.
+*/
+void Domain::Pack(std::string& toLeft, std::string& toRight, float leftEdge, float rightEdge, bool copy)
+{
+	std::ostringstream left, right;
+
+	for(unsigned int f=0; f < m_world.flocks.size(); ++f)
+	{
+		Flock* flock = m_world.flocks[f];
+		const Flock::BoidList& boids = flock->boids();
+
+		std::vector<unsigned char> side(boids.size(), 0);
+		unsigned int numLeft = 0, numRight = 0;
+
+		for(unsigned int b=0; b < boids.size(); ++b)
+		{
+			float x = boids[b]->pos().x;
+
+			if(m_left >= 0 && x < leftEdge)
+			{
+				side[b] = 1;
+				++numLeft;
+			}
+			else if(m_right >= 0 && x >= rightEdge)
+			{
+				side[b] = 2;
+				++numRight;
+			}
+		}
+
+		Write(left, numLeft);
+		Write(right, numRight);
+
+		for(unsigned int b=0; b < boids.size(); ++b)
+		{
+			if(side[b] == 1)
+				boids[b]->Save(left);
+			else if(side[b] == 2)
+				boids[b]->Save(right);
+		}
+
+		if(copy || numLeft + numRight == 0) { continue; }
+
+		std::vector<Boid*> removed;
+		flock->Release(side, removed);
+
+		for(unsigned int b=0; b < removed.size(); ++b)
+			delete removed[b];
+
+		m_world.stats.migratedBoids += removed.size();
+	}
+
+	toLeft = left.str();
+	toRight = right.str();
+}
+
+
+/* Unpack:
+*  -------
+*	Reads back the boids written by Pack into their flocks.
+*/
+bool Domain::Unpack(const std::string& buffer, bool ghost)
+{
+	if(buffer.empty()) { return true; }
+
+	std::istringstream in(buffer);
+
+	for(unsigned int f=0; f < m_world.flocks.size(); ++f)
+	{
+		Flock* flock = m_world.flocks[f];
+
+		unsigned int numBoids = 0;
+		if(!Read(in, numBoids)) { return Fail("boids from a neighbour were cut short"); }
+
+		std::vector<Boid*> received;
+		received.reserve(numBoids);
+
+		for(unsigned int b=0; b < numBoids; ++b)
+		{
+			Boid* newBoid = new Boid(0, flock->id(), 0.0, 0.0, 0.0, 0.0);
+
+			if(!newBoid->Load(in))
+			{
+				delete newBoid;
+
+				for(unsigned int r=0; r < received.size(); ++r)
+					delete received[r];
+
+				return Fail("boids from a neighbour were cut short");
+			}
+
+			received.push_back(newBoid);
+		}
+
+		// Ghosts go in together without disturbing the flock's own boids
+		if(ghost)
+		{
+			flock->AddGhosts(received);
+			m_world.stats.ghostBoids += numBoids;
+		}
+		else
+		{
+			for(unsigned int r=0; r < received.size(); ++r)
+				flock->AddBoid(received[r]);
+		}
+	}
+
+	return true;
+}
+
+
+/* Exchange:
+*  ---------
+*	Everyone sends right then listens left, then sends left
+*	and listens right. The domain at the right hand end has
+*	nothing to send in the first half so it listens straight
+*	away, and the left hand end likewise in the second, which
+*	lets the others go on in turn however full the sockets get.
+*/
+bool Domain::Exchange(const std::string& toLeft, const std::string& toRight,
+	std::string& fromLeft, std::string& fromRight)
+{
+	if(m_right >= 0 && !Send(m_right, toRight)) { return Fail("unable to send to the right"); }
+	if(m_left >= 0 && !Receive(m_left, fromLeft)) { return Fail("unable to receive from the left"); }
+	if(m_left >= 0 && !Send(m_left, toLeft)) { return Fail("unable to send to the left"); }
+	if(m_right >= 0 && !Receive(m_right, fromRight)) { return Fail("unable to receive from the right"); }
+
+	return true;
+}
+
+
+/* AllReduce:
+*  ----------
+*	Partial sums pass along to the right hand end, which then
+*	holds the totals and passes them back.
+*/
+bool Domain::AllReduce(std::vector<double>& values)
+{
+	unsigned int size = values.size() * sizeof(double);
+	std::string buffer;
+
+	if(m_left >= 0)
+	{
+		if(!Receive(m_left, buffer) || buffer.size() != size) { return Fail("unable to receive sums from the left"); }
+
+		const double* partial = reinterpret_cast<const double*>(buffer.data());
+
+		for(unsigned int v=0; v < values.size(); ++v)
+			values[v] += partial[v];
+	}
+
+	if(m_right >= 0)
+	{
+		if(!Send(m_right, std::string(reinterpret_cast<const char*>(&values[0]), size))) { return Fail("unable to send sums to the right"); }
+		if(!Receive(m_right, buffer) || buffer.size() != size) { return Fail("unable to receive totals from the right"); }
+
+		std::copy(reinterpret_cast<const double*>(buffer.data()),
+			reinterpret_cast<const double*>(buffer.data()) + values.size(), values.begin());
+	}
+
+	if(m_left >= 0 && !Send(m_left, std::string(reinterpret_cast<const char*>(&values[0]), size)))
+		return Fail("unable to send totals to the left");
+
+	return true;
+}
+
+
+/* Send:
+*  -----
+*	Writes can be cut short by signals or a full socket,
+*	so keep going until everything is written.
+*/
+bool Domain::Send(int socket, const std::string& buffer)
+{
+	uint64_t length = buffer.size();
+	std::string message(reinterpret_cast<const char*>(&length), sizeof(length));
+	message += buffer;
+
+	size_t sent = 0;
+
+	while(sent < message.size())
+	{
+		ssize_t written = write(socket, message.data() + sent, message.size() - sent);
+
+		if(written < 0 && errno == EINTR) { continue; }
+		if(written <= 0) { return false; }
+
+		sent += written;
+	}
+
+	return true;
+}
+
+
+/* Receive:
+*  --------
+*	Reads the length then the buffer.
+*/
+bool Domain::Receive(int socket, std::string& buffer)
+{
+	uint64_t length = 0;
+	char* into = reinterpret_cast<char*>(&length);
+	size_t wanted = sizeof(length);
+
+	for(unsigned int part=0; part < 2; ++part)
+	{
+		size_t got = 0;
+
+		while(got < wanted)
+		{
+			ssize_t bytes = read(socket, into + got, wanted - got);
+
+			if(bytes < 0 && errno == EINTR) { continue; }
+			if(bytes <= 0) { return false; }
+
+			got += bytes;
+		}
+
+		if(part == 0)
+		{
+			buffer.resize(length);
+			if(length == 0) { return true; }
+
+			into = &buffer[0];
+			wanted = length;
+		}
+	}
+
+	return true;
+}
+
+
+/* Fail:
+*  -----
+*	Once a neighbour has gone there is no way to keep the
+*	domains in step, so this one carries on by itself.
+*/
+bool Domain::Fail(const char* what)
+{
+	if(!m_failed)
+		std::cout << "Error: domain " << m_index << " " << what << ", stopping" << std::endl;
+
+	m_failed = true;
+
+	return false;
+}
+
+} // Flock
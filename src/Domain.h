@@ -0,0 +1,114 @@
+#ifndef __DOMAIN_H__
+#define __DOMAIN_H__
+
+#include <string>
+#include <vector>
+
+/*!
+\file Domain.h
+\brief splits the world into slabs along x, each simulated by its own process, exchanging
+	boids near the boundaries with the processes either side
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+
+class Domain
+{
+public:
+
+	/*! \brief constructor for the class. Every process loads the same scene, then this process
+		keeps the boids in its own slab of the world's x range once Partition is called
+		\param world - the world this process simulates. Set world.domain to this domain to use it
+		\param index - which slab this process simulates, counting from minX
+		\param numDomains - the number of slabs the world is split into
+		\param left - connected socket to the process simulating slab index - 1, or -1 for none
+		\param right - connected socket to the process simulating slab index + 1, or -1 for none */
+	Domain(World& world, unsigned int index, unsigned int numDomains, int left, int right);
+
+	/*! \brief closes the sockets */
+	~Domain();
+
+	/*! \brief method used to delete the boids outside this domain's slab and to find the width of
+		the ghost zone from the flocks' test radii. Call once the scene has been loaded */
+	void Partition();
+
+	/*! \brief method used before each step. Shares each flock's centre across every domain, then
+		copies the boids within the ghost zone of each boundary to the process on the other side
+		and adds the copies it is sent as ghosts
+		\return false if a neighbour could not be reached */
+	bool BeginStep();
+
+	/*! \brief method used after each step. Deletes the ghosts, then hands the boids that have
+		crossed a boundary to the process on the other side and adopts those it is sent
+		\return false if a neighbour could not be reached */
+	bool EndStep();
+
+	unsigned int index() const { return m_index; };
+	float lower() const { return m_lower; };
+	float upper() const { return m_upper; };
+
+	/*! \brief returns the distance either side of a boundary within which boids are copied across */
+	float halo() const { return m_halo; };
+
+	/*! \brief returns true once communication with a neighbour has failed. BeginStep and EndStep
+		then return false, and World::Update stops the step and reports it */
+	bool failed() const { return m_failed; };
+
+private:
+
+	/*! \brief method used to send a buffer to a neighbour and receive one back from each,
+		sending right before left so that no two domains wait on each other */
+	bool Exchange(const std::string& toLeft, const std::string& toRight,
+		std::string& fromLeft, std::string& fromRight);
+
+	/*! \brief method used to sum a list of values over every domain, passing the partial sums
+		along the chain and the totals back */
+	bool AllReduce(std::vector<double>& values);
+
+	/*! \brief writes a length then the bytes of a buffer to a socket */
+	bool Send(int socket, const std::string& buffer);
+
+	/*! \brief reads a buffer written by Send */
+	bool Receive(int socket, std::string& buffer);
+
+	/*! \brief method used to take boids out of the flocks and write them to buffers for each side
+		\param toLeft - filled with the boids for the left neighbour, one list per flock
+		\param toRight - filled with the boids for the right neighbour
+		\param leftEdge - boids with x below this go left
+		\param rightEdge - boids with x at or above this go right
+		\param copy - true sends copies and keeps the boids, false moves them */
+	void Pack(std::string& toLeft, std::string& toRight, float leftEdge, float rightEdge, bool copy);
+
+	/*! \brief method used to add the boids written by Pack to the flocks
+		\param buffer - the boids received
+		\param ghost - true marks them as ghosts */
+	bool Unpack(const std::string& buffer, bool ghost);
+
+	/*! \brief reports a failure once and stops any further communication */
+	bool Fail(const char* what);
+
+	World& m_world;
+
+	unsigned int m_index;
+	unsigned int m_numDomains;
+
+	/*! Sockets to the neighbouring domains, -1 where there is none */
+	int m_left, m_right;
+
+	/*! Extent of the slab in x. The end slabs extend without limit */
+	float m_lower, m_upper;
+
+	/*! Width of the ghost zone either side of each boundary */
+	float m_halo;
+
+	bool m_failed;
+};
+
+}; // Flock
+
+#endif
@@ -3,11 +3,17 @@
 #include "Boid.h"
 #include "World.h"
 #include "Particle.h"
+#include "Serialise.h"
+#include "BoidFile.h"
 
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <algorithm>
+#include <map>
+
+#include <time.h>
 
 #include <GL/gl.h>
 
@@ -21,6 +27,103 @@
 
 namespace Flock {
 
+namespace {
+
+/* Seconds:
+*  --------
+*	A monotonic clock for the timings in the world's stats.
+*/
+double Seconds()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* IDOrder:
+*  --------
+*	Orders boids by ID, for BoidsByID.
+*/
+bool IDOrder(const Boid* first, const Boid* second)
+{
+	return first->id() < second->id();
+}
+
+/* SpreadBits:
+*  -----------
+*	Moves the low ten bits of a value two places apart, so
+*	three of them can be interleaved into a Morton code.
+*/
+uint32_t SpreadBits(uint32_t value)
+{
+	value &= 0x3ff;
+	value = (value | (value << 16)) & 0x030000ff;
+	value = (value | (value << 8)) & 0x0300f00f;
+	value = (value | (value << 4)) & 0x030c30c3;
+	value = (value | (value << 2)) & 0x09249249;
+
+	return value;
+}
+
+/* Spacing:
+*  --------
+*	Mean distance between boids next to each other in a list.
+*/
+double Spacing(const Flock::BoidList& boids)
+{
+	if(boids.size() < 2) { return 0.0; }
+
+	double total = 0.0;
+
+	for(unsigned int b=1; b < boids.size(); ++b)
+		total += (boids[b]->pos() - boids[b-1]->pos()).length();
+
+	return total / (boids.size() - 1);
+}
+
+/* SteerAround:
+*  ------------
+*	The spherical avoidance push from a single object, added
+*	to the total. Shared by the static and moving objects.
+*/
+void SteerAround(const Boid& boid, const Imath::V3f& objectPos, float testRadius, Imath::V3f& Accelerate)
+{
+	Imath::V3f distVec = objectPos - boid.pos();
+	float distance = distVec.length();
+
+	// Check to see if distance to object is within test radius ObjectTR.
+	if(distance < testRadius)
+	{
+		// test to see if object is infront of boid
+		if(boid.vel().dot(distVec) > 0)
+		{
+			Imath::V3f normVel = boid.vel();
+			normVel.normalize();
+
+			Imath::V3f normDist = distVec;
+			normDist.normalize();
+
+			float inPlaneFactor = normDist.dot(normVel);
+
+			// Create vector perpendicular to boids velocity
+			Imath::V3f inPlane = (normVel*inPlaneFactor) - normDist;
+
+			float inPlaneLength = inPlane.length();
+
+			// Create accleration from vector
+			Imath::V3f Accel = inPlane/(inPlaneLength*inPlaneLength*inPlaneLength*inPlaneLength);
+
+			// Scale down acceleration if boids is far from object or already to the side of the object
+			Accel = Accel * (1-(distance/testRadius)) * inPlaneFactor;
+
+			Accelerate = Accelerate + Accel;
+		}
+	}
+}
+
+} // namespace
+
 /* Constructor:
 *  ---------------------
 *	Sets default values for flock properties
@@ -28,19 +131,43 @@ namespace Flock {
 Flock::Flock(int fID, World& theContainer)
  :	m_id( fID ),
 	m_container( theContainer ),
+	m_numMembers( 0 ),
 	m_rank( 0 ),
 	m_containmentAcc( 500 ),
 	m_colour( 1.0f, 1.0f, 1.0f, 1.0f ),
 	m_behaviour( 1.0f, 3.0f ),
+	m_centreShared( false ),
 	m_boidTR( 5.0f ),
 	m_objectTR( 10.0f ),
 	m_fleeTR( 10.f ),
 	m_gravity( 0.0f, -9.8f, 0.0f ),
-	m_null( 0.0f, 0.0f, 0.0f )
+	m_null( 0.0f, 0.0f, 0.0f ),
+	m_numGhosts( 0 ),
+	m_lodLevel( 0 ),
+	m_lodCountdown( 0 ),
+	m_neighbourCacheAge( 0 ),
+	m_sortCountdown( 0 )
 {
 
 }
 
+/* Destructor:
+*  -----------
+*	The flock owns its boids and particles so frees them here.
+*/
+Flock::~Flock()
+{
+	Clear();
+	
+	ParticleList::iterator currentPart = m_particles.begin();
+	ParticleList::iterator endPart = m_particles.end();
+
+	for(; currentPart != endPart; ++currentPart)
+	{
+		delete (*currentPart);
+	}
+	m_particles.clear();
+}
 
 
 /* Clamp function:
@@ -61,19 +188,25 @@ void Flock::Clamp( Imath::V3f &value, float maxValue)
 *  -----------------------------------
 *	Finds a user-specified number of nearest neighbours to the 
 *	boid passed to the function. It returns a vector containing
-*	pointers to those nearest boids.
+*	pointers to those nearest boids. The copy of the flock it
+*	works on is taken from the thread's arena and given back
+*	on return.
 */
-void Flock::NearestNeighbours(std::vector<Boid*>& neighbourBoids, Boid* homeBoid, int numNeighbours)
+void Flock::NearestNeighbours(ScratchBoids& neighbourBoids, Boid* homeBoid, int numNeighbours, unsigned int numCandidates)
 {
+	Arena& arena = m_container.arena();
+	ArenaScope scope(arena);
+
 	// Create a copy of the current boid vector so that
 	// elements can be deleted as needed.
-	std::vector<Boid*> dummyBoids;
-	dummyBoids.assign(m_boids.begin(), m_boids.end());
+	ScratchBoids dummyBoids((ArenaAllocator<Boid*>(arena)));
+	dummyBoids.reserve(numCandidates);
+	dummyBoids.assign(m_boids.begin(), m_boids.begin() + numCandidates);
 	
 	// Set iterators
-	std::vector<Boid*>::iterator currentBoid = dummyBoids.begin();
-	std::vector<Boid*>::iterator endBoid = dummyBoids.end();
-	std::vector<Boid*>::iterator nearestBoid;
+	ScratchBoids::iterator currentBoid = dummyBoids.begin();
+	ScratchBoids::iterator endBoid = dummyBoids.end();
+	ScratchBoids::iterator nearestBoid;
 
 	// Loop through the dummyBoid vector and delete the homeBoid
 	// so that it cannot appear as its own neighbour
@@ -134,6 +267,8 @@ void Flock::NearestNeighbours(std::vector<Boid*>& neighbourBoids, Boid* homeBoid
 
 		dummyBoids.erase(nearestBoid);
 	}
+
+	m_container.stats.neighbourTests += (unsigned long long)numNeighbours * dummyBoids.size();
 }
 
 
@@ -145,8 +280,15 @@ void Flock::NearestNeighbours(std::vector<Boid*>& neighbourBoids, Boid* homeBoid
 */
 void Flock::GetFlockCentre()
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	if(m_centreShared)
+	{
+		m_flockCentre = m_sharedCentre;
+		m_centreShared = false;
+		return;
+	}
+
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end();
 
 	m_flockCentre.setValue(0,0,0);
 
@@ -177,14 +319,20 @@ void Flock::LocalFlockCentring()
 {
 	if( m_numMembers > 1 )
 	{
+		Arena& arena = m_container.arena();
+		ArenaScope scope(arena);
+
 		// Create the vector to store the local flock mates.
-		std::vector<Boid*> nearestNeighbours;
+		ScratchBoids nearestNeighbours((ArenaAllocator<Boid*>(arena)));
 	
-		std::vector<Boid*>::iterator currentNeigh;
-		std::vector<Boid*>::iterator endNeigh;
+		ScratchBoids::iterator currentNeigh;
+		ScratchBoids::iterator endNeigh;
 		
-		std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-		std::vector<Boid*>::iterator endBoid = m_boids.end();
+		// Ghosts are moved by their own domain, so only the flock's own boids need steering
+		unsigned int numOwned = m_boids.size() - m_numGhosts;
+
+		BoidList::iterator currentBoid = m_boids.begin();
+		BoidList::iterator endBoid = m_boids.begin() + numOwned;
 	
 		Imath::V3f AveragePos(0,0,0);
 		Imath::V3f Accelerate;
@@ -193,14 +341,46 @@ void Flock::LocalFlockCentring()
 		
 		if(numNeighbours > m_numMembers-1)
 			numNeighbours = m_numMembers - 1; 
+
+		// Sized up front, as it can't grow inside the arena scope NearestNeighbours opens
+		nearestNeighbours.reserve(numNeighbours);
 		
+		// At level 2 the neighbours found on an earlier run are reused, chosen from the flock's own
+		// boids so that ghosts can come and go. Too few of those and every run searches afresh
+		bool cached = (m_lodLevel == 2 && int(numOwned) > numNeighbours);
+
+		if(cached)
+		{
+			if(m_neighbourCacheAge == 0 || m_neighbourCache.size() != numOwned * numNeighbours)
+				RefreshNeighbourCache(numNeighbours);
+
+			--m_neighbourCacheAge;
+		}
+
+		const unsigned int* cachedNeighbour = cached ? &m_neighbourCache[0] : NULL;
 	
 		// Cycle through all the boids in the flock.
 		while(currentBoid != endBoid)
 		{
-			// Method populates the nearestNeighbours vector with 
-			// pointers to the nearest 'n' flock mates of the current boid.
-			NearestNeighbours(nearestNeighbours, (*currentBoid), numNeighbours);
+			// Sleeping boids coast on their last acceleration without running the behaviours
+			if((*currentBoid)->asleep())
+			{
+				if(cached) { cachedNeighbour += numNeighbours; }
+				++currentBoid;
+				continue;
+			}
+
+			if(cached)
+			{
+				for(int n=0; n < numNeighbours; ++n)
+					nearestNeighbours.push_back(m_boids[*cachedNeighbour++]);
+			}
+			else
+			{
+				// Method populates the nearestNeighbours vector with 
+				// pointers to the nearest 'n' flock mates of the current boid.
+				NearestNeighbours(nearestNeighbours, (*currentBoid), numNeighbours, m_boids.size());
+			}
 	
 			currentNeigh = nearestNeighbours.begin();
 			endNeigh = nearestNeighbours.end();
@@ -235,6 +415,48 @@ void Flock::LocalFlockCentring()
 }
 
 
+/* RefreshNeighbourCache:
+*  ----------------------
+*	Finds the nearest neighbours of every one of the flock's
+*	own boids among the others and stores them by position in
+*	m_boids for reuse at level 2.
+*/
+void Flock::RefreshNeighbourCache(int numNeighbours)
+{
+	Arena& arena = m_container.arena();
+	ArenaScope scope(arena);
+
+	typedef std::pair<const Boid* const, unsigned int> IndexEntry;
+	std::map< const Boid*, unsigned int, std::less<const Boid*>, ArenaAllocator<IndexEntry> > index(std::less<const Boid*>(), (ArenaAllocator<IndexEntry>(arena)));
+
+	unsigned int numOwned = m_boids.size() - m_numGhosts;
+
+	for(unsigned int b=0; b < numOwned; ++b)
+		index[m_boids[b]] = b;
+
+	m_neighbourCache.clear();
+	m_neighbourCache.reserve(numOwned * numNeighbours);
+
+	ScratchBoids nearestNeighbours((ArenaAllocator<Boid*>(arena)));
+	nearestNeighbours.reserve(numNeighbours);
+
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.begin() + numOwned;
+
+	for(; currentBoid != endBoid; ++currentBoid)
+	{
+		NearestNeighbours(nearestNeighbours, (*currentBoid), numNeighbours, numOwned);
+
+		for(unsigned int n=0; n < nearestNeighbours.size(); ++n)
+			m_neighbourCache.push_back(index[nearestNeighbours[n]]);
+
+		nearestNeighbours.clear();
+	}
+
+	m_neighbourCacheAge = std::max(m_container.lod.neighbourRefresh, 1u);
+}
+
+
 /* Global Flock Centring:
 *  ----------------------
 *	Finds the average position of the entire flock
@@ -242,14 +464,16 @@ void Flock::LocalFlockCentring()
 */
 void Flock::GlobalFlockCentring()	// Clamped
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 
 	Imath::V3f Accelerate;
 	
 	// Cycle through boids
 	while(currentBoid != endBoid)
 	{
+		if((*currentBoid)->asleep()) { ++currentBoid; continue; }
+
 		// Generate acceleration from difference between boid pos and the flock centre pos.
 		Accelerate = m_flockCentre - (*currentBoid)->pos();
 
@@ -272,14 +496,16 @@ void Flock::GlobalFlockCentring()	// Clamped
 */
 void Flock::GoalFlockCentring(Imath::V3f &target)	// Clamped
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 
 	Imath::V3f Accelerate;
 
 	// cycle through all the boids
 	while(currentBoid != endBoid)
 	{
+		if((*currentBoid)->asleep()) { ++currentBoid; continue; }
+
 		// Generate acceleration from difference between boid pos and the goal pos.
 		Accelerate = target - (*currentBoid)->pos();
 		
@@ -297,33 +523,48 @@ void Flock::GoalFlockCentring(Imath::V3f &target)	// Clamped
 *  --------------------
 *	For each boid this tests if any flock mates are within 
 *	a set radius 'boidTR' and creates an acceleration away
-*	from them where necessary.
+*	from them where necessary. When boids can sleep, the
+*	flock mates found are also used to tell whether a boid's
+*	neighbourhood has changed, and a disturbed boid wakes
+*	any sleeping boids it passes close to.
 */
 void Flock::CollisionAvoidance()	// Clamped
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator otherBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	const int numBoids = m_boids.size();
+	const int numOwned = numBoids - m_numGhosts;
+	const bool sleeping = m_container.sleeping.enabled;
 
-	Imath::V3f distVec;
-	float distance;
+	unsigned long long tests = 0;
 
-	Imath::V3f Accelerate;
-	Accelerate = m_null;
+	// Each boid only adds to its own acceleration so the
+	// boids can be shared out between threads. Ghosts are
+	// only there to be avoided, their own domain steers them.
+	#pragma omp parallel for schedule(static) reduction(+:tests)
+	for(int b=0; b < numOwned; ++b)
+	{
+		Boid* currentBoid = m_boids[b];
 
-	int count = 0;
+		if(currentBoid->asleep()) { continue; }
+
+		bool disturbed = sleeping && !currentBoid->settling();
+		unsigned int neighbourhood = 0;
+
+		BoidList::const_iterator otherBoid = m_boids.begin();
+		BoidList::const_iterator endBoid = m_boids.end();
+
+		Imath::V3f distVec;
+		float distance;
+
+		Imath::V3f Accelerate = m_null; // Comment out for cool flocking.
 
-	// Cycle through all the boids.
-	while(currentBoid != endBoid)
-	{
 		// For each boid cycle through all the boids
-		while(otherBoid != endBoid)
+		for(; otherBoid != endBoid; ++otherBoid)
 		{
 			// Check to make sure the boid isn't the one we're
 			// testing against.
-			if((*otherBoid)->id() != (*currentBoid)->id())
+			if((*otherBoid)->id() != currentBoid->id())
 			{
-				distVec =  (*currentBoid)->pos() - (*otherBoid)->pos();
+				distVec =  currentBoid->pos() - (*otherBoid)->pos();
 				distance = distVec.length();
 				
 				// Check to see if distance to otherBoid is within test radius BoidTR.
@@ -331,24 +572,34 @@ void Flock::CollisionAvoidance()	// Clamped
 				{
 					// Create an acceleration proportional to the distance to the otherBoid.
 					Accelerate = Accelerate + (distVec / (distance * distance));
-					++count;
+
+					if(sleeping)
+					{
+						neighbourhood += (*otherBoid)->id() * 2654435761u + 1;
+
+						if(disturbed && (*otherBoid)->asleep())
+						{
+							#pragma omp atomic write
+							m_wake[otherBoid - m_boids.begin()] = 1;
+						}
+					}
 				}
-			
 			}
-			++otherBoid;
 		}
 
+		tests += numBoids - 1;
+
+		if(sleeping) { currentBoid->setNeighbourhood(neighbourhood); }
+
 		Accelerate = Accelerate * m_behaviour.collisionAvoidance.scale;
 		// Clamp it off if it is too high.
 		Clamp(Accelerate, m_behaviour.collisionAvoidance.max);
 
 		// Add it to the boid's current acceleration.
-		(*currentBoid)->accelerate( Accelerate );
-
-		otherBoid = m_boids.begin();
-		Accelerate = m_null; // Comment out for cool flocking.
-		++currentBoid;
+		currentBoid->accelerate( Accelerate );
 	}
+
+	m_container.stats.neighbourTests += tests;
 }
 
 /* Local Velocity Matching:
@@ -361,15 +612,19 @@ void Flock::VelMatching()	// Clamped
 {
 	if(m_numMembers > 1)
 	{
-		
+		Arena& arena = m_container.arena();
+		ArenaScope scope(arena);
+
 		// Create the vector to store the local flock mates.
-		std::vector<Boid*> nearestNeighbours;
+		ScratchBoids nearestNeighbours((ArenaAllocator<Boid*>(arena)));
+		nearestNeighbours.reserve(std::min(10, m_numMembers - 1));
 	
-		std::vector<Boid*>::iterator currentNeigh;
-		std::vector<Boid*>::iterator endNeigh;
+		ScratchBoids::iterator currentNeigh;
+		ScratchBoids::iterator endNeigh;
 		
-		std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-		std::vector<Boid*>::iterator endBoid = m_boids.end();
+		// Only the flock's own boids need steering, the ghosts follow their own domain
+		BoidList::iterator currentBoid = m_boids.begin();
+		BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 	
 		Imath::V3f Velocity;
 		Imath::V3f Accelerate;
@@ -377,6 +632,8 @@ void Flock::VelMatching()	// Clamped
 		// Cycle through all the boids in the flock.
 		while(currentBoid != endBoid)
 		{
+			if((*currentBoid)->asleep()) { ++currentBoid; continue; }
+
 			int numNeighbours = 10;
 		
 			if(numNeighbours > m_numMembers-1)
@@ -384,7 +641,7 @@ void Flock::VelMatching()	// Clamped
 		
 			// Method populates the nearestNeighbours vector with 
 			// pointers to the nearest 'n' flock mates of the current boid.
-			NearestNeighbours(nearestNeighbours, (*currentBoid), numNeighbours);
+			NearestNeighbours(nearestNeighbours, (*currentBoid), numNeighbours, m_boids.size());
 	
 			currentNeigh = nearestNeighbours.begin();
 			endNeigh = nearestNeighbours.end();
@@ -427,11 +684,11 @@ void Flock::VelMatching()	// Clamped
 */
 void Flock::CentralObjectAvoidance()
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 
-	std::vector<Object*>::iterator currentObject = m_container.objects.begin();
-	std::vector<Object*>::iterator endObject = m_container.objects.end();
+	std::vector<Object*>& objects = m_container.objects;
+	unsigned long long tests = 0;
 
 	Imath::V3f distVec;
 	float distance;
@@ -442,9 +699,20 @@ void Flock::CentralObjectAvoidance()
 	// Cycle through all the boids.
 	while(currentBoid != endBoid)
 	{
-		while(currentObject != endObject)
+		if((*currentBoid)->asleep()) { ++currentBoid; continue; }
+
+		// Only the objects near enough to the boid to be within ObjectTR are tested
+		m_container.objectTree.Query((*currentBoid)->pos(), m_objectTR, m_nearbyObjects);
+		tests += m_nearbyObjects.size();
+
+		std::vector<unsigned int>::iterator currentObject = m_nearbyObjects.begin();
+		std::vector<unsigned int>::iterator endObject = m_nearbyObjects.end();
+
+		for(; currentObject != endObject; ++currentObject)
 		{
-			distVec =  (*currentBoid)->pos() - (*currentObject)->pos();
+			Object* object = objects[*currentObject];
+
+			distVec =  (*currentBoid)->pos() - object->pos();
 			distance = distVec.length();	
 			
 			// Check to see if distance to otherBoid is within test radius BoidTR.
@@ -454,7 +722,6 @@ void Flock::CentralObjectAvoidance()
 				// Create an acceleration proportional to the distance to the otherBoid.
 				Accelerate = Accelerate + (distVec / (distance * distance));
 			}
-			++currentObject;
 		}
 	
 		Accelerate = Accelerate * m_behaviour.objectAvoidance.scale;
@@ -464,11 +731,11 @@ void Flock::CentralObjectAvoidance()
 		// Add it to the boid's current acceleration.
 		(*currentBoid)->accelerate( Accelerate );
 
-		currentObject = m_container.objects.begin();
-
 		Accelerate = m_null; // Comment out for cool flocking.
 		++currentBoid;
 	}
+
+	m_container.stats.objectTests += tests;
 }
 
 /* Cylindrical Object Avoidance:
@@ -478,11 +745,11 @@ void Flock::CentralObjectAvoidance()
 */
 void Flock::CylindricalObjectAvoidance()
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 
-	std::vector<Object*>::iterator currentObject = m_container.objects.begin();
-	std::vector<Object*>::iterator endObject = m_container.objects.end();
+	std::vector<Object*>& objects = m_container.objects;
+	unsigned long long tests = 0;
 
 	Imath::V3f distVec;
 	float distance;
@@ -498,9 +765,20 @@ void Flock::CylindricalObjectAvoidance()
 	// Cycle through all the boids.
 	while(currentBoid != endBoid)
 	{
-		while(currentObject != endObject)
+		if((*currentBoid)->asleep()) { ++currentBoid; continue; }
+
+		// Only the objects near enough to the boid to be within ObjectTR are tested
+		m_container.objectTree.Query((*currentBoid)->pos(), m_objectTR, m_nearbyObjects);
+		tests += m_nearbyObjects.size();
+
+		std::vector<unsigned int>::iterator currentObject = m_nearbyObjects.begin();
+		std::vector<unsigned int>::iterator endObject = m_nearbyObjects.end();
+
+		for(; currentObject != endObject; ++currentObject)
 		{
-			distVec =  (*currentObject)->pos() - (*currentBoid)->pos();
+			Object* object = objects[*currentObject];
+
+			distVec =  object->pos() - (*currentBoid)->pos();
 			distance = distVec.length();
 			
 			// Check to see if distance to object is within test radius ObjectTR.
@@ -518,7 +796,6 @@ void Flock::CylindricalObjectAvoidance()
 						Accelerate = Accelerate + (distVec.cross(-Up)/distance);
 				}
 			}
-			++currentObject;
 		}
 	
 		Accelerate = Accelerate * m_behaviour.objectAvoidance.scale;
@@ -528,11 +805,11 @@ void Flock::CylindricalObjectAvoidance()
 		// Add it to the boid's current acceleration.
 		(*currentBoid)->accelerate( Accelerate );
 
-		currentObject = m_container.objects.begin();
-
 		Accelerate = m_null; // Comment out for cool flocking.
 		++currentBoid;
 	}
+
+	m_container.stats.objectTests += tests;
 }
 
 /* Spherical Object Avoidance:
@@ -543,63 +820,35 @@ void Flock::CylindricalObjectAvoidance()
 */
 void Flock::SphericalObjectAvoidance()
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 
-	std::vector<Object*>::iterator currentObject = m_container.objects.begin();
-	std::vector<Object*>::iterator endObject = m_container.objects.end();
-
-	Imath::V3f distVec;
-	float distance;
+	std::vector<Object*>& objects = m_container.objects;
+	unsigned long long tests = 0;
 
 	Imath::V3f Accelerate;
-	Imath::V3f TempRight;
-	Imath::V3f TempLeft;
 	Accelerate = m_null;
 
-	Imath::V3f inPlane;
-	float inPlaneFactor;
-
 	// Cycle through all the boids.
 	while(currentBoid != endBoid)
 	{
-		while(currentObject != endObject)
+		// Static objects can't disturb a sleeping boid, moving ones push it awake
+		if(!(*currentBoid)->asleep())
 		{
-			distVec =  (*currentObject)->pos() - (*currentBoid)->pos();
-			distance = distVec.length();
-			
-			// Check to see if distance to object is within test radius ObjectTR.
-			if(distance < m_objectTR)
-			{
-				// test to see if object is infront of boid
-				if((*currentBoid)->vel().dot(distVec) > 0)
-				{
-					Imath::V3f normVel = (*currentBoid)->vel();
-					normVel.normalize();
-					
-					Imath::V3f normDist = distVec;
-					normDist.normalize();
-				
-					
-					inPlaneFactor = normDist.dot(normVel);
-					
-					// Create vector perpendicular to boids velocity
-					inPlane = (normVel*inPlaneFactor) - normDist;
-					
-					float inPlaneLength = inPlane.length();
+			// Only the objects near enough to the boid to be within ObjectTR are tested
+			m_container.objectTree.Query((*currentBoid)->pos(), m_objectTR, m_nearbyObjects);
+			tests += m_nearbyObjects.size();
 
-					// Create accleration from vector
-					Imath::V3f Accel = inPlane/(inPlaneLength*inPlaneLength*inPlaneLength*inPlaneLength);
-					
-					// Scale down acceleration if boids is far from object or already to the side of the object
-					Accel = Accel * (1-(distance/m_objectTR)) * inPlaneFactor;
-					
-					Accelerate = Accelerate + Accel;
-					
-				}
+			std::vector<unsigned int>::iterator currentObject = m_nearbyObjects.begin();
+			std::vector<unsigned int>::iterator endObject = m_nearbyObjects.end();
+
+			for(; currentObject != endObject; ++currentObject)
+			{
+				SteerAround(**currentBoid, objects[*currentObject]->pos(), m_objectTR, Accelerate);
 			}
-			++currentObject;
 		}
+
+		AvoidMovingObjects(**currentBoid, Accelerate, tests);
 	
 		Accelerate = Accelerate * m_behaviour.objectAvoidance.scale;
 		// Clamp it off if it is too high.
@@ -608,11 +857,115 @@ void Flock::SphericalObjectAvoidance()
 		// Add it to the boid's current acceleration.
 		(*currentBoid)->accelerate( Accelerate );
 
-		currentObject = m_container.objects.begin();
-
 		Accelerate = m_null; // Comment out for cool flocking.
 		++currentBoid;
 	}
+
+	m_container.stats.objectTests += tests;
+}
+
+/* Avoid Moving Objects:
+*  ---------------------
+*	Adds the spherical avoidance push from each moving object
+*	in the grid cells around the boid.
+*/
+void Flock::AvoidMovingObjects(const Boid& boid, Imath::V3f& Accelerate, unsigned long long& tests)
+{
+	const PointGrid& grid = m_container.movingObjects.grid();
+
+	if(grid.empty()) { return; }
+
+	grid.Runs(boid.pos(), m_objectTR, m_nearbyRuns);
+
+	for(unsigned int r=0; r < m_nearbyRuns.size(); ++r)
+	{
+		tests += m_nearbyRuns[r].second - m_nearbyRuns[r].first;
+
+		for(unsigned int p=m_nearbyRuns[r].first; p < m_nearbyRuns[r].second; ++p)
+		{
+			SteerAround(boid, grid.point(p), m_objectTR, Accelerate);
+		}
+	}
+}
+
+/* Distance Field Object Avoidance:
+*  --------------------------------
+*	Pushes the boids away from the nearest object surface using
+*	the world's distance field. The push grows as the boid gets
+*	closer, like the central avoidance, but acts along the field
+*	gradient so it works for any shape that has been baked.
+*	Moving objects, and objects given a velocity, are not baked
+*	and get the spherical push.
+*/
+void Flock::DistanceFieldObjectAvoidance()
+{
+	const DistanceField& field = m_container.objectField;
+	std::vector<Object*>& objects = m_container.objects;
+	bool moving = !m_container.movingObjects.empty();
+	bool movingObject = false;
+
+	for(unsigned int o=0; o < objects.size() && !movingObject; ++o)
+		movingObject = objects[o]->moving();
+
+	if(field.empty() && !moving && !movingObject) { return; }
+
+	float distance;
+	Imath::V3f gradient;
+	unsigned long long tests = 0;
+
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
+
+	for(; currentBoid != endBoid; ++currentBoid)
+	{
+		Imath::V3f Accelerate = m_null;
+
+		// Static objects can't disturb a sleeping boid, moving ones push it awake
+		if(!field.empty() && !(*currentBoid)->asleep())
+		{
+			field.Sample((*currentBoid)->pos(), distance, gradient);
+			++tests;
+
+			// Check to see if the nearest surface is within test radius ObjectTR.
+			if(distance < m_objectTR && gradient.length() != 0.0f)
+			{
+				// Stop the push growing without limit inside an object
+				float closest = std::max(distance, 0.1f * field.cellSize());
+
+				Accelerate = gradient.normalized() * ((1 - (distance/m_objectTR)) / closest);
+			}
+		}
+
+		// Moving objects aren't in the field, so they are tested one by one
+		if(moving)
+			AvoidMovingObjects(**currentBoid, Accelerate, tests);
+
+		// Neither are objects with a velocity, which are found through the hierarchy
+		if(movingObject)
+		{
+			m_container.objectTree.Query((*currentBoid)->pos(), m_objectTR, m_nearbyObjects);
+			tests += m_nearbyObjects.size();
+
+			for(unsigned int o=0; o < m_nearbyObjects.size(); ++o)
+			{
+				const Object* object = objects[m_nearbyObjects[o]];
+
+				if(object->moving())
+					SteerAround(**currentBoid, object->pos(), m_objectTR, Accelerate);
+			}
+		}
+
+		if(Accelerate == m_null) { continue; }
+
+		Accelerate = Accelerate * m_behaviour.objectAvoidance.scale;
+		// Clamp it off if it is too high.
+		Clamp(Accelerate, m_behaviour.objectAvoidance.max);
+
+		// Add it to the boid's current acceleration.
+		(*currentBoid)->accelerate( Accelerate );
+	}
+
+	m_container.stats.objectTests += tests;
 }
 
 /* Hunt:
@@ -623,13 +976,24 @@ void Flock::SphericalObjectAvoidance()
 */
 void Flock::Hunt()
 {
-	std::vector<Boid*> preyBoids;	
+	if(m_behaviour.huntMode == BoidHunting)
+	{
+		HuntNearest();
+		return;
+	}
+
+	Arena& arena = m_container.arena();
+	ArenaScope scope(arena);
+
+	// Room for one prey per flock up front, as it can't grow inside the arena scopes below
+	ScratchBoids preyBoids((ArenaAllocator<Boid*>(arena)));
+	preyBoids.reserve(m_container.flocks.size());
 
 	std::vector<Flock*>::iterator otherFlock = m_container.flocks.begin();
 	std::vector<Flock*>::iterator endFlock = m_container.flocks.end();
 		
-	std::vector<Boid*>::iterator currentLocalBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endLocalBoid = m_boids.end();
+	BoidList::iterator currentLocalBoid = m_boids.begin();
+	BoidList::iterator endLocalBoid = m_boids.end();
 
 	
 	if(m_rank != 0)
@@ -640,15 +1004,18 @@ void Flock::Hunt()
 			if((*otherFlock)->m_rank < m_rank && ((*otherFlock)->m_id != m_id && !(*otherFlock)->m_boids.empty()))  
 			{
 	
+				ArenaScope preyScope(arena);
+
 				// Create a copy of the current boid vector so that
 				// elements can be deleted as needed.
-				std::vector<Boid*> dummyBoids;
+				ScratchBoids dummyBoids((ArenaAllocator<Boid*>(arena)));
+				dummyBoids.reserve((*otherFlock)->m_boids.size());
 				dummyBoids.assign((*otherFlock)->m_boids.begin(), (*otherFlock)->m_boids.end());
 				
 				// Set iterators
-				std::vector<Boid*>::iterator currentBoid;
-				std::vector<Boid*>::iterator endBoid = dummyBoids.end();
-				std::vector<Boid*>::iterator nearestBoid;
+				ScratchBoids::iterator currentBoid;
+				ScratchBoids::iterator endBoid = dummyBoids.end();
+				ScratchBoids::iterator nearestBoid;
 	
 				Imath::V3f distVec;
 				float distance;
@@ -697,6 +1064,8 @@ void Flock::Hunt()
 					
 					preyBoids.push_back((*nearestBoid));
 			
+					m_container.stats.neighbourTests += dummyBoids.size();
+
 					dummyBoids.erase(nearestBoid);
 				}
 				
@@ -722,6 +1091,8 @@ void Flock::Hunt()
 			
 				for(; currentLocalBoid != endLocalBoid; ++currentLocalBoid)
 				{
+					if((*currentLocalBoid)->asleep()) { continue; }
+
 					// Accelerate each boid towards the prey
 					Accelerate = AveragePreyPos - (*currentLocalBoid)->pos();
 			
@@ -736,59 +1107,163 @@ void Flock::Hunt()
 	}
 }
 
-/* Kill:
-*  -----
-*	Any collisions between predator and prey boids
-*	result in the prey boid "dying". To emphasise the
-*	effect, a small explosion of particles is generated
-*	at the point of death.
+/* HuntNearest:
+*  ------------
+*	Every boid lower in the food chain goes into one grid, so
+*	each hunter finds its nearest prey without a pass over all
+*	of them. A hunter holding on to its prey looks it up by ID
+*	instead, and looks for the nearest again if it has died.
 */
-void Flock::Kill()
+void Flock::HuntNearest()
 {
+	if(m_rank == 0) { return; }
+
+	m_prey.Clear(m_boidTR);
+	m_preyBoids.clear();
 
 	std::vector<Flock*>::iterator otherFlock = m_container.flocks.begin();
 	std::vector<Flock*>::iterator endFlock = m_container.flocks.end();
 
-	std::vector<Boid*>::iterator otherBoid;
-	std::vector<Boid*>::iterator endBoid;
-		
-	std::vector<Boid*>::iterator currentLocalBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endLocalBoid = m_boids.end();
-
-	Imath::V3f difference;
-	float distance;
-	
-	if(m_rank != 0)
-	{			
-		for(; otherFlock != endFlock; ++otherFlock)
+	for(; otherFlock != endFlock; ++otherFlock)
+	{
+		if((*otherFlock)->m_rank < m_rank && (*otherFlock)->m_id != m_id)
 		{
-			// check for m_id is unnecessary as no flock will have a m_rank less than its own but it is included for completeness.
-			if((*otherFlock)->m_rank < m_rank && ((*otherFlock)->m_id != m_id && !(*otherFlock)->m_boids.empty()))  
+			BoidList::iterator otherBoid = (*otherFlock)->m_boids.begin();
+			BoidList::iterator endBoid = (*otherFlock)->m_boids.end();
+
+			for(; otherBoid != endBoid; ++otherBoid)
 			{
-				// cycle through all boids in current flock
-				for(; currentLocalBoid != endLocalBoid; ++currentLocalBoid)
-				{
-					otherBoid = (*otherFlock)->m_boids.begin();
-					endBoid = (*otherFlock)->m_boids.end();
-					
-					// cycle through all boids in other flocks
-					while(otherBoid != endBoid)
-					{
-						difference = (*currentLocalBoid)->pos() - (*otherBoid)->pos();
-						distance = difference.length();
-						
-						// Test is see if predator and prey boids are close.
-						if(distance < 0.7)
-						{
-							// Create a shower of particles at boid death position
-							for(int i=0; i <30; ++i)
-							{
+				m_prey.Add((*otherBoid)->pos());
+				m_preyBoids.push_back(*otherBoid);
+			}
+		}
+	}
+
+	m_prey.Build();
+
+	if(m_prey.empty()) { return; }
+
+	const unsigned int hold = m_behaviour.huntHold;
+
+	if(hold > 1)
+	{
+		m_preyLookup.resize(m_preyBoids.size());
+
+		for(unsigned int p=0; p < m_preyBoids.size(); ++p)
+			m_preyLookup[p] = std::make_pair((uint64_t(uint32_t(m_preyBoids[p]->flockID())) << 32) | m_preyBoids[p]->id(), p);
+
+		std::sort(m_preyLookup.begin(), m_preyLookup.end());
+	}
+
+	const int numOwned = m_boids.size() - m_numGhosts;
+
+	unsigned long long tests = 0;
+
+	// Each boid only changes its own target and acceleration
+	#pragma omp parallel for schedule(static) reduction(+:tests)
+	for(int b=0; b < numOwned; ++b)
+	{
+		Boid* currentBoid = m_boids[b];
+
+		if(currentBoid->asleep()) { continue; }
+
+		Boid* target = NULL;
+
+		if(hold > 1 && currentBoid->holdingTarget())
+		{
+			uint64_t key = (uint64_t(uint32_t(currentBoid->targetFlock())) << 32) | currentBoid->targetID();
+
+			PreyLookup::const_iterator found =
+				std::lower_bound(m_preyLookup.begin(), m_preyLookup.end(), std::make_pair(key, 0u));
+
+			if(found != m_preyLookup.end() && found->first == key)
+			{
+				target = m_preyBoids[found->second];
+				currentBoid->holdTarget();
+			}
+		}
+
+		if(!target)
+		{
+			unsigned int tested = 0;
+			target = m_preyBoids[m_prey.index(m_prey.Nearest(currentBoid->pos(), tested))];
+			tests += tested;
+
+			currentBoid->setTarget(target->flockID(), target->id(), hold);
+		}
+
+		// Accelerate towards the prey
+		Imath::V3f Accelerate = target->pos() - currentBoid->pos();
+
+		Accelerate = Accelerate * m_behaviour.hunt.scale;
+		Clamp(Accelerate, m_behaviour.hunt.max);
+
+		currentBoid->accelerate( Accelerate );
+	}
+
+	m_container.stats.neighbourTests += tests;
+}
+
+/* Kill:
+*  -----
+*	Any collisions between predator and prey boids
+*	result in the prey boid "dying". To emphasise the
+*	effect, a small explosion of particles is generated
+*	at the point of death. When split into domains only
+*	the prey's own domain kills it, where a predator from
+*	across the boundary is present as a ghost.
+*/
+void Flock::Kill()
+{
+
+	std::vector<Flock*>::iterator otherFlock = m_container.flocks.begin();
+	std::vector<Flock*>::iterator endFlock = m_container.flocks.end();
+
+	BoidList::iterator otherBoid;
+	BoidList::iterator endBoid;
+		
+	BoidList::iterator currentLocalBoid = m_boids.begin();
+	BoidList::iterator endLocalBoid = m_boids.end();
+
+	Imath::V3f difference;
+	float distance;
+	
+	if(m_rank != 0)
+	{			
+		for(; otherFlock != endFlock; ++otherFlock)
+		{
+			// check for m_id is unnecessary as no flock will have a m_rank less than its own but it is included for completeness.
+			if((*otherFlock)->m_rank < m_rank && ((*otherFlock)->m_id != m_id && !(*otherFlock)->m_boids.empty()))  
+			{
+				// cycle through all boids in current flock
+				for(; currentLocalBoid != endLocalBoid; ++currentLocalBoid)
+				{
+					otherBoid = (*otherFlock)->m_boids.begin();
+					endBoid = (*otherFlock)->m_boids.end();
+
+					m_container.stats.neighbourTests += (*otherFlock)->m_boids.size();
+					
+					// cycle through all boids in other flocks
+					while(otherBoid != endBoid)
+					{
+						difference = (*currentLocalBoid)->pos() - (*otherBoid)->pos();
+						distance = difference.length();
+						
+						// Test is see if predator and prey boids are close. Ghost prey
+						// is only killed by the domain that owns it, so it dies just once
+						if(distance < 0.7 && !(*otherBoid)->ghost())
+						{
+							// Create a shower of particles at boid death position
+							for(int i=0; i <30; ++i)
+							{
 								Particle* newParticle = new Particle((*otherBoid)->pos(), (*otherFlock)->m_colour, m_container.minY);
 								m_particles.push_back(newParticle);
 							}
 							// remove dead boid from its flock 
+							delete (*otherBoid);
 							(*otherFlock)->m_boids.erase(otherBoid);
 							(*otherFlock)->m_numMembers -= 1;
+							(*otherFlock)->m_neighbourCache.clear();
 							endBoid = (*otherFlock)->m_boids.end();
 						} else {
 							// only increment is nothing is removed from vector
@@ -807,64 +1282,60 @@ void Flock::Kill()
 *  -----
 *	The flock searches for any predator boids
 *	and accelerates away from them if they are 
-*	closer than a certain distance.
+*	closer than a certain distance. The predators
+*	of every higher ranked flock go into a single
+*	grid first, so each boid makes one query however
+*	many predator flocks there are, and the fleeing
+*	acceleration is clamped once over all of them.
 */
 void Flock::Flee()
 {
+	m_predators.Clear(m_fleeTR);
+
 	std::vector<Flock*>::iterator otherFlock = m_container.flocks.begin();
 	std::vector<Flock*>::iterator endFlock = m_container.flocks.end();
-	
-	std::vector<Boid*>::iterator otherBoid;
-	std::vector<Boid*>::iterator endBoid;
-	
-	std::vector<Boid*>::iterator currentLocalBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endLocalBoid = m_boids.end();
-	
-	Imath::V3f distVec;
-	float distance;
-
-	Imath::V3f Accelerate;
-	Accelerate = m_null;
-	
-	int count = 0;
 
 	for(; otherFlock != endFlock; ++otherFlock)
 	{
 		// check for m_id is unnecessary as no flock will have a m_rank greater than its own but it is included for completeness. 
-		if((*otherFlock)->m_rank > m_rank && ((*otherFlock)->m_id != m_id && !(*otherFlock)->m_boids.empty())) 
+		if((*otherFlock)->m_rank > m_rank && (*otherFlock)->m_id != m_id) 
 		{
-			// Cycle through all the boids.
-			for(; currentLocalBoid != endLocalBoid; ++currentLocalBoid)
-			{
-				otherBoid = (*otherFlock)->m_boids.begin();
-				endBoid = (*otherFlock)->m_boids.end();
-				
-				// For each boid cycle through all the boids
-				for(; otherBoid != endBoid; ++otherBoid)
-				{
-						distVec =  (*currentLocalBoid)->pos() - (*otherBoid)->pos();
-						distance = distVec.length();
-						
-						// Check to see if distance to otherBoid is within test radius BoidTR.
-						if( distance < m_fleeTR )
-						{
-							// Create an acceleration proportional to the distance to the otherBoid.
-							Accelerate = Accelerate + (distVec / (distance * distance));
-							++count;
-						}
-				}
-		
-				Accelerate = Accelerate * m_behaviour.flee.scale;
-				// Clamp it off if it is too high.
-				Clamp(Accelerate, m_behaviour.flee.max);
-		
-				// Add it to the boid's current acceleration.
-				(*currentLocalBoid)->accelerate( Accelerate );
-		
-				Accelerate = m_null;
-			}
+			BoidList::iterator otherBoid = (*otherFlock)->m_boids.begin();
+			BoidList::iterator endBoid = (*otherFlock)->m_boids.end();
+
+			for(; otherBoid != endBoid; ++otherBoid)
+				m_predators.Add((*otherBoid)->pos());
 		}
-	} 
+	}
+
+	m_predators.Build();
+
+	if(m_predators.empty()) { return; }
+
+	const int numOwned = m_boids.size() - m_numGhosts;
+
+	unsigned long long tests = 0;
+
+	// Each boid only adds to its own acceleration
+	#pragma omp parallel for schedule(static) reduction(+:tests)
+	for(int b=0; b < numOwned; ++b)
+	{
+		unsigned int tested = 0;
+
+		// Sum of accelerations inversely proportional to the distance to each predator
+		Imath::V3f Accelerate = m_predators.SumInverseSquare(m_boids[b]->pos(), m_fleeTR, tested);
+
+		tests += tested;
+
+		Accelerate = Accelerate * m_behaviour.flee.scale;
+		// Clamp it off if it is too high.
+		Clamp(Accelerate, m_behaviour.flee.max);
+
+		// Add it to the boid's current acceleration.
+		m_boids[b]->accelerate( Accelerate );
+	}
+
+	m_container.stats.neighbourTests += tests;
 }
 
 
@@ -875,8 +1346,8 @@ void Flock::Flee()
 */
 void Flock::Contain()
 {
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
 
 	// Cycle through all the boids in the flock.
 	while(currentBoid != endBoid)
@@ -915,22 +1386,178 @@ void Flock::Contain()
 
 /* Clear:
 *  ------
-*	Empties the STL vector contain the boids in the flock.
+*	Deletes and empties the STL vector contain the boids in the flock.
 *	Important for reseting the system.
 */
 void Flock::Clear()
 {
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end();
+
+	for(; currentBoid != endBoid; ++currentBoid)
+	{
+		delete (*currentBoid);
+	}
 	m_boids.clear();
+	m_numMembers = 0;
+	m_numGhosts = 0;
+
+	m_neighbourCache.clear();
+	m_lodCountdown = 0;
 }
 
 /* AddBoid:
 *  --------
 *	Inserts the passed pointer into the vector of boids
-*	stored within the flock.
+*	stored within the flock. The flock takes ownership.
 */
 void Flock::AddBoid(Boid* addBoid)
 {
-	m_boids.push_back(addBoid);
+	// In front of any ghosts, which stay at the end
+	m_boids.insert(m_boids.end() - m_numGhosts, addBoid);
+	++m_numMembers;
+
+	m_neighbourCache.clear();
+}
+
+/* AddGhosts:
+*  ----------
+*	Appends the ghosts after the flock's own boids, so the
+*	indices of those and the neighbours cached for them
+*	don't change.
+*/
+void Flock::AddGhosts(const std::vector<Boid*>& ghosts)
+{
+	for(unsigned int g=0; g < ghosts.size(); ++g)
+	{
+		ghosts[g]->setGhost(true);
+		m_boids.push_back(ghosts[g]);
+	}
+
+	m_numMembers += ghosts.size();
+	m_numGhosts += ghosts.size();
+}
+
+void Flock::ReleaseGhosts(std::vector<Boid*>& removed)
+{
+	unsigned int numOwned = m_boids.size() - m_numGhosts;
+
+	removed.insert(removed.end(), m_boids.begin() + numOwned, m_boids.end());
+	m_boids.resize(numOwned);
+
+	m_numMembers -= m_numGhosts;
+	m_numGhosts = 0;
+}
+
+/* Release:
+*  --------
+*	Takes the flagged boids out in one pass, without
+*	deleting them.
+*/
+void Flock::Release(const std::vector<unsigned char>& remove, std::vector<Boid*>& removed)
+{
+	unsigned int kept = 0;
+	unsigned int ghostsRemoved = 0;
+
+	for(unsigned int b=0; b < m_boids.size(); ++b)
+	{
+		if(remove[b])
+		{
+			removed.push_back(m_boids[b]);
+			ghostsRemoved += m_boids[b]->ghost();
+		}
+		else
+			m_boids[kept++] = m_boids[b];
+	}
+
+	if(kept == m_boids.size()) { return; }
+
+	unsigned int numRemoved = m_boids.size() - kept;
+
+	m_numMembers -= numRemoved;
+	m_numGhosts -= ghostsRemoved;
+	m_boids.resize(kept);
+
+	// The cache only covers the flock's own boids
+	if(numRemoved > ghostsRemoved)
+		m_neighbourCache.clear();
+}
+
+/* CreateBoids:
+*  ------------
+*	Creates boids straight into the flock, numbering them
+*	on from any boids already present.
+*/
+void Flock::CreateBoids(int numBoids, double x, double y, double z, double spread)
+{
+	if(numBoids <= 0) { return; }
+
+	unsigned int firstID = m_boids.size();
+	
+	m_boids.resize(firstID + numBoids);
+
+	Boid* slab = Boid::AllocateSlab(numBoids);
+
+	// Each boid's random state comes from its own seed, so the boids can be made in any order
+	#pragma omp parallel for schedule(static)
+	for(int b=0; b < numBoids; ++b)
+	{
+		m_boids[firstID + b] = new( slab + b ) Boid(firstID + b, m_id, x, y, z, spread, m_container.seed);
+	}
+
+	m_numMembers += numBoids;
+	m_neighbourCache.clear();
+}
+
+/* LoadBoids:
+*  ----------
+*	The list is grown once to hold the whole file and each
+*	chunk of boids is made in one slab, so there is a single
+*	allocation per chunk and nothing is pushed or copied. A
+*	chunk that can't be mapped leaves the boids before it in
+*	place and drops the rest.
+*/
+bool Flock::LoadBoids(const std::string& filename, unsigned int chunkSize)
+{
+	BoidFileReader reader;
+
+	if(!reader.Open(filename)) { return false; }
+
+	unsigned int firstID = m_boids.size();
+	uint64_t count = reader.count();
+
+	m_boids.resize(firstID + count);
+
+	for(uint64_t first=0; first < count; first += chunkSize)
+	{
+		long number = long(std::min(uint64_t(chunkSize), count - first));
+		const BoidFileRecord* records = reader.Map(first, number);
+
+		if(!records)
+		{
+			std::cout << "Error: unable to map boids " << first << " onwards from " << filename << std::endl;
+			m_boids.resize(firstID + first);
+			count = first;
+			break;
+		}
+
+		Boid* slab = Boid::AllocateSlab(number);
+
+		#pragma omp parallel for schedule(static)
+		for(long r=0; r < number; ++r)
+		{
+			const BoidFileRecord& record = records[r];
+			unsigned int id = firstID + first + r;
+
+			m_boids[id] = new( slab + r ) Boid(id, m_id, Imath::V3f(record.pos[0], record.pos[1], record.pos[2]),
+									Imath::V3f(record.vel[0], record.vel[1], record.vel[2]));
+		}
+	}
+
+	m_numMembers += count;
+	m_neighbourCache.clear();
+
+	return count == reader.count();
 }
 
 /* ParticleUpdate:
@@ -940,8 +1567,8 @@ void Flock::AddBoid(Boid* addBoid)
 */
 void Flock::ParticleUpdate()
 {
-	std::vector<Particle*>::iterator currentPart = m_particles.begin();
-	std::vector<Particle*>::iterator endPart = m_particles.end();
+	ParticleList::iterator currentPart = m_particles.begin();
+	ParticleList::iterator endPart = m_particles.end();
 	
 	while(currentPart != endPart)
 	{
@@ -954,7 +1581,7 @@ void Flock::ParticleUpdate()
 		}
 		else
 		{
-			(*currentPart)->Update();
+			(*currentPart)->Update( m_container.subStepSize() );
 			++currentPart;
 		}
 	}
@@ -976,32 +1603,274 @@ void Flock::Update(Imath::V3f &target)
 	
 	Kill(); // kill any boids before they're processed
 
+	if(m_container.mortonSortInterval > 0)
+	{
+		if(m_sortCountdown == 0)
+		{
+			SortBoids();
+			m_sortCountdown = m_container.mortonSortInterval;
+		}
+		--m_sortCountdown;
+	}
+
 	// Get info
 	GetFlockCentre();
 
+	// Ghosts are stepped, and put to sleep, by the domain that owns them
+	BoidList::iterator currentBoid = m_boids.begin();
+	BoidList::iterator endBoid = m_boids.end() - m_numGhosts;
+
+	// Between behaviour runs at reduced detail the boids carry on
+	// with the acceleration they had at the last run.
+	if(m_lodCountdown > 0)
+	{
+		--m_lodCountdown;
+
+		for( ; currentBoid != endBoid; ++currentBoid )
+			(*currentBoid)->accelerate( (*currentBoid)->lastAcc() );
+
+		Integrate();
+
+		m_container.stats.boidSteps += m_boids.size() - m_numGhosts;
+		m_container.stats.heldSteps += m_boids.size() - m_numGhosts;
+		return;
+	}
+
+	m_lodLevel = DetailLevel();
+
+	// Neighbours cached at level 2 go stale while the flock is nearer
+	if(m_lodLevel != 2)
+		m_neighbourCache.clear();
+
+	if(m_lodLevel > 0)
+		m_lodCountdown = std::max(m_container.lod.interval[m_lodLevel - 1], 1u) - 1;
+
+	const World::Sleeping& sleeping = m_container.sleeping;
+
+	if(sleeping.enabled)
+		m_wake.assign(m_boids.size(), 0);
+
+	double behaviourStart = Seconds();
+
 	// Run behaviours 
 	LocalFlockCentring();
 	GlobalFlockCentring();
 	CollisionAvoidance();
-	VelMatching();
-	SphericalObjectAvoidance();
+
+	if(m_lodLevel == 0)
+		VelMatching();
+
+	if(m_behaviour.objectAvoidanceMode == DistanceFieldAvoidance)
+		DistanceFieldObjectAvoidance();
+	else
+		SphericalObjectAvoidance();
+
 	GoalFlockCentring(target);
 	Contain();
 	
 	Hunt();
 	Flee();
 	
+	m_container.stats.behaviourSeconds += Seconds() - behaviourStart;
 
 	// Update
-	std::vector<Boid*>::iterator currentBoid = m_boids.begin();
-	std::vector<Boid*>::iterator endBoid = m_boids.end();
+	for( unsigned int b=0; currentBoid != endBoid; ++currentBoid, ++b )
+	{
+		// Boids that slept through the behaviours coast on their last acceleration
+		bool coasting = (*currentBoid)->asleep();
+
+		if(sleeping.enabled)
+			(*currentBoid)->Settle( sleeping, m_wake[b] != 0 );
+		else if(coasting)
+			(*currentBoid)->wake();
+
+		if(coasting)
+		{
+			(*currentBoid)->accelerate( (*currentBoid)->lastAcc() );
+			++m_container.stats.sleepingSteps;
+		}
+	}
+
+	Integrate();
+
+	// Ghosts are stepped by the domain that owns them
+	m_container.stats.boidSteps += m_boids.size() - m_numGhosts;
+}
+
+
+/* Integrate:
+*  ----------
+*	Moves every boid by the acceleration gathered this step,
+*	apart from the ghosts, which are moved by their own domain
+*	and dropped at the end of the step. The batch path copies the flock into arrays for the
+*	vectorised kernel and copies the results back, the banking
+*	is then done per boid as usual.
+*/
+void Flock::Integrate()
+{
+	float timeStep = m_container.subStepSize();
+	unsigned int numOwned = m_boids.size() - m_numGhosts;
+
+	if(!m_container.batchIntegration)
+	{
+		BoidList::iterator currentBoid = m_boids.begin();
+		BoidList::iterator endBoid = m_boids.begin() + numOwned;
+
+		for( ; currentBoid != endBoid; ++currentBoid )
+			(*currentBoid)->update( m_behaviour, timeStep, m_container.integrator );
+
+		return;
+	}
+
+	m_integrator.Gather(m_boids, numOwned);
+	m_integrator.Integrate(m_behaviour.maxAcc, m_behaviour.maxVel, m_behaviour.minVel, timeStep,
+		m_container.integrator == World::VelocityVerlet);
+
+	// Each boid only touches its own state here
+	#pragma omp parallel for schedule(static)
+	for(int b=0; b < int(numOwned); ++b)
+	{
+		m_boids[b]->Integrated( m_integrator.pos(b), m_integrator.vel(b), m_integrator.acc(b),
+			m_integrator.preClampAcc(b), m_behaviour );
+	}
+}
+
+
+/* SortBoids:
+*  ----------
+*	Gives each boid a Morton code from its position, ten bits
+*	per axis across the flock's bounding box, and reorders the
+*	flock by it. Boids with the same code keep their order. The
+*	boids are copied in the new order into one slab before the
+*	old ones are freed, so they are laid out in memory in that
+*	order too and the old slabs go back to the heap.
+*/
+void Flock::SortBoids()
+{
+	double start = Seconds();
+
+	// Only the flock's own boids are reordered, the ghosts stay at the end
+	unsigned int numBoids = m_boids.size() - m_numGhosts;
+
+	if(numBoids == 0) { return; }
+
+	Imath::V3f low = m_boids[0]->pos();
+	Imath::V3f high = low;
+
+	for(unsigned int b=1; b < numBoids; ++b)
+	{
+		const Imath::V3f& pos = m_boids[b]->pos();
+
+		low.setValue(std::min(low.x, pos.x), std::min(low.y, pos.y), std::min(low.z, pos.z));
+		high.setValue(std::max(high.x, pos.x), std::max(high.y, pos.y), std::max(high.z, pos.z));
+	}
+
+	Imath::V3f extent = high - low;
+	Imath::V3f scale( extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+		extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+		extent.z > 0.0f ? 1023.0f / extent.z : 0.0f );
+
+	Arena& arena = m_container.arena();
+	ArenaScope scope(arena);
+
+	// Pairs of code and old index, so sorting them is stable
+	typedef std::pair<uint32_t, unsigned int> Code;
+	std::vector< Code, ArenaAllocator<Code> > codes(numBoids, Code(), (ArenaAllocator<Code>(arena)));
+
+	for(unsigned int b=0; b < numBoids; ++b)
+	{
+		Imath::V3f cell = m_boids[b]->pos() - low;
+
+		codes[b].first = SpreadBits(uint32_t(cell.x * scale.x))
+			| (SpreadBits(uint32_t(cell.y * scale.y)) << 1)
+			| (SpreadBits(uint32_t(cell.z * scale.z)) << 2);
+		codes[b].second = b;
+	}
+
+	std::sort(codes.begin(), codes.end());
+
+	double spacingBefore = Spacing(m_boids);
+
+	BoidList sorted(m_boids.size());
+	std::vector< unsigned int, ArenaAllocator<unsigned int> > newIndex(numBoids, 0, (ArenaAllocator<unsigned int>(arena)));
+
+	Boid* slab = Boid::AllocateSlab(numBoids);
 
-	float Vx, Vy, Vz;
+	for(unsigned int b=0; b < numBoids; ++b)
+	{
+		sorted[b] = new( slab + b ) Boid(*m_boids[codes[b].second]);
+		newIndex[codes[b].second] = b;
+	}
+
+	for(unsigned int b=0; b < numBoids; ++b)
+	{
+		delete m_boids[b];
+	}
+	std::copy(m_boids.begin() + numBoids, m_boids.end(), sorted.begin() + numBoids);
+	m_boids.swap(sorted);
 
-	for( ; currentBoid != endBoid; ++currentBoid )
+	// The cached neighbours are indices into m_boids, so follow the boids to their new places
+	if(!m_neighbourCache.empty())
 	{
-		(*currentBoid)->update( m_behaviour );
+		unsigned int numNeighbours = m_neighbourCache.size() / numBoids;
+		IndexList remapped(m_neighbourCache.size());
+
+		for(unsigned int b=0; b < numBoids; ++b)
+		{
+			for(unsigned int n=0; n < numNeighbours; ++n)
+			{
+				remapped[newIndex[b] * numNeighbours + n] = newIndex[m_neighbourCache[b * numNeighbours + n]];
+			}
+		}
+
+		m_neighbourCache.swap(remapped);
 	}
+
+	m_container.stats.sortedBoids += numBoids;
+	m_container.stats.spacingBefore += spacingBefore;
+	m_container.stats.spacingAfter += Spacing(m_boids);
+	m_container.stats.sortSeconds += Seconds() - start;
+}
+
+/* BoidsByID:
+*  ----------
+*	Boids are created, and only ever removed, in ID order, so
+*	the list only needs sorting once the flock has been
+*	reordered along the Morton curve.
+*/
+void Flock::BoidsByID(ExportBoids& boids) const
+{
+	boids.assign(m_boids.begin(), m_boids.end());
+
+	for(unsigned int b=1; b < boids.size(); ++b)
+	{
+		if(boids[b]->id() < boids[b-1]->id())
+		{
+			std::stable_sort(boids.begin(), boids.end(), IDOrder);
+			return;
+		}
+	}
+}
+
+/* DetailLevel:
+*  ------------
+*	Picks the level of detail from how far the flock centre
+*	is from the world's point of interest.
+*/
+unsigned int Flock::DetailLevel() const
+{
+	const World::LevelOfDetail& lod = m_container.lod;
+
+	if(!lod.enabled) { return 0; }
+
+	float distance = (m_flockCentre - lod.centre).length();
+
+	if(distance > lod.distance[1])
+		return 2;
+	else if(distance > lod.distance[0])
+		return 1;
+
+	return 0;
 }
 
 
@@ -1014,8 +1883,8 @@ void Flock::Draw()
 {
 	if(m_boids.empty()) { return; }
 
-	std::vector<Boid*>::iterator currentB = m_boids.begin();
-	std::vector<Boid*>::iterator endB = m_boids.end();
+	BoidList::iterator currentB = m_boids.begin();
+	BoidList::iterator endB = m_boids.end();
 	
 	while(currentB != endB)
 	{
@@ -1024,8 +1893,8 @@ void Flock::Draw()
 		++currentB;
 	}
 	
-	std::vector<Particle*>::iterator currentPart = m_particles.begin();
-	std::vector<Particle*>::iterator endPart = m_particles.end();
+	ParticleList::iterator currentPart = m_particles.begin();
+	ParticleList::iterator endPart = m_particles.end();
 	
 	for(; currentPart != endPart; ++currentPart)
 	{
@@ -1040,8 +1909,12 @@ void Flock::OBJExport(int frame)
 {
 // 	if(boids.empty()) { return; }
 
-	std::vector<Boid*>::iterator currentB = m_boids.begin();
-	std::vector<Boid*>::iterator endB = m_boids.end();
+	// Written in ID order so each boid keeps its vertex from frame to frame
+	ExportBoids boids;
+	BoidsByID(boids);
+
+	ExportBoids::iterator currentB = boids.begin();
+	ExportBoids::iterator endB = boids.end();
 
 	int offset = 1;
 
@@ -1065,5 +1938,152 @@ void Flock::OBJExport(int frame)
 	OBJFile.close();
 }
 
-} // Flock
+/* Hash:
+*  -----
+*	FNV-1a over the raw bytes of each boid's position and
+*	velocity. Any change to a single bit of the state, or 
+*	to which boid has it, changes the hash. The boids are taken
+*	in ID order so a Morton reorder alone leaves it unchanged.
+*/
+uint64_t Flock::Hash() const
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	ExportBoids boids;
+	BoidsByID(boids);
+
+	ExportBoids::const_iterator currentBoid = boids.begin();
+	ExportBoids::const_iterator endBoid = boids.end();
 
+	for(; currentBoid != endBoid; ++currentBoid)
+	{
+		const Imath::V3f state[2] = { (*currentBoid)->pos(), (*currentBoid)->vel() };
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(state);
+
+		for(unsigned int i=0; i < sizeof(state); ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+/* Save:
+*  -----
+*	Writes every setting of the flock followed by its boids 
+*	and particles. Values are written as raw bytes so a 
+*	restored flock steps identically to the original.
+*/
+void Flock::Save(std::ostream& out) const
+{
+	Write(out, m_id);
+	Write(out, m_colour);
+	Write(out, m_numMembers);
+	Write(out, m_rank);
+	Write(out, m_behaviour);
+	Write(out, m_flockCentre);
+	Write(out, m_null);
+	Write(out, m_gravity);
+	Write(out, m_objectTR);
+	Write(out, m_boidTR);
+	Write(out, m_fleeTR);
+	Write(out, m_containmentAcc);
+	Write(out, m_lodLevel);
+	Write(out, m_lodCountdown);
+	Write(out, m_neighbourCacheAge);
+	WriteVector(out, m_neighbourCache);
+	Write(out, m_sortCountdown);
+
+	unsigned int numBoids = m_boids.size();
+	Write(out, numBoids);
+	
+	BoidList::const_iterator currentBoid = m_boids.begin();
+	BoidList::const_iterator endBoid = m_boids.end();
+
+	for(; currentBoid != endBoid; ++currentBoid)
+	{
+		(*currentBoid)->Save(out);
+	}
+
+	unsigned int numParticles = m_particles.size();
+	Write(out, numParticles);
+
+	ParticleList::const_iterator currentPart = m_particles.begin();
+	ParticleList::const_iterator endPart = m_particles.end();
+
+	for(; currentPart != endPart; ++currentPart)
+	{
+		(*currentPart)->Save(out);
+	}
+}
+
+/* Load:
+*  -----
+*	Reads back the state written by Save. Boids and particles
+*	are recreated in their original order.
+*/
+bool Flock::Load(std::istream& in)
+{
+	Clear();
+
+	Read(in, m_id);
+	Read(in, m_colour);
+	Read(in, m_numMembers);
+	Read(in, m_rank);
+	Read(in, m_behaviour);
+	Read(in, m_flockCentre);
+	Read(in, m_null);
+	Read(in, m_gravity);
+	Read(in, m_objectTR);
+	Read(in, m_boidTR);
+	Read(in, m_fleeTR);
+	Read(in, m_containmentAcc);
+	Read(in, m_lodLevel);
+	Read(in, m_lodCountdown);
+	Read(in, m_neighbourCacheAge);
+	ReadVector(in, m_neighbourCache);
+	Read(in, m_sortCountdown);
+
+	unsigned int numBoids = 0;
+	if(!Read(in, numBoids)) { return false; }
+
+	// Every slot of the slab gets its boid before any are read, so a short file frees it as usual
+	Boid* slab = numBoids > 0 ? Boid::AllocateSlab(numBoids) : NULL;
+	m_boids.resize(numBoids);
+
+	for(unsigned int b=0; b < numBoids; ++b)
+	{
+		m_boids[b] = new( slab + b ) Boid(b, m_id, 0.0, 0.0, 0.0, 0.0);
+	}
+
+	for(unsigned int b=0; b < numBoids; ++b)
+	{
+		if(!m_boids[b]->Load(in)) { return false; }
+	}
+
+	ParticleList::iterator currentPart = m_particles.begin();
+	ParticleList::iterator endPart = m_particles.end();
+
+	for(; currentPart != endPart; ++currentPart)
+	{
+		delete (*currentPart);
+	}
+	m_particles.clear();
+
+	unsigned int numParticles = 0;
+	if(!Read(in, numParticles)) { return false; }
+
+	for(unsigned int p=0; p < numParticles; ++p)
+	{
+		Particle* newParticle = new Particle();
+		m_particles.push_back(newParticle);
+
+		if(!newParticle->Load(in)) { return false; }
+	}
+
+	return true;
+}
+
+} // Flock
@@ -2,9 +2,15 @@
 #define __FLOCK_H__
 
 #include <vector>
+#include <iosfwd>
+#include <stdint.h>
 
 #include "World.h"
 #include "Object.h"
+#include "BatchIntegrator.h"
+#include "PointGrid.h"
+#include "Arena.h"
+#include "Memory.h"
 
 #include <ImathVec.h>
 #include <ImathColor.h>
@@ -31,6 +37,9 @@ public:
 		\param fID - the flock ID for the flock being created
 		\param theContainer - the reference of the world object */
 	Flock(int fID, World& theContainer);
+
+	/*! \brief destructor deletes the boids and particles owned by the flock */
+	~Flock();
 	
 	/*! \brief method used to clamp a vectors length to maxValue 
 		\param value - the vector that is being clamped
@@ -40,20 +49,53 @@ public:
 	/*! \brief method used to add an instance of a boid to a flock 
 		\param addBoid - a pointer to the boid that is to be added to the flock */
 	void AddBoid(Boid* addBoid);
+
+	/*! \brief method used to add copies of boids from a neighbouring domain for one step. They
+		are marked as ghosts and kept after the flock's own boids, which are left where they were
+		so the neighbours cached for them stay valid
+		\param ghosts - the boids to add, which the flock takes ownership of */
+	void AddGhosts(const std::vector<Boid*>& ghosts);
+
+	/*! \brief method used to take out every ghost added by AddGhosts, without deleting them
+		\param removed - the ghosts taken out are added to this list and the caller takes ownership */
+	void ReleaseGhosts(std::vector<Boid*>& removed);
+
+	/*! \brief method used to take boids out of the flock without deleting them, keeping the rest in order
+		\param remove - one flag per boid, in the order of boids(), set for the boids to take out
+		\param removed - the boids taken out are added to this list and the caller takes ownership */
+	void Release(const std::vector<unsigned char>& remove, std::vector<Boid*>& removed);
 	
 	
+	/*! Lists of the flock's boids and particles, counted against BoidMemory and ParticleMemory */
+	typedef std::vector< Boid*, TrackedAllocator<Boid*, BoidMemory> > BoidList;
+	typedef std::vector< Particle*, TrackedAllocator<Particle*, ParticleMemory> > ParticleList;
+
+	/*! List of boids held in the calling thread's scratch arena, see World::arena */
+	typedef std::vector< Boid*, ArenaAllocator<Boid*> > ScratchBoids;
+
 	/*! \brief method to find the nearest 'n' neighbours to a boid in the flock 
-		\param neighbourBoids - an STL vector passed to the function which is then filled out with pointers to the neighbouring boids 
+		\param neighbourBoids - an STL vector passed to the function which is then filled out with pointers to the neighbouring boids. It must
+			have room reserved for them, as it can't grow inside the arena scope this method opens
 		\param homeBoid - a pointer to the boid under consideration
-		\param numNeighbours - the number of neighbouring boids to find */
-	void NearestNeighbours(std::vector<Boid*>& neighbourBoids, Boid* homeBoid, int numNeighbours);
+		\param numNeighbours - the number of neighbouring boids to find
+		\param numCandidates - the number of boids from the start of the flock to choose from */
+	void NearestNeighbours(ScratchBoids& neighbourBoids, Boid* homeBoid, int numNeighbours, unsigned int numCandidates);
 	
 	/*! \brief method to find the centre of the flock and assign it to the flockCentre variable */
 	void GetFlockCentre();
+
+	/*! \brief method used to give the flock its centre for the next update instead of finding it
+		from the boids. Used when the flock is split across domains and only part of it is here
+		\param centre - the centre of the whole flock */
+	void shareCentre(const Imath::V3f& centre) { m_sharedCentre = centre; m_centreShared = true; };
 	
 	/*! \brief method to implement the local flock centring behaviour */
 	void LocalFlockCentring();
 	
+	/*! \brief method to find the nearest neighbours of every boid and store them in m_neighbourCache
+		\param numNeighbours - the number of neighbours to store for each boid */
+	void RefreshNeighbourCache(int numNeighbours);
+	
 	/*! \brief method to implement the global flock centring behaviour */
 	void GlobalFlockCentring();
 	
@@ -76,11 +118,26 @@ public:
 	
 	/*! \brief method to implement object avoidance around spherical objects */
 	void SphericalObjectAvoidance();
+
+	/*! \brief method to implement object avoidance by following the gradient of the world's
+		baked distance field. Costs a single lookup per boid however many objects there are */
+	void DistanceFieldObjectAvoidance();
+
+	/*! \brief method used by both object avoidance modes to add the spherical avoidance push from
+		the world's moving objects near a boid
+		\param boid - the boid avoiding them
+		\param Accelerate - the push is added to this
+		\param tests - increased by the number of moving objects tested */
+	void AvoidMovingObjects(const Boid& boid, Imath::V3f& Accelerate, unsigned long long& tests);
 	
 	/*! \brief method to create hunting behaviour between flocks */
 	void Hunt();
+
+	/*! \brief method to create hunting behaviour in which each boid chases the prey nearest to it,
+		found through a grid over every lower ranked flock. Used by Hunt in the BoidHunting mode */
+	void HuntNearest();
 	
-	/*! \brief method to create fleeing behaviour away from predator flocks */
+	/*! \brief method to create fleeing behaviour away from the boids of every higher ranked flock at once */
 	void Flee();
 	
 	/*! \brief method to check for boid collisions between flocks resulting in killing of prey */
@@ -92,8 +149,23 @@ public:
 	/*! \brief method to update particle motion */
 	void ParticleUpdate();
 	
-	/*! \brief method to run all the behaviours and update the boid's motions based on the resultant accelerations */
+	/*! \brief method to run all the behaviours and update the boid's motions based on the resultant accelerations.
+		Far from the world's level of detail centre the behaviours are only run every few steps */
 	void Update(Imath::V3f &target);
+
+	/*! \brief method to choose the level of detail for the flock from the distance of its centre
+		to the world's level of detail centre
+		\return 0 for full detail, 1 or 2 for reduced detail */
+	unsigned int DetailLevel() const;
+
+	/*! \brief method to integrate the acceleration of every boid, one at a time or as a batch
+		depending on the world's batchIntegration setting */
+	void Integrate();
+
+	/*! \brief method to reorder the boids by the Morton (Z-order) code of their position within
+		the flock's bounding box. The boids are copied into the new order so that memory order
+		follows it too, and the cached neighbour indices are remapped */
+	void SortBoids();
 	
 	/*! \brief method clear the STL vector of boids */
 	void Clear();
@@ -103,6 +175,21 @@ public:
 	
 	void OBJExport(int frame);
 
+	/*! \brief method to compute a cheap hash of the positions and velocities of every boid in the flock,
+		taken in ID order so reordering the boids leaves it unchanged. 
+		Used to check that two runs produce identical results frame by frame */
+	uint64_t Hash() const;
+
+
+	/*! \brief writes the flock's settings, boids and particles to a binary checkpoint stream
+		\param out - the stream to write to */
+	void Save(std::ostream& out) const;
+
+	/*! \brief restores the state written by Save, replacing any existing boids and particles
+		\param in - the stream to read from
+		\return false if the stream ended early */
+	bool Load(std::istream& in);
+
 
 	struct Property
 	{
@@ -112,6 +199,26 @@ public:
 		float max;
 	};
 
+	/*! Ways the flock can avoid the objects in the world */
+	enum ObjectAvoidanceMode
+	{
+		/*! Tests each object near the boid, see SphericalObjectAvoidance */
+		SphericalAvoidance,
+
+		/*! Looks up the distance field baked from the static objects, see DistanceFieldObjectAvoidance */
+		DistanceFieldAvoidance
+	};
+
+	/*! Ways the flock can hunt the flocks below it in the food chain */
+	enum HuntMode
+	{
+		/*! The whole flock heads for the prey nearest its centre, see Hunt */
+		FlockHunting,
+
+		/*! Each boid chases the prey nearest to itself, see HuntNearest */
+		BoidHunting
+	};
+
 	struct Behaviour
 	{
 		Behaviour( float scale, float max )
@@ -127,7 +234,10 @@ public:
 			hunt( scale, max ),
 			flee( scale, max ),
 			bankingDepth( 3 ),
-			bankingScale( 2 )
+			bankingScale( 2 ),
+			objectAvoidanceMode( SphericalAvoidance ),
+			huntMode( FlockHunting ),
+			huntHold( 0 )
 		{
 
 		}
@@ -170,12 +280,75 @@ public:
 		
 		/*! Floating point scale factor for the boid's banking */
 		float bankingScale;
+
+		/*! How the flock avoids objects */
+		ObjectAvoidanceMode objectAvoidanceMode;
+
+		/*! How the flock hunts */
+		HuntMode huntMode;
+
+		/*! Number of steps each boid chases the same prey for before looking for the nearest
+			again, when hunting boid by boid. 0 or 1 looks every step */
+		unsigned int huntHold;
 	
 	};
 
+	/*! \brief returns the ID of the flock */
+	int id() const { return m_id; };
+
+	/*! \brief returns the behaviour settings of the flock for reading or editing */
+	Behaviour& behaviour() { return m_behaviour; };
+	const Behaviour& behaviour() const { return m_behaviour; };
+
+	void setColour( const Imath::Color4< float >& colour ) { m_colour = colour; };
+	const Imath::Color4< float >& colour() const { return m_colour; };
+
+	/*! \brief returns the boids in the flock, for drawing and exporting */
+	const BoidList& boids() const { return m_boids; };
+
+	/*! \brief returns the particles left by boids this flock has killed */
+	const ParticleList& particles() const { return m_particles; };
+
+	/*! \brief sets the position of the flock in the food chain. Flocks hunt those with a lower rank */
+	void setRank( int rank ) { m_rank = rank; };
+	int rank() const { return m_rank; };
+
+	void setBoidTestRadius( float radius ) { m_boidTR = radius; };
+	float boidTestRadius() const { return m_boidTR; };
+	void setObjectTestRadius( float radius ) { m_objectTR = radius; };
+	float objectTestRadius() const { return m_objectTR; };
+	void setFleeTestRadius( float radius ) { m_fleeTR = radius; };
+	float fleeTestRadius() const { return m_fleeTR; };
+
+	/*! \brief method used to create boids directly in the flock, spread around a point.
+		The boids are seeded with the world's seed so the result is reproducible, and
+		as each boid has its own seed they are made in parallel with the same result.
+		\param numBoids - the number of boids to create
+		\param x - the x co-ordinate of the position around which the boids are created
+		\param y - the y co-ordinate of the position around which the boids are created
+		\param z - the z co-ordinate of the position around which the boids are created
+		\param spread - the spread of the boids around the position */
+	void CreateBoids( int numBoids, double x, double y, double z, double spread );
+
+	/*! \brief method used to create boids directly in the flock from the positions and
+		velocities in a boid file. The file is mapped a chunk at a time and each chunk is
+		turned into boids in parallel, straight into their places in the flock
+		\param filename - the path of the boid file
+		\param chunkSize - the number of boids mapped at once
+		\return false if the file could not be read in full. Boids read before a failure are kept */
+	bool LoadBoids( const std::string& filename, unsigned int chunkSize = 65536 );
+
 
 private:
 
+	/*! List of boids to be written out, counted as ExportMemory */
+	typedef std::vector< const Boid*, TrackedAllocator<const Boid*, ExportMemory> > ExportBoids;
+
+	/*! \brief fills a list with the boids in ID order, which is also creation order, whatever
+		order m_boids has been sorted into. Used wherever the output must not depend on it
+		\param boids - cleared and filled with the boids */
+	void BoidsByID(ExportBoids& boids) const;
+
 	/*! Integer ID for the flock */
 	int m_id;
 	
@@ -193,6 +366,10 @@ private:
 	/*! 3d point with co-ordinates of the flock centre. Recalculated at every time step */
 	Imath::V3f m_flockCentre;
 	
+	/*! Centre given by shareCentre, used in place of the boids' own at the next update */
+	Imath::V3f m_sharedCentre;
+	bool m_centreShared;
+
 	/*! Default Null vector for reseting other vector easily */
 	Imath::V3f m_null;
 	
@@ -212,10 +389,60 @@ private:
 	float m_containmentAcc;
 	
 	/*! STL vector with pointers to all the boids in the flock */
-	std::vector<Boid*> m_boids;
+	BoidList m_boids;
+
+	/*! Number of ghosts at the end of m_boids. They are moved by the domain that owns them, so
+		only the boids before them are integrated, reordered or given cached neighbours */
+	unsigned int m_numGhosts;
 	
 	/*! STL vector with pointers to all the particles created by the boids killing other boids */
-	std::vector<Particle*> m_particles;
+	ParticleList m_particles;
+
+	/*! Level of detail chosen the last time the behaviours were run */
+	unsigned int m_lodLevel;
+
+	/*! Number of steps left before the behaviours are run again */
+	unsigned int m_lodCountdown;
+
+	/*! Number of level 2 behaviour runs left before m_neighbourCache is refreshed */
+	unsigned int m_neighbourCacheAge;
+
+	/*! Indices into m_boids of the nearest neighbours of each of the flock's own boids, a fixed
+		number per boid in the order of m_boids. Ghosts are neither given neighbours nor chosen as
+		them, so they come and go without touching it. Only used at level 2 and discarded when
+		the flock's own boids are added or killed */
+	typedef std::vector< unsigned int, TrackedAllocator<unsigned int, IndexMemory> > IndexList;
+	IndexList m_neighbourCache;
+
+	/*! Set for each sleeping boid, by position in m_boids, that a disturbed flock mate came close to this step */
+	std::vector< unsigned char, TrackedAllocator<unsigned char, IndexMemory> > m_wake;
+
+	/*! Number of steps left before the boids are reordered along the Morton curve */
+	unsigned int m_sortCountdown;
+
+	// Working space for the behaviours and integration. Each is refilled every time it is used
+	// and carries nothing from one step to the next. They are members only so that their memory
+	// is reused, rather than taken from the heap again every step
+
+	/*! The objects near the current boid */
+	std::vector<unsigned int> m_nearbyObjects;
+
+	/*! The runs of moving objects in the grid cells near the current boid */
+	std::vector< std::pair<unsigned int, unsigned int> > m_nearbyRuns;
+
+	/*! The boids of every flock this flock flees from, gathered by Flee */
+	PointGrid m_predators;
+
+	/*! The boids of every flock this flock hunts, gathered by HuntNearest, with the boids in the order
+		added and their flock and boid IDs sorted for finding held targets */
+	PointGrid m_prey;
+	std::vector< Boid*, TrackedAllocator<Boid*, IndexMemory> > m_preyBoids;
+	typedef std::vector< std::pair<uint64_t, unsigned int>, TrackedAllocator<std::pair<uint64_t, unsigned int>, IndexMemory> > PreyLookup;
+	PreyLookup m_preyLookup;
+
+	/*! The flock's positions, velocities and accelerations gathered into one array per component
+		for the batch integrator */
+	BatchIntegrator m_integrator;
 	
 	/*! World pointer to the world containing the flock */
 	World& m_container;
@@ -0,0 +1,57 @@
+#include "Memory.h"
+
+/*!
+\file Memory.cpp
+\brief contains the memory counters for each subsystem
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+/*! Bytes held and allocations made by each subsystem, updated atomically */
+unsigned long long s_bytes[NumMemorySubsystems];
+unsigned long long s_allocations[NumMemorySubsystems];
+
+const char* s_names[NumMemorySubsystems] = { "boids", "particles", "banking", "indices", "scratch", "export" };
+
+} // namespace
+
+
+const char* MemorySubsystemName(MemorySubsystem subsystem)
+{
+	return s_names[subsystem];
+}
+
+
+/* TrackAllocation:
+*  ----------------
+*	Only the totals need to be right, so the updates can be
+*	relaxed.
+*/
+void TrackAllocation(MemorySubsystem subsystem, size_t bytes)
+{
+	__atomic_fetch_add(&s_bytes[subsystem], (unsigned long long)bytes, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s_allocations[subsystem], 1ull, __ATOMIC_RELAXED);
+}
+
+
+void TrackDeallocation(MemorySubsystem subsystem, size_t bytes)
+{
+	__atomic_fetch_sub(&s_bytes[subsystem], (unsigned long long)bytes, __ATOMIC_RELAXED);
+}
+
+
+MemoryCounters MemoryUsage(MemorySubsystem subsystem)
+{
+	MemoryCounters counters;
+	counters.bytes = __atomic_load_n(&s_bytes[subsystem], __ATOMIC_RELAXED);
+	counters.allocations = __atomic_load_n(&s_allocations[subsystem], __ATOMIC_RELAXED);
+
+	return counters;
+}
+
+} // Flock
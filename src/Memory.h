@@ -0,0 +1,117 @@
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <cstddef>
+#include <new>
+
+/*!
+\file Memory.h
+\brief counts the memory held by each part of the simulation, through an STL allocator for the
+	containers and the allocation functions of the classes created one at a time
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+/*! The parts of the simulation whose memory is counted */
+enum MemorySubsystem
+{
+	/*! The boids themselves and each flock's list of them */
+	BoidMemory,
+
+	/*! The particles of each flock and the list of them */
+	ParticleMemory,
+
+	/*! Each boid's history of roll angles used for banking */
+	BankingMemory,
+
+	/*! Indices kept between steps: cached neighbours, prey lookups and the point grids */
+	IndexMemory,
+
+	/*! Blocks held by the world's scratch arenas */
+	ScratchMemory,
+
+	/*! Buffers the boids are written out through: BatchRenderer's instance lists and the storage
+		of its instance buffer, the shared memory snapshot ring, and the lists of boids in ID order
+		that OBJ exports and hashes are written from */
+	ExportMemory,
+
+	NumMemorySubsystems
+};
+
+/*! Memory held by one subsystem */
+struct MemoryCounters
+{
+	/*! Bytes held right now */
+	unsigned long long bytes;
+
+	/*! Number of allocations made since the program started */
+	unsigned long long allocations;
+};
+
+/*! \brief returns the name of a subsystem, as used in reports */
+const char* MemorySubsystemName(MemorySubsystem subsystem);
+
+/*! \brief method used to count memory taken by a subsystem. Safe to call from any thread */
+void TrackAllocation(MemorySubsystem subsystem, size_t bytes);
+
+/*! \brief method used to count memory given back by a subsystem. Safe to call from any thread */
+void TrackDeallocation(MemorySubsystem subsystem, size_t bytes);
+
+/*! \brief returns the memory counted for a subsystem. The counts cover every world in the process */
+MemoryCounters MemoryUsage(MemorySubsystem subsystem);
+
+/*! STL allocator that takes memory from the heap as usual and counts it against a subsystem */
+template< typename T, MemorySubsystem S >
+class TrackedAllocator
+{
+public:
+
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template< typename U >
+	struct rebind { typedef TrackedAllocator< U, S > other; };
+
+	TrackedAllocator() {};
+
+	template< typename U >
+	TrackedAllocator(const TrackedAllocator< U, S >&) {};
+
+	pointer address(reference value) const { return &value; };
+	const_pointer address(const_reference value) const { return &value; };
+
+	pointer allocate(size_type count, const void* = 0)
+	{
+		TrackAllocation(S, count * sizeof(T));
+		return static_cast< pointer >( ::operator new(count * sizeof(T)) );
+	};
+
+	void deallocate(pointer p, size_type count)
+	{
+		TrackDeallocation(S, count * sizeof(T));
+		::operator delete(p);
+	};
+
+	size_type max_size() const { return size_type(-1) / sizeof(T); };
+
+	void construct(pointer p, const T& value) { new( p ) T( value ); };
+	void destroy(pointer p) { p->~T(); };
+};
+
+template< typename T, typename U, MemorySubsystem S >
+bool operator==(const TrackedAllocator< T, S >&, const TrackedAllocator< U, S >&) { return true; }
+
+template< typename T, typename U, MemorySubsystem S >
+bool operator!=(const TrackedAllocator< T, S >&, const TrackedAllocator< U, S >&) { return false; }
+
+}; // Flock
+
+#endif
@@ -0,0 +1,189 @@
+#include "MovingObjects.h"
+#include "World.h"
+#include "Flock.h"
+#include "Object.h"
+#include "Serialise.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <GL/gl.h>
+#include <GL/glut.h>
+
+/*!
+\file MovingObjects.cpp
+\brief contains methods for the moving objects class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+/* Wrap:
+*  -----
+*	Moves every value along one axis and loops those that went
+*	past either bound to the other, as Object::Contain does.
+*	Written without branches so the loop vectorises.
+*/
+void Wrap(std::vector<float>& pos, const std::vector<float>& vel, float low, float high)
+{
+	unsigned int count = pos.size();
+	float* p = count ? &pos[0] : NULL;
+	const float* v = count ? &vel[0] : NULL;
+
+	for(unsigned int o=0; o < count; ++o)
+	{
+		float moved = p[o] + v[o];
+		p[o] = moved > high ? low : (moved < low ? high : moved);
+	}
+}
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Starts with no obstacles.
+*/
+MovingObjects::MovingObjects()
+{
+
+}
+
+
+void MovingObjects::Add(const Imath::V3f& pos, const Imath::V3f& vel)
+{
+	m_posX.push_back(pos.x);
+	m_posY.push_back(pos.y);
+	m_posZ.push_back(pos.z);
+	m_velX.push_back(vel.x);
+	m_velY.push_back(vel.y);
+	m_velZ.push_back(vel.z);
+}
+
+
+void MovingObjects::Clear()
+{
+	m_posX.clear();
+	m_posY.clear();
+	m_posZ.clear();
+	m_velX.clear();
+	m_velY.clear();
+	m_velZ.clear();
+
+	m_grid.Clear(1.0f);
+}
+
+
+/* Update:
+*  -------
+*	Each axis is moved and wrapped separately, unlike Object
+*	which only wraps the first axis out of bounds. The grid is
+*	rebuilt from scratch, which for points costs little more
+*	than a sort and keeps every query exact.
+*/
+void MovingObjects::Update(const World& world)
+{
+	if(m_posX.empty()) { return; }
+
+	Wrap(m_posX, m_velX, world.minX, world.maxX);
+	Wrap(m_posY, m_velY, world.minY, world.maxY);
+	Wrap(m_posZ, m_velZ, world.minZ, world.maxZ);
+
+	// Cells as wide as the furthest any flock looks keep each query to a few cells
+	float cellSize = 0.0f;
+
+	std::vector<Flock*>::const_iterator currentFlock = world.flocks.begin();
+	std::vector<Flock*>::const_iterator endFlock = world.flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		cellSize = std::max(cellSize, (*currentFlock)->objectTestRadius());
+	}
+
+	m_grid.Clear(cellSize);
+
+	for(unsigned int o=0; o < m_posX.size(); ++o)
+	{
+		m_grid.Add(pos(o));
+	}
+
+	m_grid.Build();
+}
+
+
+/* Draw:
+*  -----
+*	Draws a white sphere at each obstacle and a shadow below it.
+*/
+void MovingObjects::Draw(float floorHeight) const
+{
+	float radius = Object::radius();
+
+	for(unsigned int o=0; o < m_posX.size(); ++o)
+	{
+		// Draw sphere
+		glPushMatrix();
+			glTranslatef(m_posX[o], m_posY[o], m_posZ[o]);
+			glColor4f(1.0, 1.0, 1.0, 1.0);
+			glutSolidSphere(radius, 9, 9);
+		glPopMatrix();
+
+		// Draw Shadow
+		glPushMatrix();
+			glTranslatef(m_posX[o], floorHeight + 0.01, m_posZ[o]);
+			glColor4f(0.1, 0.3, 0.1, 1.0);
+			glBegin(GL_TRIANGLE_FAN);
+
+				glVertex3f(0.0, 0.0, 0.0);
+
+				for(float ang=0; ang<=6.3; ang=ang+0.1)
+				{
+					glVertex3f(radius*sin(ang), 0.0, radius*cos(ang));
+				}
+			glEnd();
+		glPopMatrix();
+	}
+}
+
+
+/* Save:
+*  -----
+*	Writes each array in turn.
+*/
+void MovingObjects::Save(std::ostream& out) const
+{
+	WriteVector(out, m_posX);
+	WriteVector(out, m_posY);
+	WriteVector(out, m_posZ);
+	WriteVector(out, m_velX);
+	WriteVector(out, m_velY);
+	WriteVector(out, m_velZ);
+}
+
+
+/* Load:
+*  -----
+*	Reads back the arrays written by Save, which must all be
+*	the same length.
+*/
+bool MovingObjects::Load(std::istream& in)
+{
+	ReadVector(in, m_posX);
+	ReadVector(in, m_posY);
+	ReadVector(in, m_posZ);
+	ReadVector(in, m_velX);
+	ReadVector(in, m_velY);
+
+	if(!ReadVector(in, m_velZ)) { return false; }
+
+	unsigned int count = m_posX.size();
+
+	return m_posY.size() == count && m_posZ.size() == count && m_velX.size() == count
+		&& m_velY.size() == count && m_velZ.size() == count;
+}
+
+} // Flock
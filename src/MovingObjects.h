@@ -0,0 +1,80 @@
+#ifndef __MOVINGOBJECTS_H__
+#define __MOVINGOBJECTS_H__
+
+#include "PointGrid.h"
+
+#include <ImathVec.h>
+
+#include <vector>
+#include <iosfwd>
+
+/*!
+\file MovingObjects.h
+\brief a set of moving spherical obstacles stored as separate coordinate arrays, moved together
+	each frame and gridded so the boids only test the ones near them
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+
+class MovingObjects
+{
+public:
+
+	/*! Default empty constructor for the class */
+	MovingObjects();
+
+	/*! \brief method used to add an obstacle
+		\param pos - where it starts
+		\param vel - the distance it moves each frame */
+	void Add(const Imath::V3f& pos, const Imath::V3f& vel);
+
+	/*! \brief method used to remove every obstacle */
+	void Clear();
+
+	/*! \brief method used to move every obstacle by its velocity, looping those that leave the
+		world back in at the opposite side, then grid them for the frame. Called by World::Update
+		before the flocks are updated
+		\param world - the world holding the obstacles, for its bounds and the flocks' test radii */
+	void Update(const World& world);
+
+	/*! \brief method used to draw a sphere and shadow for every obstacle, like Object::Draw
+		\param floorHeight - the height the shadows are drawn at */
+	void Draw(float floorHeight) const;
+
+	/*! \brief writes every obstacle's position and velocity to a binary checkpoint stream */
+	void Save(std::ostream& out) const;
+
+	/*! \brief reads the obstacles back from a checkpoint written by Save, replacing any there are.
+		The grid is built again by the next Update
+		\return false if the stream ran out of data */
+	bool Load(std::istream& in);
+
+	bool empty() const { return m_posX.empty(); };
+
+	unsigned int size() const { return m_posX.size(); };
+
+	Imath::V3f pos(unsigned int o) const { return Imath::V3f(m_posX[o], m_posY[o], m_posZ[o]); };
+
+	Imath::V3f vel(unsigned int o) const { return Imath::V3f(m_velX[o], m_velY[o], m_velZ[o]); };
+
+	/*! \brief returns the grid over the obstacles' positions as of the last Update. Its cells are as
+		wide as the largest object test radius of any flock */
+	const PointGrid& grid() const { return m_grid; };
+
+private:
+
+	/*! Position and velocity of each obstacle, one array per axis */
+	std::vector<float> m_posX, m_posY, m_posZ;
+	std::vector<float> m_velX, m_velY, m_velZ;
+
+	PointGrid m_grid;
+};
+
+}; // Flock
+
+#endif
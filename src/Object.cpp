@@ -1,4 +1,5 @@
 #include "Object.h"
+#include "Serialise.h"
 
 #include <GL/gl.h>
 #include <GL/glut.h>
@@ -47,7 +48,8 @@ void Object::Contain()
 
 /* Update:
 *  -------
-*	A very simple position update that is not currently used.
+*	A very simple position update, called by the world for
+*	objects that have a velocity.
 */
 void Object::Update()
 {
@@ -67,7 +69,7 @@ void Object::Draw()
 	glPushMatrix();
 		glTranslatef(m_pos.x, m_pos.y, m_pos.z);
 		glColor4f(1.0, 1.0, 1.0, 1.0);
-		glutSolidSphere(2, 9, 9);
+		glutSolidSphere(radius(), 9, 9);
 	glPopMatrix();
 	
 	// Draw Shadow
@@ -80,10 +82,30 @@ void Object::Draw()
 			
 			for(float ang=0; ang<=6.3; ang=ang+0.1)
 			{
-				glVertex3f(2*sin(ang), 0.0, 2*cos(ang));
+				glVertex3f(radius()*sin(ang), 0.0, radius()*cos(ang));
 			}
 		glEnd();
 	glPopMatrix();
 }
 
+/* Save:
+*  -----
+*	Writes the object's motion state to a checkpoint.
+*/
+void Object::Save(std::ostream& out) const
+{
+	Write(out, m_pos);
+	Write(out, m_vel);
+}
+
+/* Load:
+*  -----
+*	Reads back the state written by Save.
+*/
+bool Object::Load(std::istream& in)
+{
+	Read(in, m_pos);
+	return Read(in, m_vel);
+}
+
 } // Flock
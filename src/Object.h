@@ -5,6 +5,8 @@
 
 #include <ImathVec.h>
 
+#include <iosfwd>
+
 namespace Flock {
 
 /*!
@@ -33,7 +35,7 @@ public:
 	void Contain();
 	
 	/*! \fn void Update()
-		this method updates the objects position
+		this method updates the objects position. Called by the world each frame for moving objects
 		\todo Add greater flexibility, currently only supports fixed x direction movement */
 	void Update();
 	
@@ -41,7 +43,25 @@ public:
 		this method draws a white sphere at the current object position */
 	void Draw();
 
-	const Imath::V3f& pos() { return m_pos; };
+	const Imath::V3f& pos() const { return m_pos; };
+
+	/*! \brief returns the radius of the sphere drawn for every object */
+	static float radius() { return 2.0f; };
+
+	const Imath::V3f& vel() const { return m_vel; };
+
+	/*! \brief sets the distance the object moves each time Update is called */
+	void setVel( const Imath::V3f& vel ) { m_vel = vel; };
+
+	/*! \brief true if the object has a velocity, so the world needs to update it */
+	bool moving() const { return m_vel.x != 0.0f || m_vel.y != 0.0f || m_vel.z != 0.0f; };
+
+	/*! \brief writes the object's position and velocity to a binary checkpoint stream */
+	void Save(std::ostream& out) const;
+
+	/*! \brief restores the state written by Save
+		\return false if the stream ended early */
+	bool Load(std::istream& in);
 
 private:
 
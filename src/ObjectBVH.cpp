@@ -0,0 +1,208 @@
+#include "ObjectBVH.h"
+
+#include "Object.h"
+
+#include <algorithm>
+
+/*!
+\file ObjectBVH.cpp
+\brief contains methods for the object bounding volume hierarchy
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+/*! Orders object indices by one component of the object centres */
+struct CompareAxis
+{
+	CompareAxis(const std::vector<Imath::V3f>& centres, unsigned int axis)
+	 :	m_centres( centres ),
+		m_axis( axis )
+	{
+
+	}
+
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		return m_centres[a][m_axis] < m_centres[b][m_axis];
+	}
+
+	const std::vector<Imath::V3f>& m_centres;
+	unsigned int m_axis;
+};
+
+/*! Squared distance from a point to the nearest point of a box */
+float DistanceSquared(const Imath::Box3f& box, const Imath::V3f& point)
+{
+	float total = 0.0f;
+
+	for(unsigned int i=0; i < 3; ++i)
+	{
+		float d = 0.0f;
+
+		if(point[i] < box.min[i])
+			d = box.min[i] - point[i];
+		else if(point[i] > box.max[i])
+			d = point[i] - box.max[i];
+
+		total += d * d;
+	}
+
+	return total;
+}
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Empty
+*/
+ObjectBVH::ObjectBVH()
+{
+
+}
+
+
+/* Build:
+*  ------
+*	Splits the objects at the median of the longest axis
+*	until each leaf holds only a few objects.
+*/
+void ObjectBVH::Build(const std::vector<Object*>& objects)
+{
+	m_nodes.clear();
+	m_indices.clear();
+
+	if(objects.empty()) { return; }
+
+	std::vector<Imath::V3f> centres;
+	centres.reserve(objects.size());
+
+	for(unsigned int i=0; i < objects.size(); ++i)
+	{
+		centres.push_back(objects[i]->pos());
+		m_indices.push_back(i);
+	}
+
+	m_nodes.reserve(2 * (objects.size() / LeafSize + 1));
+	m_nodes.push_back(Node());
+
+	Split(0, 0, objects.size(), centres);
+}
+
+
+/* Split:
+*  ------
+*	Sets the bounds of a node and either makes it a leaf or
+*	divides its objects between two new children.
+*/
+void ObjectBVH::Split(unsigned int node, unsigned int first, unsigned int count, const std::vector<Imath::V3f>& centres)
+{
+	Imath::Box3f bounds;
+
+	for(unsigned int i=first; i < first + count; ++i)
+	{
+		bounds.extendBy(centres[m_indices[i]]);
+	}
+
+	m_nodes[node].bounds = bounds;
+	m_nodes[node].left = 0;
+	m_nodes[node].first = first;
+	m_nodes[node].count = count;
+
+	if(count <= LeafSize) { return; }
+
+	unsigned int half = count / 2;
+
+	std::nth_element(m_indices.begin() + first, m_indices.begin() + first + half,
+		m_indices.begin() + first + count, CompareAxis(centres, bounds.majorAxis()));
+
+	// Children are always added after their parent, which Refit relies on
+	unsigned int left = m_nodes.size();
+	m_nodes.push_back(Node());
+	m_nodes.push_back(Node());
+
+	m_nodes[node].left = left;
+	m_nodes[node].count = 0;
+
+	Split(left, first, half, centres);
+	Split(left + 1, first + half, count - half, centres);
+}
+
+
+/* Refit:
+*  ------
+*	Recalculates the bounds from the leaves upwards. Walking the
+*	nodes backwards visits every child before its parent.
+*/
+void ObjectBVH::Refit(const std::vector<Object*>& objects)
+{
+	for(unsigned int n = m_nodes.size(); n > 0; --n)
+	{
+		Node& node = m_nodes[n - 1];
+
+		node.bounds.makeEmpty();
+
+		if(node.left == 0)
+		{
+			for(unsigned int i=node.first; i < node.first + node.count; ++i)
+			{
+				node.bounds.extendBy(objects[m_indices[i]]->pos());
+			}
+		}
+		else
+		{
+			node.bounds.extendBy(m_nodes[node.left].bounds);
+			node.bounds.extendBy(m_nodes[node.left + 1].bounds);
+		}
+	}
+}
+
+
+/* Query:
+*  ------
+*	Walks down the tree skipping any node whose bounds are
+*	further from the centre than the radius.
+*/
+void ObjectBVH::Query(const Imath::V3f& centre, float radius, std::vector<unsigned int>& indices) const
+{
+	indices.clear();
+
+	if(m_nodes.empty()) { return; }
+
+	float radiusSquared = radius * radius;
+
+	unsigned int stack[64];
+	unsigned int top = 0;
+
+	stack[top++] = 0;
+
+	while(top > 0)
+	{
+		const Node& node = m_nodes[stack[--top]];
+
+		if(DistanceSquared(node.bounds, centre) > radiusSquared) { continue; }
+
+		if(node.left == 0)
+		{
+			for(unsigned int i=node.first; i < node.first + node.count; ++i)
+			{
+				indices.push_back(m_indices[i]);
+			}
+		}
+		else
+		{
+			stack[top++] = node.left;
+			stack[top++] = node.left + 1;
+		}
+	}
+
+	std::sort(indices.begin(), indices.end());
+}
+
+} // Flock
@@ -0,0 +1,75 @@
+#ifndef __OBJECTBVH_H__
+#define __OBJECTBVH_H__
+
+#include <vector>
+
+#include <ImathVec.h>
+#include <ImathBox.h>
+
+/*!
+\file ObjectBVH.h
+\brief bounding volume hierarchy over the objects in the world
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class Object;
+
+class ObjectBVH
+{
+public:
+
+	/*! Default empty constructor for the class */
+	ObjectBVH();
+
+	/*! \brief method used to rebuild the hierarchy from scratch. Needed whenever objects are added or removed
+		\param objects - the objects to build the hierarchy over */
+	void Build(const std::vector<Object*>& objects);
+
+	/*! \brief method used to update the node bounds after objects have moved, keeping the tree shape.
+		Cheaper than Build but the tree gets looser the further the objects move
+		\param objects - the same objects, in the same order, as passed to Build */
+	void Refit(const std::vector<Object*>& objects);
+
+	/*! \brief method to find every object whose bounds touch a sphere
+		\param centre - the centre of the sphere
+		\param radius - the radius of the sphere
+		\param indices - filled out with the indices of the objects found, in ascending order,
+		so that callers visit objects in the same order as a loop over the whole list */
+	void Query(const Imath::V3f& centre, float radius, std::vector<unsigned int>& indices) const;
+
+	bool empty() const { return m_nodes.empty(); };
+
+private:
+
+	/*! A node covers either two child nodes or a short run of m_indices */
+	struct Node
+	{
+		Imath::Box3f bounds;
+
+		/*! Index of the first child. The second child always follows it. Zero for leaves */
+		unsigned int left;
+
+		/*! First entry in m_indices and the number of entries, for leaves */
+		unsigned int first;
+		unsigned int count;
+	};
+
+	/*! \brief method to build the subtree for entries [first, first+count) of m_indices under node 'node' */
+	void Split(unsigned int node, unsigned int first, unsigned int count, const std::vector<Imath::V3f>& centres);
+
+	/*! Maximum number of objects held in a leaf */
+	static const unsigned int LeafSize = 4;
+
+	std::vector<Node> m_nodes;
+
+	/*! Object indices, reordered so that each leaf covers a contiguous run */
+	std::vector<unsigned int> m_indices;
+};
+
+}; // Flock
+
+#endif
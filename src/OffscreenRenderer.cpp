@@ -0,0 +1,183 @@
+#include "OffscreenRenderer.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+/*!
+\file OffscreenRenderer.cpp
+\brief contains methods for the offscreen renderer class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/* Constructor:
+*  ------------
+*	Sets up the lock, the thread starts in Start.
+*/
+OffscreenRenderer::OffscreenRenderer(unsigned int width, unsigned int height)
+ :	m_renderer( width, height ),
+	m_queueDepth( 2 ),
+	m_running( false ),
+	m_stopping( false ),
+	m_framesWritten( 0 ),
+	m_framesFailed( 0 )
+{
+	pthread_mutex_init(&m_lock, NULL);
+	pthread_cond_init(&m_changed, NULL);
+}
+
+
+/* Destructor:
+*  -----------
+*	Finishes off the queue and frees the captured frames.
+*/
+OffscreenRenderer::~OffscreenRenderer()
+{
+	Stop();
+
+	for(unsigned int f=0; f < m_spare.size(); ++f)
+		delete m_spare[f];
+
+	pthread_cond_destroy(&m_changed);
+	pthread_mutex_destroy(&m_lock);
+}
+
+
+/* Start:
+*  ------
+*	Starts the render thread.
+*/
+bool OffscreenRenderer::Start(const std::string& prefix, unsigned int queueDepth)
+{
+	if(m_running) { Stop(); }
+
+	m_prefix = prefix;
+	m_queueDepth = queueDepth ? queueDepth : 1;
+	m_stopping = false;
+	m_framesWritten = 0;
+	m_framesFailed = 0;
+
+	if(pthread_create(&m_thread, NULL, Run, this) != 0)
+	{
+		std::cout << "Error: unable to start the render thread" << std::endl;
+		return false;
+	}
+
+	m_running = true;
+
+	return true;
+}
+
+
+/* Submit:
+*  -------
+*	Waits for room in the queue then copies the world into a
+*	spare frame. The copy is made here, on the simulation's
+*	thread, so the render thread never reads the live world.
+*/
+void OffscreenRenderer::Submit(const World& world, unsigned int number)
+{
+	if(!m_running) { return; }
+
+	pthread_mutex_lock(&m_lock);
+
+	while(m_queue.size() >= m_queueDepth)
+		pthread_cond_wait(&m_changed, &m_lock);
+
+	SoftwareRenderer::Frame* frame;
+
+	if(m_spare.empty())
+	{
+		frame = new SoftwareRenderer::Frame;
+	}
+	else
+	{
+		frame = m_spare.back();
+		m_spare.pop_back();
+	}
+
+	pthread_mutex_unlock(&m_lock);
+
+	SoftwareRenderer::Capture(world, number, *frame);
+
+	pthread_mutex_lock(&m_lock);
+	m_queue.push_back(frame);
+	pthread_cond_broadcast(&m_changed);
+	pthread_mutex_unlock(&m_lock);
+}
+
+
+/* Stop:
+*  -----
+*	Lets the render thread empty the queue, then joins it.
+*/
+void OffscreenRenderer::Stop()
+{
+	if(!m_running) { return; }
+
+	pthread_mutex_lock(&m_lock);
+	m_stopping = true;
+	pthread_cond_broadcast(&m_changed);
+	pthread_mutex_unlock(&m_lock);
+
+	pthread_join(m_thread, NULL);
+
+	m_running = false;
+}
+
+
+void* OffscreenRenderer::Run(void* self)
+{
+	static_cast<OffscreenRenderer*>(self)->Loop();
+	return NULL;
+}
+
+
+/* Loop:
+*  -----
+*	Renders and writes each queued frame in turn. The lock is
+*	only held while taking a frame off the queue and handing
+*	it back.
+*/
+void OffscreenRenderer::Loop()
+{
+	pthread_mutex_lock(&m_lock);
+
+	for(;;)
+	{
+		while(m_queue.empty() && !m_stopping)
+			pthread_cond_wait(&m_changed, &m_lock);
+
+		if(m_queue.empty()) { break; }
+
+		SoftwareRenderer::Frame* frame = m_queue.front();
+		m_queue.pop_front();
+
+		pthread_mutex_unlock(&m_lock);
+
+		m_renderer.Render(*frame);
+
+		std::ostringstream filename;
+		filename << m_prefix << "." << std::setfill('0') << std::setw(4) << frame->number << ".ppm";
+
+		bool written = m_renderer.WritePPM(filename.str());
+
+		pthread_mutex_lock(&m_lock);
+
+		if(written)
+			++m_framesWritten;
+		else
+			++m_framesFailed;
+
+		m_spare.push_back(frame);
+		pthread_cond_broadcast(&m_changed);
+	}
+
+	pthread_mutex_unlock(&m_lock);
+}
+
+} // Flock
@@ -0,0 +1,87 @@
+#ifndef __OFFSCREENRENDERER_H__
+#define __OFFSCREENRENDERER_H__
+
+#include <deque>
+#include <vector>
+#include <string>
+
+#include <pthread.h>
+
+#include "SoftwareRenderer.h"
+
+/*!
+\file OffscreenRenderer.h
+\brief renders an image sequence of the world on its own thread while the simulation carries on
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+
+class OffscreenRenderer
+{
+public:
+
+	/*! \brief constructor for the class. Nothing is rendered until Start
+		\param width - width of the images in pixels
+		\param height - height of the images in pixels */
+	OffscreenRenderer(unsigned int width, unsigned int height);
+
+	/*! \brief destructor finishes any queued frames */
+	~OffscreenRenderer();
+
+	/*! \brief method used to start the render thread
+		\param prefix - images are written to prefix.0001.ppm, prefix.0002.ppm and so on
+		\param queueDepth - how many captured frames may wait to be rendered before Submit blocks
+		\return false if the thread could not be started */
+	bool Start(const std::string& prefix, unsigned int queueDepth = 2);
+
+	/*! \brief method used to queue the world's current state for rendering. Only copies the
+		state, so the world can be updated again as soon as this returns
+		\param world - the world to render
+		\param number - the frame number, used in the image's filename */
+	void Submit(const World& world, unsigned int number);
+
+	/*! \brief method used to render everything still queued and stop the thread */
+	void Stop();
+
+	/*! \brief the camera used for every frame. Only change it while stopped */
+	SoftwareRenderer::Camera& camera() { return m_renderer.camera; };
+
+	unsigned int framesWritten() const { return m_framesWritten; };
+	unsigned int framesFailed() const { return m_framesFailed; };
+
+private:
+
+	/*! \brief entry point for the render thread */
+	static void* Run(void* self);
+
+	/*! \brief takes frames off the queue until told to stop */
+	void Loop();
+
+	SoftwareRenderer m_renderer;
+
+	std::string m_prefix;
+	unsigned int m_queueDepth;
+
+	/*! Captured frames waiting to be rendered, and spare ones to capture into */
+	std::deque<SoftwareRenderer::Frame*> m_queue;
+	std::vector<SoftwareRenderer::Frame*> m_spare;
+
+	pthread_t m_thread;
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_changed;
+
+	bool m_running;
+	bool m_stopping;
+
+	unsigned int m_framesWritten;
+	unsigned int m_framesFailed;
+};
+
+}; // Flock
+
+#endif
@@ -1,4 +1,5 @@
 #include "Particle.h"
+#include "Serialise.h"
 
 #include <GL/gl.h>
 #include <GL/glu.h>
@@ -26,6 +27,22 @@ Particle::~Particle()
 
 }
 
+/* new / delete:
+*  -------------
+*	Particles come from the heap as before, but are counted.
+*/
+void* Particle::operator new( size_t bytes )
+{
+	TrackAllocation( ParticleMemory, bytes );
+	return ::operator new( bytes );
+}
+
+void Particle::operator delete( void* memory, size_t bytes )
+{
+	TrackDeallocation( ParticleMemory, bytes );
+	::operator delete( memory );
+}
+
 /* Constructor:
 *  ------------
 *	Sets default values for the object
@@ -47,12 +64,16 @@ Particle::Particle(Imath::V3f boidPos, Imath::Color4<float> boidColour, float fH
 *  -------
 *	Simple update of the particles position taking into account
 *	the gravitational down direction. Actual value is not 9.8
+*	Dir is the distance moved in a 0.04 second step, so other
+*	step lengths scale both updates.
 */
-void Particle::Update()
+void Particle::Update(float timeStep)
 {
-	Dir = Dir + gravity/25.0;
+	float scale = timeStep / 0.04f;
+
+	Dir = Dir + gravity/25.0 * scale;
 
-	Pos = Pos + Dir;
+	Pos = Pos + Dir * scale;
 }
 
 /* Draw:
@@ -93,4 +114,31 @@ void Particle::Draw()
 	glPopMatrix();
 }
 
+/* Save:
+*  -----
+*	Writes the particle's state to a checkpoint.
+*/
+void Particle::Save(std::ostream& out) const
+{
+	Write(out, Pos);
+	Write(out, Dir);
+	Write(out, colour);
+	Write(out, gravity);
+	Write(out, floorHeight);
+}
+
+/* Load:
+*  -----
+*	Reads back the state written by Save.
+*/
+bool Particle::Load(std::istream& in)
+{
+	Read(in, Pos);
+	Read(in, Dir);
+	Read(in, colour);
+	Read(in, gravity);
+	
+	return Read(in, floorHeight);
+}
+
 } // Flock
@@ -1,8 +1,12 @@
 #ifndef __PARTICLE_H__
 #define __PARTICLE_H__
 
+#include "Memory.h"
+
 #include <ImathColor.h>
 
+#include <iosfwd>
+
 
 namespace Flock {
 
@@ -38,6 +42,10 @@ public:
 	
 	/*! Default empty deconstructor for the class */
 	~Particle();
+
+	/*! \brief allocation functions that count each particle against ParticleMemory */
+	static void* operator new( size_t bytes );
+	static void operator delete( void* memory, size_t bytes );
 	
 	/*! \brief this constructor method creates a particle at a certain point with specified colour
 		\param boidPos - position to create the particle at
@@ -46,11 +54,19 @@ public:
 		*/
 	Particle( Imath::V3f boidPos, Imath::Color4<float> boidColor, float fHeight);
 	
-	/*! \brief this method updates the particle's motion */
-	void Update();
+	/*! \brief this method updates the particle's motion
+		\param timeStep - the length of the step in seconds. The motion was tuned for steps of 0.04 */
+	void Update(float timeStep = 0.04f);
 	
 	/*! \brief this method draws the particle at location Pos */
 	void Draw();
+
+	/*! \brief writes the particle's state to a binary checkpoint stream */
+	void Save(std::ostream& out) const;
+
+	/*! \brief restores the state written by Save
+		\return false if the stream ended early */
+	bool Load(std::istream& in);
 };
 
 }; // Flock
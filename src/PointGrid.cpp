@@ -0,0 +1,314 @@
+#include "PointGrid.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+/*!
+\file PointGrid.cpp
+\brief contains methods for the point grid class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/*! Cell coordinates are offset by this to keep them positive in the 21 bits each has in a key */
+static const int s_cellOffset = 1 << 20;
+
+/* Constructor:
+*  ------------
+*	Starts empty.
+*/
+PointGrid::PointGrid()
+ :	m_cellSize( 1.0f )
+{
+
+}
+
+
+/* Clear:
+*  ------
+*	Keeps the memory for the next set of points.
+*/
+void PointGrid::Clear(float cellSize)
+{
+	m_cellSize = cellSize > 0.0f ? cellSize : 1.0f;
+
+	for(unsigned int a=0; a < 3; ++a)
+	{
+		m_low[a] = 0;
+		m_high[a] = -1;
+	}
+
+	m_added.clear();
+	m_keys.clear();
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+	m_index.clear();
+}
+
+
+void PointGrid::Add(const Imath::V3f& point)
+{
+	m_added.push_back(point);
+}
+
+
+/* Build:
+*  ------
+*	Sorts the points by cell key, then by the order they were
+*	added, and lays the coordinates out in separate arrays so
+*	a run of them can be loaded eight at a time.
+*/
+void PointGrid::Build()
+{
+	unsigned int numPoints = m_added.size();
+
+	m_order.resize(numPoints);
+
+	for(unsigned int p=0; p < numPoints; ++p)
+	{
+		const Imath::V3f& point = m_added[p];
+		int cell[3] = { Cell(point.x), Cell(point.y), Cell(point.z) };
+
+		m_order[p] = std::make_pair(Key(cell[0], cell[1], cell[2]), p);
+
+		for(unsigned int a=0; a < 3; ++a)
+		{
+			m_low[a] = p == 0 ? cell[a] : std::min(m_low[a], cell[a]);
+			m_high[a] = p == 0 ? cell[a] : std::max(m_high[a], cell[a]);
+		}
+	}
+
+	std::sort(m_order.begin(), m_order.end());
+
+	m_keys.resize(numPoints);
+	m_x.resize(numPoints);
+	m_y.resize(numPoints);
+	m_z.resize(numPoints);
+	m_index.resize(numPoints);
+
+	for(unsigned int p=0; p < numPoints; ++p)
+	{
+		const Imath::V3f& point = m_added[m_order[p].second];
+
+		m_keys[p] = m_order[p].first;
+		m_x[p] = point.x;
+		m_y[p] = point.y;
+		m_z[p] = point.z;
+		m_index[p] = m_order[p].second;
+	}
+}
+
+
+/* Runs:
+*  -----
+*	For each column of cells along z the cells are adjacent in
+*	the sorted order, so each column is a single run.
+*/
+void PointGrid::Runs(const Imath::V3f& centre, float radius, std::vector< std::pair<unsigned int, unsigned int> >& runs) const
+{
+	runs.clear();
+
+	if(m_keys.empty()) { return; }
+
+	int lowX = Cell(centre.x - radius), highX = Cell(centre.x + radius);
+	int lowY = Cell(centre.y - radius), highY = Cell(centre.y + radius);
+	int lowZ = Cell(centre.z - radius), highZ = Cell(centre.z + radius);
+
+	for(int x=lowX; x <= highX; ++x)
+	{
+		for(int y=lowY; y <= highY; ++y)
+		{
+			unsigned int first = std::lower_bound(m_keys.begin(), m_keys.end(), Key(x, y, lowZ)) - m_keys.begin();
+			unsigned int last = std::upper_bound(m_keys.begin() + first, m_keys.end(), Key(x, y, highZ)) - m_keys.begin();
+
+			if(first < last)
+				runs.push_back(std::make_pair(first, last));
+		}
+	}
+}
+
+
+/* SumInverseSquare:
+*  -----------------
+*	Goes over the same runs as Runs without building a list.
+*	Points outside the radius are masked out of the sums
+*	rather than branched around.
+*/
+Imath::V3f PointGrid::SumInverseSquare(const Imath::V3f& centre, float radius, unsigned int& tested) const
+{
+	Imath::V3f sum(0.0f, 0.0f, 0.0f);
+
+	if(m_keys.empty()) { return sum; }
+
+	float radius2 = radius * radius;
+
+	int lowX = Cell(centre.x - radius), highX = Cell(centre.x + radius);
+	int lowY = Cell(centre.y - radius), highY = Cell(centre.y + radius);
+	int lowZ = Cell(centre.z - radius), highZ = Cell(centre.z + radius);
+
+#ifdef __AVX__
+	const __m256 cx = _mm256_set1_ps(centre.x);
+	const __m256 cy = _mm256_set1_ps(centre.y);
+	const __m256 cz = _mm256_set1_ps(centre.z);
+	const __m256 r2 = _mm256_set1_ps(radius2);
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 sumX = zero, sumY = zero, sumZ = zero;
+#endif
+
+	for(int x=lowX; x <= highX; ++x)
+	{
+		for(int y=lowY; y <= highY; ++y)
+		{
+			unsigned int p = std::lower_bound(m_keys.begin(), m_keys.end(), Key(x, y, lowZ)) - m_keys.begin();
+			unsigned int last = std::upper_bound(m_keys.begin() + p, m_keys.end(), Key(x, y, highZ)) - m_keys.begin();
+
+			tested += last - p;
+
+#ifdef __AVX__
+			for(; p + 8 <= last; p += 8)
+			{
+				__m256 dx = _mm256_sub_ps(cx, _mm256_loadu_ps(&m_x[p]));
+				__m256 dy = _mm256_sub_ps(cy, _mm256_loadu_ps(&m_y[p]));
+				__m256 dz = _mm256_sub_ps(cz, _mm256_loadu_ps(&m_z[p]));
+
+				__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+				__m256 inside = _mm256_and_ps(_mm256_cmp_ps(d2, r2, _CMP_LT_OQ), _mm256_cmp_ps(d2, zero, _CMP_GT_OQ));
+
+				// Lanes outside divide by one instead and are then zeroed
+				__m256 weight = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_blendv_ps(_mm256_set1_ps(1.0f), d2, inside)), inside);
+
+				sumX = _mm256_add_ps(sumX, _mm256_mul_ps(dx, weight));
+				sumY = _mm256_add_ps(sumY, _mm256_mul_ps(dy, weight));
+				sumZ = _mm256_add_ps(sumZ, _mm256_mul_ps(dz, weight));
+			}
+#endif
+
+			for(; p < last; ++p)
+			{
+				float dx = centre.x - m_x[p];
+				float dy = centre.y - m_y[p];
+				float dz = centre.z - m_z[p];
+				float d2 = dx*dx + dy*dy + dz*dz;
+
+				if(d2 < radius2 && d2 > 0.0f)
+				{
+					sum.x += dx / d2;
+					sum.y += dy / d2;
+					sum.z += dz / d2;
+				}
+			}
+		}
+	}
+
+#ifdef __AVX__
+	float lanes[3][8];
+	_mm256_storeu_ps(lanes[0], sumX);
+	_mm256_storeu_ps(lanes[1], sumY);
+	_mm256_storeu_ps(lanes[2], sumZ);
+
+	for(unsigned int l=0; l < 8; ++l)
+	{
+		sum.x += lanes[0][l];
+		sum.y += lanes[1][l];
+		sum.z += lanes[2][l];
+	}
+#endif
+
+	return sum;
+}
+
+
+/* Nearest:
+*  --------
+*	Searches the cells within a growing number of rings of
+*	the centre's cell. Once the best point found is no further
+*	away than the inner edge of the next ring, nothing beyond
+*	can be nearer. Ties go to the point added first.
+*/
+unsigned int PointGrid::Nearest(const Imath::V3f& centre, unsigned int& tested) const
+{
+	unsigned int best = m_keys.size();
+	float bestDistance2 = 0.0f;
+
+	if(m_keys.empty()) { return best; }
+
+	int cell[3] = { Cell(centre.x), Cell(centre.y), Cell(centre.z) };
+
+	// The number of rings needed to cover every cell holding points
+	int maxRing = 0;
+	for(unsigned int a=0; a < 3; ++a)
+		maxRing = std::max(maxRing, std::max(cell[a] - m_low[a], m_high[a] - cell[a]));
+
+	for(int ring=0; ring <= maxRing; ring = std::min(std::max(ring * 2, 1), maxRing))
+	{
+		// Earlier rings are searched again, which keeps each column a single run
+		for(int x=cell[0] - ring; x <= cell[0] + ring; ++x)
+		{
+			for(int y=cell[1] - ring; y <= cell[1] + ring; ++y)
+			{
+				unsigned int p = std::lower_bound(m_keys.begin(), m_keys.end(), Key(x, y, cell[2] - ring)) - m_keys.begin();
+				unsigned int last = std::upper_bound(m_keys.begin() + p, m_keys.end(), Key(x, y, cell[2] + ring)) - m_keys.begin();
+
+				tested += last - p;
+
+				for(; p < last; ++p)
+				{
+					float dx = centre.x - m_x[p];
+					float dy = centre.y - m_y[p];
+					float dz = centre.z - m_z[p];
+					float d2 = dx*dx + dy*dy + dz*dz;
+
+					if(best == m_keys.size() || d2 < bestDistance2 || (d2 == bestDistance2 && m_index[p] < m_index[best]))
+					{
+						best = p;
+						bestDistance2 = d2;
+					}
+				}
+			}
+		}
+
+		// Every point outside the cells searched is at least this far away
+		float reach = 0.0f;
+		for(unsigned int a=0; a < 3; ++a)
+		{
+			float value = a == 0 ? centre.x : (a == 1 ? centre.y : centre.z);
+			float inside = std::min(value - (cell[a] - ring) * m_cellSize, (cell[a] + ring + 1) * m_cellSize - value);
+			reach = a == 0 ? inside : std::min(reach, inside);
+		}
+
+		if(best != m_keys.size() && bestDistance2 <= reach * reach) { break; }
+		if(ring == maxRing) { break; }
+	}
+
+	return best;
+}
+
+
+uint64_t PointGrid::Key(int x, int y, int z) const
+{
+	return (uint64_t(x + s_cellOffset) << 42) | (uint64_t(y + s_cellOffset) << 21) | uint64_t(z + s_cellOffset);
+}
+
+
+/* Cell:
+*  -----
+*	Clamped so that stray positions far outside the world
+*	still land in a cell the key can hold.
+*/
+int PointGrid::Cell(float value) const
+{
+	float cell = std::floor(value / m_cellSize);
+
+	return int(std::max(std::min(cell, float(s_cellOffset - 1)), float(1 - s_cellOffset)));
+}
+
+} // Flock
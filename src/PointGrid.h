@@ -0,0 +1,98 @@
+#ifndef __POINTGRID_H__
+#define __POINTGRID_H__
+
+#include <vector>
+#include <stdint.h>
+
+#include <ImathVec.h>
+
+#include "Memory.h"
+
+/*!
+\file PointGrid.h
+\brief uniform grid over a set of points, such as the boids of several flocks, for finding those near a position
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class PointGrid
+{
+public:
+
+	/*! Default empty constructor for the class */
+	PointGrid();
+
+	/*! \brief method used to empty the grid ready for a new set of points
+		\param cellSize - the width of each cell. Queries are cheapest with radii no larger than this */
+	void Clear(float cellSize);
+
+	/*! \brief method used to add a point. The grid can't be queried until Build is called */
+	void Add(const Imath::V3f& point);
+
+	/*! \brief method used to sort the points added into their cells */
+	void Build();
+
+	/*! \brief method to find the runs of points, in the sorted order, that lie in the cells touching
+		a cube around a position. The points in the runs still need testing against the radius
+		\param centre - the centre of the cube
+		\param radius - half the width of the cube
+		\param runs - filled out with the first point and one past the last point of each run */
+	void Runs(const Imath::V3f& centre, float radius, std::vector< std::pair<unsigned int, unsigned int> >& runs) const;
+
+	/*! \brief method to add up the vectors from each point within a radius to a position, each
+		divided by its length squared. Points at the position itself are left out. Eight points are
+		done at once where AVX is available
+		\param centre - the position
+		\param radius - only points closer than this count
+		\param tested - increased by the number of points tested against the radius
+		\return the sum */
+	Imath::V3f SumInverseSquare(const Imath::V3f& centre, float radius, unsigned int& tested) const;
+
+	/*! \brief method to find the point nearest a position, searching outwards a ring of cells at a time
+		\param centre - the position
+		\param tested - increased by the number of points whose distance was measured
+		\return the point's position in the sorted order, or size() if the grid is empty */
+	unsigned int Nearest(const Imath::V3f& centre, unsigned int& tested) const;
+
+	bool empty() const { return m_keys.empty(); };
+
+	unsigned int size() const { return m_keys.size(); };
+
+	/*! \brief returns a point by its position in the sorted order */
+	Imath::V3f point(unsigned int p) const { return Imath::V3f(m_x[p], m_y[p], m_z[p]); };
+
+	/*! \brief returns the order a point in the sorted order was added in */
+	unsigned int index(unsigned int p) const { return m_index[p]; };
+
+private:
+
+	/*! \brief returns the key of the cell containing a position, with cell coordinates packed
+		x, y then z from the high bits down, so cells along z have consecutive keys */
+	uint64_t Key(int x, int y, int z) const;
+
+	/*! \brief returns the cell coordinate along one axis */
+	int Cell(float value) const;
+
+	float m_cellSize;
+
+	/*! Range of cell coordinates holding points, so Nearest knows when to stop */
+	int m_low[3], m_high[3];
+
+	/*! Points as added, until Build sorts them */
+	std::vector< Imath::V3f, TrackedAllocator<Imath::V3f, IndexMemory> > m_added;
+
+	/*! Cell key, coordinates and order added of each point, sorted by key */
+	std::vector< uint64_t, TrackedAllocator<uint64_t, IndexMemory> > m_keys;
+	std::vector< float, TrackedAllocator<float, IndexMemory> > m_x, m_y, m_z;
+	std::vector< unsigned int, TrackedAllocator<unsigned int, IndexMemory> > m_index;
+
+	/*! Scratch list used by Build, kept between builds to avoid reallocating */
+	std::vector< std::pair<uint64_t, unsigned int>, TrackedAllocator<std::pair<uint64_t, unsigned int>, IndexMemory> > m_order;
+};
+
+}; // Flock
+
+#endif
@@ -0,0 +1,360 @@
+#include "SceneGenerator.h"
+
+#include "World.h"
+#include "Flock.h"
+#include "Object.h"
+#include "Boid.h"
+#include "BoidFile.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <math.h>
+
+#include <ImathRandom.h>
+
+/*!
+\file SceneGenerator.cpp
+\brief contains methods for the scene generator class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+/*! Behaviour settings given to every generated flock of a particular kind */
+struct Profile
+{
+	float maxVel, minVel, maxAcc;
+
+	/*! scale and max pairs for each behaviour */
+	float collisionAvoidance[2];
+	float velocityMatching[2];
+	float goalFC[2];
+	float localFC[2];
+	float globalFC[2];
+	float objectAvoidance[2];
+	float hunt[2];
+	float flee[2];
+
+	float boidTR, objectTR, fleeTR;
+
+	unsigned int bankingDepth;
+	float bankingScale;
+};
+
+/*! Prey flocks behave like the flock in basicConfig, with fleeing added */
+const Profile s_preyProfile =
+{
+	6.0f, 1.0f, 4.0f,
+	{ 50.0f, 50.0f }, { 1.0f, 10.0f }, { 50.0f, 100.0f }, { 10.0f, 0.0f }, { 10.0f, 0.0f },
+	{ 130.0f, 120.0f }, { 0.0f, 0.0f }, { 100.0f, 10.0f },
+	5.0f, 6.0f, 10.0f,
+	20, 5.0f
+};
+
+/*! Predator flocks behave like the hunters in predConfig */
+const Profile s_predatorProfile =
+{
+	10.0f, 3.0f, 20.0f,
+	{ 30.0f, 30.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f },
+	{ 130.0f, 120.0f }, { 100.0f, 100.0f }, { 10.0f, 10.0f },
+	5.0f, 10.0f, 10.0f,
+	3, 2.0f
+};
+
+void ApplyProfile(const Profile& profile, Flock& flock)
+{
+	Flock::Behaviour& behaviour = flock.behaviour();
+
+	behaviour.maxVel = profile.maxVel;
+	behaviour.minVel = profile.minVel;
+	behaviour.maxAcc = profile.maxAcc;
+
+	behaviour.collisionAvoidance = Flock::Property(profile.collisionAvoidance[0], profile.collisionAvoidance[1]);
+	behaviour.velocityMatching = Flock::Property(profile.velocityMatching[0], profile.velocityMatching[1]);
+	behaviour.goalFC = Flock::Property(profile.goalFC[0], profile.goalFC[1]);
+	behaviour.localFC = Flock::Property(profile.localFC[0], profile.localFC[1]);
+	behaviour.globalFC = Flock::Property(profile.globalFC[0], profile.globalFC[1]);
+	behaviour.objectAvoidance = Flock::Property(profile.objectAvoidance[0], profile.objectAvoidance[1]);
+	behaviour.hunt = Flock::Property(profile.hunt[0], profile.hunt[1]);
+	behaviour.flee = Flock::Property(profile.flee[0], profile.flee[1]);
+
+	behaviour.bankingDepth = profile.bankingDepth;
+	behaviour.bankingScale = profile.bankingScale;
+
+	flock.setBoidTestRadius(profile.boidTR);
+	flock.setObjectTestRadius(profile.objectTR);
+	flock.setFleeTestRadius(profile.fleeTR);
+}
+
+void WriteProperty(std::ostream& out, const char* name, const float* property)
+{
+	out << "Scale" << name << " " << property[0] << "\n";
+	out << "Max" << name << " " << property[1] << "\n";
+}
+
+void WriteProfile(const Profile& profile, std::ostream& out)
+{
+	out << "MaxVelocity " << profile.maxVel << "\n";
+	out << "MinVelocity " << profile.minVel << "\n";
+	out << "MaxAcceleration " << profile.maxAcc << "\n\n";
+
+	WriteProperty(out, "CollisionAvoidance", profile.collisionAvoidance);
+	WriteProperty(out, "VelocityMatching", profile.velocityMatching);
+	WriteProperty(out, "GoalCentring", profile.goalFC);
+	WriteProperty(out, "LocalFlockCentring", profile.localFC);
+	WriteProperty(out, "GlobalFlockCentring", profile.globalFC);
+	WriteProperty(out, "ObjectAvoidance", profile.objectAvoidance);
+	WriteProperty(out, "Hunt", profile.hunt);
+	WriteProperty(out, "Flee", profile.flee);
+
+	out << "\nBoidTestRadius " << profile.boidTR << "\n";
+	out << "ObjectTestRadius " << profile.objectTR << "\n";
+	out << "FleeTestRadius " << profile.fleeTR << "\n\n";
+
+	out << "BankingDepth " << profile.bankingDepth << "\n";
+	out << "BankingScale " << profile.bankingScale << "\n";
+}
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Sizes the world so the whole scene has the requested
+*	density, keeping the 2:1:1 shape of the default world.
+*/
+SceneGenerator::SceneGenerator(const Settings& settings)
+ :	m_settings( settings )
+{
+	if(m_settings.seed == 0) { m_settings.seed = 1; }
+	if(m_settings.foodChainDepth == 0) { m_settings.foodChainDepth = 1; }
+
+	double totalBoids = double(m_settings.numFlocks) * m_settings.boidsPerFlock;
+	double volume = totalBoids / m_settings.density;
+
+	// (4h)(2h)(2h) = 16h^3. Never smaller than the ground clearance used by Flock::Contain
+	float half = std::max(10.0, cbrt(volume / 16.0));
+
+	m_halfX = 2.0f * half;
+	m_halfY = half;
+	m_halfZ = half;
+}
+
+
+/* LayoutFlock:
+*  ------------
+*	Ranks are dealt out in turn so every level of the food
+*	chain has a similar number of flocks. Each flock is
+*	placed wholly inside the world where possible.
+*/
+SceneGenerator::FlockLayout SceneGenerator::LayoutFlock(unsigned int index) const
+{
+	Imath::Rand48 rand(m_settings.seed * 7919 + index);
+
+	FlockLayout layout;
+
+	if(m_settings.spread > 0.0f)
+		layout.spread = m_settings.spread;
+	else
+		layout.spread = cbrt(m_settings.boidsPerFlock / m_settings.density);
+	layout.rank = index % m_settings.foodChainDepth;
+
+	double rangeX = std::max(0.0, m_halfX - layout.spread/2);
+	double rangeY = std::max(0.0, m_halfY - layout.spread/2 - 2.5);
+	double rangeZ = std::max(0.0, m_halfZ - layout.spread/2);
+
+	// Keep clear of the ground, where Flock::Contain pushes boids upwards
+	layout.x = rand.nextf(-rangeX, rangeX);
+	layout.y = 2.5 + rand.nextf(-rangeY, rangeY);
+	layout.z = rand.nextf(-rangeZ, rangeZ);
+
+	// Prey are blue and predators get redder up the food chain
+	float heat = 0.0f;
+	if(m_settings.foodChainDepth > 1)
+		heat = float(layout.rank) / (m_settings.foodChainDepth - 1);
+
+	layout.colour[0] = heat;
+	layout.colour[1] = rand.nextf(0.2, 1.0);
+	layout.colour[2] = 1.0f - heat;
+	layout.colour[3] = 1.0f;
+
+	return layout;
+}
+
+
+/* LayoutObject:
+*  -------------
+*	Objects are scattered uniformly through the world.
+*/
+void SceneGenerator::LayoutObject(unsigned int index, float& x, float& y, float& z) const
+{
+	Imath::Rand48 rand(m_settings.seed * 104729 + index);
+
+	x = rand.nextf(-m_halfX, m_halfX);
+	y = rand.nextf(-m_halfY + 5.0, m_halfY);
+	z = rand.nextf(-m_halfZ, m_halfZ);
+}
+
+
+/* LayoutMovingObject:
+*  -------------------
+*	Moving objects start anywhere an object could and head
+*	off in a uniformly random direction.
+*/
+void SceneGenerator::LayoutMovingObject(unsigned int index, Imath::V3f& pos, Imath::V3f& vel) const
+{
+	Imath::Rand48 rand(m_settings.seed * 130363 + index);
+
+	pos.x = rand.nextf(-m_halfX, m_halfX);
+	pos.y = rand.nextf(-m_halfY + 5.0, m_halfY);
+	pos.z = rand.nextf(-m_halfZ, m_halfZ);
+
+	// A height and an angle around the vertical are uniform over the sphere of directions
+	float height = rand.nextf(-1.0, 1.0);
+	float angle = rand.nextf(0.0, 2.0 * M_PI);
+	float across = sqrt(1.0f - height * height);
+
+	vel = Imath::V3f(across * cos(angle), height, across * sin(angle)) * m_settings.movingSpeed;
+}
+
+
+/* Generate:
+*  ---------
+*	Builds the scene directly into the world.
+*/
+void SceneGenerator::Generate(World& world) const
+{
+	world.Clear();
+
+	world.maxX = m_halfX;
+	world.minX = -m_halfX;
+	world.maxY = m_halfY;
+	world.minY = -m_halfY;
+	world.maxZ = m_halfZ;
+	world.minZ = -m_halfZ;
+
+	world.seed = m_settings.seed;
+
+	for(unsigned int o=0; o < m_settings.numObjects; ++o)
+	{
+		float x, y, z;
+		LayoutObject(o, x, y, z);
+		world.AddObject(new Object(world, x, y, z));
+	}
+
+	for(unsigned int o=0; o < m_settings.numMovingObjects; ++o)
+	{
+		Imath::V3f pos, vel;
+		LayoutMovingObject(o, pos, vel);
+		world.movingObjects.Add(pos, vel);
+	}
+
+	for(unsigned int f=0; f < m_settings.numFlocks; ++f)
+	{
+		FlockLayout layout = LayoutFlock(f);
+
+		Flock* newFlock = new Flock(f + 1, world);
+
+		newFlock->setRank(layout.rank);
+		newFlock->setColour(Imath::Color4<float>(layout.colour[0], layout.colour[1], layout.colour[2], layout.colour[3]));
+		ApplyProfile(layout.rank == 0 ? s_preyProfile : s_predatorProfile, *newFlock);
+
+		newFlock->CreateBoids(m_settings.boidsPerFlock, layout.x, layout.y, layout.z, layout.spread);
+
+		world.AddFlock(newFlock);
+	}
+}
+
+
+/* Write:
+*  ------
+*	Writes the same scene as Generate in the config format.
+*	Boid files hold the states CreateBoids would give, so
+*	the scene is the same whichever way the flocks start.
+*	Positions are written with enough digits to read back
+*	exactly.
+*/
+bool SceneGenerator::Write(std::ostream& out, const std::string& boidFilePrefix) const
+{
+	out << "// Generated scene: " << m_settings.numFlocks << " flocks of " << m_settings.boidsPerFlock
+		<< " boids, food chain depth " << m_settings.foodChainDepth << ", " << m_settings.numObjects
+		<< " objects, " << m_settings.numMovingObjects << " moving objects, density " << m_settings.density << ", seed " << m_settings.seed << "\n\n";
+
+	std::streamsize oldPrecision = out.precision(9);
+
+	out << "CreateWorld " << m_halfX << " " << -m_halfX << " " << m_halfY << " " << -m_halfY
+		<< " " << m_halfZ << " " << -m_halfZ << "\n";
+	out << "WorldSeed " << m_settings.seed << "\n\n";
+
+	for(unsigned int o=0; o < m_settings.numObjects; ++o)
+	{
+		float x, y, z;
+		LayoutObject(o, x, y, z);
+		out << "StartObject " << x << " " << y << " " << z << "\nEndObject\n";
+	}
+
+	for(unsigned int o=0; o < m_settings.numMovingObjects; ++o)
+	{
+		Imath::V3f pos, vel;
+		LayoutMovingObject(o, pos, vel);
+		out << "MovingObject " << pos.x << " " << pos.y << " " << pos.z << " "
+			<< vel.x << " " << vel.y << " " << vel.z << "\n";
+	}
+
+	out << "\nBeginFlocks\n\n";
+
+	bool written = true;
+
+	for(unsigned int f=0; f < m_settings.numFlocks; ++f)
+	{
+		FlockLayout layout = LayoutFlock(f);
+
+		if(boidFilePrefix.empty())
+		{
+			out << std::setprecision(17) << "StartFlock " << m_settings.boidsPerFlock << " " << layout.x << " "
+				<< layout.y << " " << layout.z << " " << layout.spread << "\n\n" << std::setprecision(9);
+		}
+		else
+		{
+			std::ostringstream filename;
+			filename << boidFilePrefix << f + 1 << ".boids";
+
+			BoidFileWriter writer;
+
+			if(!writer.Open(filename.str())) { written = false; }
+
+			for(unsigned int b=0; b < m_settings.boidsPerFlock; ++b)
+			{
+				Boid boid(b, f + 1, layout.x, layout.y, layout.z, layout.spread, m_settings.seed);
+				writer.Add(boid.pos(), boid.vel());
+			}
+
+			if(!writer.Close()) { written = false; }
+
+			out << "StartFlockFile " << filename.str() << "\n\n";
+		}
+
+		out << "FlockColour " << layout.colour[0] << " " << layout.colour[1] << " "
+			<< layout.colour[2] << " " << layout.colour[3] << "\n\n";
+
+		out << "FoodChain " << layout.rank << "\n\n";
+
+		WriteProfile(layout.rank == 0 ? s_preyProfile : s_predatorProfile, out);
+
+		out << "\nEndFlock\n\n";
+	}
+
+	out << "EndFlocks\n";
+
+	out.precision(oldPrecision);
+
+	return written;
+}
+
+} // Flock
@@ -0,0 +1,117 @@
+#ifndef __SCENEGENERATOR_H__
+#define __SCENEGENERATOR_H__
+
+#include <ImathVec.h>
+
+#include <iosfwd>
+#include <string>
+
+/*!
+\file SceneGenerator.h
+\brief creates large, reproducible scenes for scaling tests
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+
+class SceneGenerator
+{
+public:
+
+	struct Settings
+	{
+		Settings()
+		 :	seed( 1 ),
+			numFlocks( 1 ),
+			boidsPerFlock( 1000 ),
+			foodChainDepth( 1 ),
+			numObjects( 0 ),
+			numMovingObjects( 0 ),
+			movingSpeed( 0.2f ),
+			density( 0.05f ),
+			spread( 0.0f )
+		{
+
+		}
+
+		/*! Seed for every random choice in the scene, including the boids' initial states. Must be non-zero */
+		unsigned long seed;
+
+		/*! Number of flocks to create */
+		unsigned int numFlocks;
+
+		/*! Number of boids in each flock */
+		unsigned int boidsPerFlock;
+
+		/*! Number of ranks in the food chain. Flocks are dealt out across the ranks in turn,
+			so a depth of one gives no predators */
+		unsigned int foodChainDepth;
+
+		/*! Number of spherical objects scattered through the world */
+		unsigned int numObjects;
+
+		/*! Number of moving spherical objects scattered through the world, each heading in its own direction */
+		unsigned int numMovingObjects;
+
+		/*! Distance each moving object travels per frame */
+		float movingSpeed;
+
+		/*! Boids per unit volume. Sets both the size of the world and the spread of each flock */
+		float density;
+
+		/*! Spread of each flock around its start position, as given to StartFlock. 
+			Zero picks the spread that matches the density */
+		float spread;
+	};
+
+	/*! \brief this constructor method creates a generator for the given settings
+		\param settings - the size and shape of the scene to generate */
+	SceneGenerator(const Settings& settings);
+
+	/*! \brief method used to build the scene directly into a world. Any existing flocks and
+		objects are deleted first
+		\param world - the world to fill in */
+	void Generate(World& world) const;
+
+	/*! \brief method used to write the scene as a config file that SceneLoader reads back
+		into exactly the same world as Generate builds
+		\param out - the stream to write the config to
+		\param boidFilePrefix - if not empty, each flock's boids are written to a boid file
+		named from the prefix and the flock ID, and the config loads them from it
+		\return false if a boid file could not be written */
+	bool Write(std::ostream& out, const std::string& boidFilePrefix = std::string()) const;
+
+private:
+
+	/*! Description of a generated flock, shared by Generate and Write */
+	struct FlockLayout
+	{
+		double x, y, z;
+		double spread;
+		int rank;
+		float colour[4];
+	};
+
+	/*! \brief method to make the random choices for flock number 'index'. Each flock draws
+		from its own generator so flocks can be laid out independently */
+	FlockLayout LayoutFlock(unsigned int index) const;
+
+	/*! \brief method to choose the position of object number 'index' */
+	void LayoutObject(unsigned int index, float& x, float& y, float& z) const;
+
+	/*! \brief method to choose the position and velocity of moving object number 'index' */
+	void LayoutMovingObject(unsigned int index, Imath::V3f& pos, Imath::V3f& vel) const;
+
+	Settings m_settings;
+
+	/*! Half extents of the world box, sized from the total boid count and density */
+	float m_halfX, m_halfY, m_halfZ;
+};
+
+}; // Flock
+
+#endif
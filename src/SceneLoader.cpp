@@ -0,0 +1,893 @@
+#include "SceneLoader.h"
+
+#include "World.h"
+#include "Flock.h"
+#include "Object.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*!
+\file SceneLoader.cpp
+\brief contains methods for the scene loader class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+/*! Name and number of values for each keyword, in the order of SceneLoader::Keyword */
+struct KeywordInfo
+{
+	const char* name;
+	unsigned int numArgs;
+};
+
+const KeywordInfo s_keywords[ SceneLoader::NumKeywords ] =
+{
+	{ "BeginFlocks", 0 },
+	{ "EndFlocks", 0 },
+	{ "StartFlock", 5 },
+	{ "EndFlock", 0 },
+	{ "FlockColour", 4 },
+	{ "FoodChain", 1 },
+	{ "BankingDepth", 1 },
+	{ "BankingScale", 1 },
+	{ "MaxHunt", 1 },
+	{ "ScaleHunt", 1 },
+	{ "MaxFlee", 1 },
+	{ "ScaleFlee", 1 },
+	{ "FleeTestRadius", 1 },
+	{ "MaxVelocity", 1 },
+	{ "MinVelocity", 1 },
+	{ "MaxAcceleration", 1 },
+	{ "MaxCollisionAvoidance", 1 },
+	{ "ScaleCollisionAvoidance", 1 },
+	{ "MaxVelocityMatching", 1 },
+	{ "ScaleVelocityMatching", 1 },
+	{ "MaxGoalCentring", 1 },
+	{ "ScaleGoalCentring", 1 },
+	{ "MaxLocalFlockCentring", 1 },
+	{ "ScaleLocalFlockCentring", 1 },
+	{ "MaxGlobalFlockCentring", 1 },
+	{ "ScaleGlobalFlockCentring", 1 },
+	{ "MaxObjectAvoidance", 1 },
+	{ "ScaleObjectAvoidance", 1 },
+	{ "BoidTestRadius", 1 },
+	{ "ObjectTestRadius", 1 },
+	{ "ObjectAvoidanceMode", 1 },
+	{ "StartObject", 3 },
+	{ "EndObject", 0 },
+	{ "CreateWorld", 6 },
+	{ "WorldSeed", 1 },
+	{ "ObjectFieldCellSize", 1 },
+	{ "TimeStep", 1 },
+	{ "SubSteps", 1 },
+	{ "Integrator", 1 },
+	{ "LevelOfDetail", 5 },
+	{ "LevelOfDetailIntervals", 3 },
+	{ "Sleeping", 3 },
+	{ "BatchIntegration", 1 },
+	{ "MortonSort", 1 },
+	{ "HuntMode", 2 },
+	{ "MovingObject", 6 },
+	{ "MemoryBudget", 1 },
+	{ "StartFlockFile", 0 }
+};
+
+/*! Perfect hash table from keyword text to keyword. The seed is searched
+	for once, on first use, so that no two keywords share a slot. Adding
+	a keyword to the table above needs no other changes. */
+class KeywordTable
+{
+public:
+
+	KeywordTable()
+	{
+		for( m_seed = 1; !Build(); ++m_seed ) {}
+	}
+
+	/*! \brief returns the keyword matching the text, or NumKeywords if there is none */
+	SceneLoader::Keyword Find( const char* begin, const char* end ) const
+	{
+		unsigned char entry = m_slots[ Hash( m_seed, begin, end ) ];
+
+		if( entry == 0 ) { return SceneLoader::NumKeywords; }
+
+		const char* name = s_keywords[ entry - 1 ].name;
+		size_t length = end - begin;
+
+		if( strlen( name ) != length || memcmp( name, begin, length ) != 0 )
+			return SceneLoader::NumKeywords;
+
+		return SceneLoader::Keyword( entry - 1 );
+	}
+
+private:
+
+	static const unsigned int Bits = 7;
+	static const unsigned int Size = 1 << Bits;
+
+	static unsigned int Hash( unsigned int seed, const char* begin, const char* end )
+	{
+		unsigned int hash = 2166136261u ^ seed;
+
+		for( ; begin != end; ++begin )
+		{
+			hash ^= (unsigned char)(*begin);
+			hash *= 16777619u;
+		}
+
+		return hash >> ( 32 - Bits );
+	}
+
+	bool Build()
+	{
+		memset( m_slots, 0, sizeof( m_slots ) );
+
+		for( unsigned int k=0; k < SceneLoader::NumKeywords; ++k )
+		{
+			const char* name = s_keywords[k].name;
+			unsigned int slot = Hash( m_seed, name, name + strlen( name ) );
+
+			if( m_slots[ slot ] != 0 ) { return false; }
+
+			m_slots[ slot ] = k + 1;
+		}
+
+		return true;
+	}
+
+	unsigned int m_seed;
+
+	/*! Keyword index plus one for each slot, zero for empty slots */
+	unsigned char m_slots[ Size ];
+};
+
+const KeywordTable& Keywords()
+{
+	static KeywordTable table;
+	return table;
+}
+
+inline bool IsSpace( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* ParseNumber:
+*  ------------
+*	Parses a decimal number from [begin, end) without copying.
+*	Short numbers, which is everything in a hand-written config,
+*	are exact in a double so give the same result as atof. Anything
+*	longer is copied out and handed to strtod.
+*/
+bool ParseNumber( const char* begin, const char* end, double& value )
+{
+	const char* current = begin;
+	bool negative = false;
+
+	if( current != end && ( *current == '-' || *current == '+' ) )
+	{
+		negative = ( *current == '-' );
+		++current;
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+
+	for( ; current != end && *current >= '0' && *current <= '9'; ++current, ++digits )
+		mantissa = mantissa * 10 + ( *current - '0' );
+
+	if( current != end && *current == '.' )
+	{
+		for( ++current; current != end && *current >= '0' && *current <= '9'; ++current, ++digits )
+		{
+			mantissa = mantissa * 10 + ( *current - '0' );
+			--exponent;
+		}
+	}
+
+	if( digits == 0 ) { return false; }
+
+	if( current == end && digits <= 15 && exponent >= -22 )
+	{
+		static const double s_powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+		value = double( mantissa ) / s_powers[ -exponent ];
+		if( negative ) { value = -value; }
+		return true;
+	}
+
+	// Exponents and very long numbers fall back to the library
+	char buffer[64];
+	size_t length = end - begin;
+	if( length >= sizeof( buffer ) ) { return false; }
+
+	memcpy( buffer, begin, length );
+	buffer[ length ] = '\0';
+
+	char* parsedEnd = NULL;
+	value = strtod( buffer, &parsedEnd );
+
+	return parsedEnd == buffer + length;
+}
+
+/*! \brief returns true for keywords that set up the world rather than a flock. ReloadBehaviour skips them */
+bool IsWorldKeyword(SceneLoader::Keyword keyword)
+{
+	switch(keyword)
+	{
+		case SceneLoader::StartObject:
+		case SceneLoader::EndObject:
+		case SceneLoader::MovingObject:
+		case SceneLoader::CreateWorld:
+		case SceneLoader::WorldSeed:
+		case SceneLoader::ObjectFieldCellSize:
+		case SceneLoader::TimeStep:
+		case SceneLoader::SubSteps:
+		case SceneLoader::Integrator:
+		case SceneLoader::LevelOfDetail:
+		case SceneLoader::LevelOfDetailIntervals:
+		case SceneLoader::Sleeping:
+		case SceneLoader::BatchIntegration:
+		case SceneLoader::MortonSort:
+		case SceneLoader::MemoryBudget:
+		return true;
+
+		default:
+		return false;
+	}
+}
+
+/*! \brief prints a behaviour setting that a reload changes, under the keyword that sets it */
+void ReportChange(int flockID, SceneLoader::Keyword keyword, double from, double to, unsigned int& changes)
+{
+	if(from == to) { return; }
+
+	std::cout << "Flock " << flockID << ": " << s_keywords[keyword].name << " " << from << " -> " << to << std::endl;
+	++changes;
+}
+
+/*! \brief prints each setting that differs between two behaviours
+	\return the number of settings that differ */
+unsigned int ReportChanges(int flockID, const Flock::Behaviour& from, const Flock::Behaviour& to)
+{
+	unsigned int changes = 0;
+
+	ReportChange(flockID, SceneLoader::BankingDepth, from.bankingDepth, to.bankingDepth, changes);
+	ReportChange(flockID, SceneLoader::BankingScale, from.bankingScale, to.bankingScale, changes);
+	ReportChange(flockID, SceneLoader::MaxHunt, from.hunt.max, to.hunt.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleHunt, from.hunt.scale, to.hunt.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxFlee, from.flee.max, to.flee.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleFlee, from.flee.scale, to.flee.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxVelocity, from.maxVel, to.maxVel, changes);
+	ReportChange(flockID, SceneLoader::MinVelocity, from.minVel, to.minVel, changes);
+	ReportChange(flockID, SceneLoader::MaxAcceleration, from.maxAcc, to.maxAcc, changes);
+	ReportChange(flockID, SceneLoader::MaxCollisionAvoidance, from.collisionAvoidance.max, to.collisionAvoidance.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleCollisionAvoidance, from.collisionAvoidance.scale, to.collisionAvoidance.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxVelocityMatching, from.velocityMatching.max, to.velocityMatching.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleVelocityMatching, from.velocityMatching.scale, to.velocityMatching.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxGoalCentring, from.goalFC.max, to.goalFC.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleGoalCentring, from.goalFC.scale, to.goalFC.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxLocalFlockCentring, from.localFC.max, to.localFC.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleLocalFlockCentring, from.localFC.scale, to.localFC.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxGlobalFlockCentring, from.globalFC.max, to.globalFC.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleGlobalFlockCentring, from.globalFC.scale, to.globalFC.scale, changes);
+	ReportChange(flockID, SceneLoader::MaxObjectAvoidance, from.objectAvoidance.max, to.objectAvoidance.max, changes);
+	ReportChange(flockID, SceneLoader::ScaleObjectAvoidance, from.objectAvoidance.scale, to.objectAvoidance.scale, changes);
+	ReportChange(flockID, SceneLoader::ObjectAvoidanceMode, from.objectAvoidanceMode, to.objectAvoidanceMode, changes);
+
+	// Both values of HuntMode are reported together
+	if(from.huntMode != to.huntMode || from.huntHold != to.huntHold)
+	{
+		std::cout << "Flock " << flockID << ": " << s_keywords[SceneLoader::HuntMode].name << " " << from.huntMode << " "
+			<< from.huntHold << " -> " << to.huntMode << " " << to.huntHold << std::endl;
+		++changes;
+	}
+
+	return changes;
+}
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Flock IDs start at 1 as they always have.
+*/
+SceneLoader::SceneLoader(World& theContainer)
+ :	m_container( theContainer ),
+	m_flock( NULL ),
+	m_nextFlockID( 1 ),
+	m_reloading( false ),
+	m_errors( 0 ),
+	m_warnings( 0 )
+{
+
+}
+
+
+/* Load:
+*  -----
+*	Maps the file read-only and parses it where it lies.
+*/
+bool SceneLoader::Load(const std::string& filename)
+{
+	int file = open(filename.c_str(), O_RDONLY);
+
+	if(file < 0)
+	{
+		std::cout << "File Not Found: " << filename << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if(fstat(file, &info) != 0)
+	{
+		close(file);
+		std::cout << "Unable to read " << filename << std::endl;
+		return false;
+	}
+
+	size_t size = info.st_size;
+
+	if(size == 0)
+	{
+		close(file);
+		return Parse(NULL, 0, filename);
+	}
+
+	void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if(data == MAP_FAILED)
+	{
+		std::cout << "Unable to map " << filename << std::endl;
+		return false;
+	}
+
+	bool result = Parse(static_cast<const char*>(data), size, filename);
+
+	munmap(data, size);
+
+	return result;
+}
+
+
+/* ReloadBehaviour:
+*  ----------------
+*	Parses the config into flocks of its own, then copies
+*	their behaviour and test radii to the world's flocks in one
+*	go once the whole file has been read without errors. Flocks
+*	the config no longer has are left alone.
+*/
+bool SceneLoader::ReloadBehaviour(const std::string& filename)
+{
+	m_reloading = true;
+	m_nextFlockID = 1;
+
+	bool loaded = Load(filename);
+
+	m_reloading = false;
+
+	if(loaded)
+	{
+		unsigned int changes = 0;
+		bool fieldStale = false;
+
+		for(unsigned int s=0; s < m_staged.size(); ++s)
+		{
+			Flock* flock = NULL;
+
+			for(unsigned int f=0; f < m_container.flocks.size() && !flock; ++f)
+			{
+				if(m_container.flocks[f]->id() == m_staged[s]->id()) { flock = m_container.flocks[f]; }
+			}
+
+			if(!flock)
+			{
+				std::cout << filename << ": Flock " << m_staged[s]->id() << " is not in the world, its settings are ignored" << std::endl;
+				++m_warnings;
+				continue;
+			}
+
+			const Flock* staged = m_staged[s];
+
+			changes += ReportChanges(flock->id(), flock->behaviour(), staged->behaviour());
+
+			ReportChange(flock->id(), BoidTestRadius, flock->boidTestRadius(), staged->boidTestRadius(), changes);
+			ReportChange(flock->id(), ObjectTestRadius, flock->objectTestRadius(), staged->objectTestRadius(), changes);
+			ReportChange(flock->id(), FleeTestRadius, flock->fleeTestRadius(), staged->fleeTestRadius(), changes);
+
+			if(flock->behaviour().objectAvoidanceMode != staged->behaviour().objectAvoidanceMode
+				|| flock->objectTestRadius() != staged->objectTestRadius()) { fieldStale = true; }
+
+			flock->behaviour() = staged->behaviour();
+			flock->setBoidTestRadius(staged->boidTestRadius());
+			flock->setObjectTestRadius(staged->objectTestRadius());
+			flock->setFleeTestRadius(staged->fleeTestRadius());
+
+			// The colour and the food chain are set up with the boids, so they are left as they are
+			if(flock->colour() != staged->colour())
+			{
+				std::cout << filename << ": Flock " << flock->id() << ": " << s_keywords[FlockColour].name
+					<< " needs a full reload to change" << std::endl;
+				++m_warnings;
+			}
+
+			if(flock->rank() != staged->rank())
+			{
+				std::cout << filename << ": Flock " << flock->id() << ": " << s_keywords[FoodChain].name
+					<< " needs a full reload to change" << std::endl;
+				++m_warnings;
+			}
+		}
+
+		// The distance field is only baked for the flocks using it, and only as far as they look,
+		// so it is baked again on the next update for the flocks that use it now
+		if(fieldStale) { m_container.objectField.Clear(); }
+
+		std::cout << filename << ": " << changes << " behaviour settings changed" << std::endl;
+	}
+	else
+	{
+		std::cout << filename << ": Behaviour left unchanged" << std::endl;
+	}
+
+	for(unsigned int s=0; s < m_staged.size(); ++s)
+	{
+		delete m_staged[s];
+	}
+	m_staged.clear();
+
+	return loaded;
+}
+
+
+/* Parse:
+*  ------
+*	Walks the buffer a line at a time. Each line is split into
+*	a keyword and its values in place, with no copies made,
+*	and the keyword is found with a single table lookup.
+*/
+bool SceneLoader::Parse(const char* data, size_t size, const std::string& name)
+{
+	m_name = name;
+	m_errors = 0;
+	m_warnings = 0;
+
+	const KeywordTable& keywords = Keywords();
+
+	const char* current = data;
+	const char* end = data + size;
+
+	unsigned int line = 0;
+
+	double args[ MaxArgs ];
+
+	while(current < end)
+	{
+		++line;
+
+		const char* lineEnd = static_cast<const char*>(memchr(current, '\n', end - current));
+		if(!lineEnd) { lineEnd = end; }
+
+		// Skip leading white space
+		while(current != lineEnd && IsSpace(*current)) { ++current; }
+
+		const char* token = current;
+		while(current != lineEnd && !IsSpace(*current)) { ++current; }
+
+		// Ignore blank lines and comments
+		if(token == current || (current - token >= 2 && token[0] == '/' && token[1] == '/'))
+		{
+			current = lineEnd + 1;
+			continue;
+		}
+
+		Keyword keyword = keywords.Find(token, current);
+
+		if(keyword == NumKeywords)
+		{
+			std::cout << m_name << ":" << line << ": Unknown token ";
+			std::cout.write(token, current - token);
+			std::cout << std::endl;
+			++m_warnings;
+
+			current = lineEnd + 1;
+			continue;
+		}
+
+		// The rest of the line is a path, which may hold spaces
+		if(keyword == StartFlockFile)
+		{
+			while(current != lineEnd && IsSpace(*current)) { ++current; }
+
+			const char* pathEnd = lineEnd;
+			while(pathEnd != current && IsSpace(pathEnd[-1])) { --pathEnd; }
+
+			StartFlockFromFile(std::string(current, pathEnd), line);
+
+			current = lineEnd + 1;
+			continue;
+		}
+
+		unsigned int numArgs = 0;
+		bool valid = true;
+
+		while(current != lineEnd)
+		{
+			while(current != lineEnd && IsSpace(*current)) { ++current; }
+			if(current == lineEnd) { break; }
+
+			const char* value = current;
+			while(current != lineEnd && !IsSpace(*current)) { ++current; }
+
+			// Allow trailing comments
+			if(current - value >= 2 && value[0] == '/' && value[1] == '/') { break; }
+
+			if(numArgs == s_keywords[keyword].numArgs)
+			{
+				std::cout << m_name << ":" << line << ": Ignoring extra values after "
+					<< s_keywords[keyword].name << std::endl;
+				++m_warnings;
+				break;
+			}
+
+			if(!ParseNumber(value, current, args[numArgs]))
+			{
+				Error(line, "Value is not a number");
+				valid = false;
+				break;
+			}
+
+			++numArgs;
+		}
+
+		if(valid && numArgs < s_keywords[keyword].numArgs)
+		{
+			std::cout << m_name << ":" << line << ": Error: " << s_keywords[keyword].name
+				<< " expects " << s_keywords[keyword].numArgs << " values" << std::endl;
+			++m_errors;
+			valid = false;
+		}
+
+		if(valid)
+		{
+			Apply(keyword, args, line);
+		}
+
+		current = lineEnd + 1;
+	}
+
+	if(m_flock)
+	{
+		Error(line, "Missing EndFlock");
+		m_flock = NULL;
+	}
+
+	return m_errors == 0;
+}
+
+
+/* StartFlockFromFile:
+*  -------------------
+*	Like StartFlock, but the boids come from a boid file. A
+*	file that can't be read leaves no flock, so the settings
+*	up to EndFlock are reported as being outside one.
+*/
+void SceneLoader::StartFlockFromFile(const std::string& path, unsigned int line)
+{
+	if(m_flock)
+	{
+		Error(line, "StartFlockFile found before EndFlock");
+		++m_nextFlockID;
+	}
+
+	m_flock = NULL;
+
+	if(path.empty())
+	{
+		Error(line, "StartFlockFile expects the path of a boid file");
+		return;
+	}
+
+	if(m_reloading)
+	{
+		m_flock = new Flock(m_nextFlockID, m_container);
+		m_staged.push_back(m_flock);
+		return;
+	}
+
+	Flock* flock = new Flock(m_nextFlockID, m_container);
+
+	if(!flock->LoadBoids(path) || flock->boids().empty())
+	{
+		Error(line, "Unable to load a flock from the boid file");
+		delete flock;
+		return;
+	}
+
+	m_flock = flock;
+	m_container.AddFlock(m_flock);
+}
+
+
+/* Apply:
+*  ------
+*	Carries out a single keyword. Flock settings are written
+*	straight into the behaviour of the flock being built.
+*/
+void SceneLoader::Apply(Keyword keyword, const double* args, unsigned int line)
+{
+	if(m_reloading && IsWorldKeyword(keyword)) { return; }
+
+	switch(keyword)
+	{
+		case BeginFlocks:
+		case EndFlocks:
+		case EndObject:
+		return;
+
+		case StartFlock:
+			if(m_flock)
+			{
+				Error(line, "StartFlock found before EndFlock");
+				++m_nextFlockID;
+			}
+
+			if(int(args[0]) <= 0)
+			{
+				Error(line, "Flock of zero size has been specified. Please specify a non-zero size.");
+				m_flock = NULL;
+				return;
+			}
+
+			m_flock = new Flock(m_nextFlockID, m_container);
+
+			if(m_reloading)
+			{
+				m_staged.push_back(m_flock);
+				return;
+			}
+
+			m_flock->CreateBoids(int(args[0]), args[1], args[2], args[3], args[4]);
+			m_container.AddFlock(m_flock);
+		return;
+
+		case EndFlock:
+			if(!m_flock) { Error(line, "EndFlock found without StartFlock"); }
+			m_flock = NULL;
+			++m_nextFlockID;
+		return;
+
+		case StartObject:
+			m_container.AddObject(new Object(m_container, args[0], args[1], args[2]));
+		return;
+
+		case MovingObject:
+			// Position then the distance moved each frame
+			m_container.movingObjects.Add(Imath::V3f(args[0], args[1], args[2]), Imath::V3f(args[3], args[4], args[5]));
+		return;
+
+		case CreateWorld:
+			m_container.maxX = args[0];
+			m_container.minX = args[1];
+			m_container.maxY = args[2];
+			m_container.minY = args[3];
+			m_container.maxZ = args[4];
+			m_container.minZ = args[5];
+		return;
+
+		case WorldSeed:
+			// Only affects flocks started after this line
+			m_container.seed = (unsigned long)args[0];
+		return;
+
+		case ObjectFieldCellSize:
+			if(args[0] <= 0.0)
+			{
+				Error(line, "ObjectFieldCellSize must be greater than zero");
+				return;
+			}
+			m_container.objectFieldCellSize = args[0];
+		return;
+
+		case TimeStep:
+			if(args[0] <= 0.0)
+			{
+				Error(line, "TimeStep must be greater than zero");
+				return;
+			}
+			m_container.timeStep = args[0];
+		return;
+
+		case SubSteps:
+			if(args[0] < 1.0)
+			{
+				Error(line, "SubSteps must be at least 1");
+				return;
+			}
+			m_container.subSteps = (unsigned int)args[0];
+		return;
+
+		case Integrator:
+			// 0 is semi-implicit Euler, 1 is velocity Verlet
+			if(args[0] == 0.0)
+				m_container.integrator = World::SemiImplicitEuler;
+			else if(args[0] == 1.0)
+				m_container.integrator = World::VelocityVerlet;
+			else
+				Error(line, "Integrator must be 0 (semi-implicit Euler) or 1 (velocity Verlet)");
+		return;
+
+		case LevelOfDetail:
+			// Centre of interest followed by the distances where levels 1 and 2 start
+			if(args[3] < 0.0 || args[4] < args[3])
+			{
+				Error(line, "LevelOfDetail distances must be positive and in increasing order");
+				return;
+			}
+			m_container.lod.enabled = true;
+			m_container.lod.centre.setValue(args[0], args[1], args[2]);
+			m_container.lod.distance[0] = args[3];
+			m_container.lod.distance[1] = args[4];
+		return;
+
+		case LevelOfDetailIntervals:
+			// Steps between behaviour runs at levels 1 and 2, and level 2 runs between neighbour searches
+			if(args[0] < 1.0 || args[1] < 1.0 || args[2] < 1.0)
+			{
+				Error(line, "LevelOfDetailIntervals must all be at least 1");
+				return;
+			}
+			m_container.lod.interval[0] = (unsigned int)args[0];
+			m_container.lod.interval[1] = (unsigned int)args[1];
+			m_container.lod.neighbourRefresh = (unsigned int)args[2];
+		return;
+
+		case Sleeping:
+			// Acceleration threshold, quiet steps before sleeping and steps between checks
+			if(args[0] < 0.0 || args[1] < 1.0 || args[2] < 1.0)
+			{
+				Error(line, "Sleeping needs a positive threshold and step counts of at least 1");
+				return;
+			}
+			m_container.sleeping.enabled = true;
+			m_container.sleeping.threshold = args[0];
+			m_container.sleeping.settleSteps = (unsigned int)args[1];
+			m_container.sleeping.wakeInterval = (unsigned int)args[2];
+		return;
+
+		case BatchIntegration:
+			// 1 integrates each flock with the vectorised kernel
+			m_container.batchIntegration = (args[0] != 0.0);
+		return;
+
+		case MortonSort:
+			// Steps between reordering the boids along the Morton curve, 0 never reorders
+			if(args[0] < 0.0)
+			{
+				Error(line, "MortonSort needs an interval of 0 or more");
+				return;
+			}
+			m_container.mortonSortInterval = (unsigned int)args[0];
+		return;
+
+		case MemoryBudget:
+			// Megabytes held before a warning is printed, 0 never warns
+			if(args[0] < 0.0)
+			{
+				Error(line, "MemoryBudget needs a size in megabytes of 0 or more");
+				return;
+			}
+			m_container.memoryBudget = (unsigned long long)(args[0] * 1024.0 * 1024.0);
+		return;
+
+		default:
+		break;
+	}
+
+	// Everything else is a flock setting
+	if(!m_flock)
+	{
+		Error(line, "Flock setting found outside StartFlock/EndFlock");
+		return;
+	}
+
+	Flock::Behaviour& behaviour = m_flock->behaviour();
+
+	switch(keyword)
+	{
+		case FlockColour:
+			m_flock->setColour(Imath::Color4<float>(args[0], args[1], args[2], args[3]));
+		break;
+
+		case FoodChain: m_flock->setRank(int(args[0])); break;
+
+		case BankingDepth: behaviour.bankingDepth = int(args[0]); break;
+		case BankingScale: behaviour.bankingScale = args[0]; break;
+
+		case MaxHunt: behaviour.hunt.max = args[0]; break;
+		case ScaleHunt: behaviour.hunt.scale = args[0]; break;
+
+		case MaxFlee: behaviour.flee.max = args[0]; break;
+		case ScaleFlee: behaviour.flee.scale = args[0]; break;
+		case FleeTestRadius: m_flock->setFleeTestRadius(args[0]); break;
+
+		case MaxVelocity: behaviour.maxVel = args[0]; break;
+		case MinVelocity: behaviour.minVel = args[0]; break;
+		case MaxAcceleration: behaviour.maxAcc = args[0]; break;
+
+		case MaxCollisionAvoidance: behaviour.collisionAvoidance.max = args[0]; break;
+		case ScaleCollisionAvoidance: behaviour.collisionAvoidance.scale = args[0]; break;
+
+		case MaxVelocityMatching: behaviour.velocityMatching.max = args[0]; break;
+		case ScaleVelocityMatching: behaviour.velocityMatching.scale = args[0]; break;
+
+		case MaxGoalCentring: behaviour.goalFC.max = args[0]; break;
+		case ScaleGoalCentring: behaviour.goalFC.scale = args[0]; break;
+
+		case MaxLocalFlockCentring: behaviour.localFC.max = args[0]; break;
+		case ScaleLocalFlockCentring: behaviour.localFC.scale = args[0]; break;
+
+		case MaxGlobalFlockCentring: behaviour.globalFC.max = args[0]; break;
+		case ScaleGlobalFlockCentring: behaviour.globalFC.scale = args[0]; break;
+
+		case MaxObjectAvoidance: behaviour.objectAvoidance.max = args[0]; break;
+		case ScaleObjectAvoidance: behaviour.objectAvoidance.scale = args[0]; break;
+
+		case BoidTestRadius: m_flock->setBoidTestRadius(args[0]); break;
+		case ObjectTestRadius: m_flock->setObjectTestRadius(args[0]); break;
+
+		case ObjectAvoidanceMode:
+			// 0 tests each object, 1 uses the world's distance field
+			if(args[0] == 0.0)
+				behaviour.objectAvoidanceMode = Flock::SphericalAvoidance;
+			else if(args[0] == 1.0)
+				behaviour.objectAvoidanceMode = Flock::DistanceFieldAvoidance;
+			else
+				Error(line, "ObjectAvoidanceMode must be 0 (spherical) or 1 (distance field)");
+		break;
+
+		case HuntMode:
+			// 0 hunts as a flock, 1 boid by boid, followed by the steps each boid keeps its prey
+			if((args[0] != 0.0 && args[0] != 1.0) || args[1] < 0.0)
+			{
+				Error(line, "HuntMode must be 0 (flock) or 1 (boid), followed by a hold of 0 or more steps");
+				break;
+			}
+			behaviour.huntMode = args[0] == 0.0 ? Flock::FlockHunting : Flock::BoidHunting;
+			behaviour.huntHold = (unsigned int)args[1];
+		break;
+
+		default:
+		break;
+	}
+}
+
+
+/* Error:
+*  ------
+*	Reports a problem along with where it was found.
+*/
+void SceneLoader::Error(unsigned int line, const char* message)
+{
+	std::cout << m_name << ":" << line << ": Error: " << message << std::endl;
+	++m_errors;
+}
+
+} // Flock
@@ -0,0 +1,156 @@
+#ifndef __SCENELOADER_H__
+#define __SCENELOADER_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/*!
+\file SceneLoader.h
+\brief reads scene config files straight into a world
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+class Flock;
+
+class SceneLoader
+{
+public:
+
+	/*! \brief this constructor method creates a loader that adds flocks and objects to a world
+		\param theContainer - the reference of the world to fill in */
+	SceneLoader(World& theContainer);
+
+	/*! \brief method used to map a config file into memory and parse it
+		\param filename - the path of the config file
+		\return false if the file could not be read or contained errors */
+	bool Load(const std::string& filename);
+
+	/*! \brief method used to read just the flock behaviour settings from a config and apply
+		them to the flocks already in the world, matched by ID. The world, its objects and the
+		boids are left as they are. Nothing is changed unless the whole config parses, so the
+		flocks never run with half the new settings. Each setting that changes is reported,
+		and a FlockColour or FoodChain that changes is warned about, as it needs a full load
+		\param filename - the path of the config file
+		\return false if the file could not be read or contained errors */
+	bool ReloadBehaviour(const std::string& filename);
+
+	/*! \brief method used to parse a config held in memory. The buffer is not modified
+		and does not need to be null terminated.
+		\param data - the start of the config text
+		\param size - the number of bytes of config text
+		\param name - the name used when reporting problems
+		\return false if the config contained errors */
+	bool Parse(const char* data, size_t size, const std::string& name);
+
+	/*! \brief returns the number of errors found by the last Load or Parse */
+	unsigned int errors() const { return m_errors; };
+
+	/*! \brief returns the number of unknown keywords found by the last Load or Parse */
+	unsigned int warnings() const { return m_warnings; };
+
+	/*! Identifiers for each keyword the config format supports */
+	enum Keyword
+	{
+		BeginFlocks,
+		EndFlocks,
+		StartFlock,
+		EndFlock,
+		FlockColour,
+		FoodChain,
+		BankingDepth,
+		BankingScale,
+		MaxHunt,
+		ScaleHunt,
+		MaxFlee,
+		ScaleFlee,
+		FleeTestRadius,
+		MaxVelocity,
+		MinVelocity,
+		MaxAcceleration,
+		MaxCollisionAvoidance,
+		ScaleCollisionAvoidance,
+		MaxVelocityMatching,
+		ScaleVelocityMatching,
+		MaxGoalCentring,
+		ScaleGoalCentring,
+		MaxLocalFlockCentring,
+		ScaleLocalFlockCentring,
+		MaxGlobalFlockCentring,
+		ScaleGlobalFlockCentring,
+		MaxObjectAvoidance,
+		ScaleObjectAvoidance,
+		BoidTestRadius,
+		ObjectTestRadius,
+		ObjectAvoidanceMode,
+		StartObject,
+		EndObject,
+		CreateWorld,
+		WorldSeed,
+		ObjectFieldCellSize,
+		TimeStep,
+		SubSteps,
+		Integrator,
+		LevelOfDetail,
+		LevelOfDetailIntervals,
+		Sleeping,
+		BatchIntegration,
+		MortonSort,
+		HuntMode,
+		MovingObject,
+		MemoryBudget,
+		StartFlockFile,
+		NumKeywords
+	};
+
+	/*! Maximum number of values following any keyword */
+	static const unsigned int MaxArgs = 6;
+
+private:
+
+	/*! \brief method to apply one line of config once it has been split into values
+		\param keyword - the keyword at the start of the line
+		\param args - the values following the keyword
+		\param line - the line number, used when reporting problems */
+	void Apply(Keyword keyword, const double* args, unsigned int line);
+
+	/*! \brief method to start a flock whose boids are read from a boid file. Handles the
+		StartFlockFile keyword, the only one that takes a path rather than values
+		\param path - the path of the boid file
+		\param line - the line number, used when reporting problems */
+	void StartFlockFromFile(const std::string& path, unsigned int line);
+
+	/*! \brief method to report a problem with a line of the config */
+	void Error(unsigned int line, const char* message);
+
+	/*! World reference to the world being filled in */
+	World& m_container;
+
+	/*! The flock that flock settings are currently applied to. Null outside StartFlock/EndFlock */
+	Flock* m_flock;
+
+	/*! Integer ID given to the next flock created */
+	int m_nextFlockID;
+
+	/*! True while ReloadBehaviour is parsing. Flocks are then made without boids and kept
+		in m_staged instead of being added to the world, and world settings are skipped */
+	bool m_reloading;
+
+	/*! Flocks holding the settings read by ReloadBehaviour, in the order they were started */
+	std::vector<Flock*> m_staged;
+
+	/*! The name of the config being parsed, for reporting problems */
+	std::string m_name;
+
+	unsigned int m_errors;
+	unsigned int m_warnings;
+};
+
+}; // Flock
+
+#endif
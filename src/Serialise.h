@@ -0,0 +1,67 @@
+#ifndef __SERIALISE_H__
+#define __SERIALISE_H__
+
+#include <iostream>
+#include <vector>
+
+/*!
+\file Serialise.h
+\brief helpers for writing raw binary checkpoint data
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+/*! \brief writes the raw bytes of a value to a binary stream. Only used
+	for plain data (floats, ints and Imath vectors) so that the values
+	read back are bit-for-bit identical to those written.
+	\param out - the stream to write to
+	\param value - the value to write */
+template< typename T >
+void Write( std::ostream& out, const T& value )
+{
+	out.write( reinterpret_cast< const char* >( &value ), sizeof( T ) );
+}
+
+/*! \brief reads the raw bytes of a value from a binary stream
+	\param in - the stream to read from
+	\param value - the value to fill in
+	\return false if the stream ran out of data */
+template< typename T >
+bool Read( std::istream& in, T& value )
+{
+	in.read( reinterpret_cast< char* >( &value ), sizeof( T ) );
+	return in.good();
+}
+
+/*! \brief writes the size of an STL vector followed by its contents */
+template< typename T, typename A >
+void WriteVector( std::ostream& out, const std::vector< T, A >& values )
+{
+	unsigned int size = values.size();
+	Write( out, size );
+
+	if( size )
+		out.write( reinterpret_cast< const char* >( &values[0] ), size * sizeof( T ) );
+}
+
+/*! \brief reads a vector written by WriteVector, replacing the current contents */
+template< typename T, typename A >
+bool ReadVector( std::istream& in, std::vector< T, A >& values )
+{
+	unsigned int size = 0;
+	if( !Read( in, size ) ) { return false; }
+
+	values.resize( size );
+
+	if( size )
+		in.read( reinterpret_cast< char* >( &values[0] ), size * sizeof( T ) );
+
+	return in.good();
+}
+
+}; // Flock
+
+#endif
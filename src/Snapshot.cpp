@@ -0,0 +1,307 @@
+#include "Snapshot.h"
+
+#include "World.h"
+#include "Flock.h"
+#include "Boid.h"
+
+#include <iostream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*!
+\file Snapshot.cpp
+\brief contains methods for the snapshot publisher and reader classes
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+/*! Identifies the shared memory and the layout version it was written with */
+static const char s_snapshotMagic[4] = { 'F', 'S', 'N', 'P' };
+static const unsigned int s_snapshotVersion = 1;
+
+namespace {
+
+/* SharedName:
+*  -----------
+*	Shared memory names have to start with a slash.
+*/
+std::string SharedName(const std::string& name)
+{
+	return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+
+/* Slot:
+*  -----
+*	Finds a slot from its index.
+*/
+SnapshotSlot* Slot(SnapshotHeader* header, uint64_t index)
+{
+	return reinterpret_cast<SnapshotSlot*>(reinterpret_cast<char*>(header + 1) + (index % header->numSlots) * header->slotSize);
+}
+
+} // namespace
+
+
+/* Constructor:
+*  ------------
+*	Starts with nothing mapped.
+*/
+SnapshotPublisher::SnapshotPublisher()
+ :	m_header( NULL ),
+	m_size( 0 )
+{
+
+}
+
+
+/* Destructor:
+*  -----------
+*	Removes the shared memory. Readers that still have it
+*	mapped can carry on reading the last frames.
+*/
+SnapshotPublisher::~SnapshotPublisher()
+{
+	Close();
+}
+
+
+/* Open:
+*  -----
+*	Sizes the shared memory for every slot, keeping each slot
+*	on its own cache lines.
+*/
+bool SnapshotPublisher::Open(const std::string& name, unsigned int numSlots, unsigned int capacity)
+{
+	Close();
+
+	if(numSlots == 0)
+	{
+		std::cout << "Error: a snapshot needs at least one slot" << std::endl;
+		return false;
+	}
+
+	uint64_t slotSize = sizeof(SnapshotSlot) + uint64_t(capacity) * sizeof(SnapshotBoid);
+	slotSize = (slotSize + 63) / 64 * 64;
+
+	m_name = SharedName(name);
+	m_size = sizeof(SnapshotHeader) + numSlots * slotSize;
+
+	shm_unlink(m_name.c_str());
+
+	int file = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+	if(file < 0 || ftruncate(file, m_size) != 0)
+	{
+		std::cout << "Error: unable to create shared memory " << m_name << std::endl;
+		if(file >= 0) { close(file); shm_unlink(m_name.c_str()); }
+		return false;
+	}
+
+	void* memory = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+
+	if(memory == MAP_FAILED)
+	{
+		std::cout << "Error: unable to map shared memory " << m_name << std::endl;
+		shm_unlink(m_name.c_str());
+		return false;
+	}
+
+	TrackAllocation(ExportMemory, m_size);
+
+	// The new memory is all zeros, so every slot starts empty and even
+	m_header = static_cast<SnapshotHeader*>(memory);
+	m_header->version = s_snapshotVersion;
+	m_header->numSlots = numSlots;
+	m_header->capacity = capacity;
+	m_header->slotSize = slotSize;
+	m_header->published = 0;
+
+	// Readers check the magic last, so they never see a half written header
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(m_header->magic, s_snapshotMagic, sizeof(s_snapshotMagic));
+
+	return true;
+}
+
+
+/* Close:
+*  ------
+*	Unmaps and removes the shared memory.
+*/
+void SnapshotPublisher::Close()
+{
+	if(!m_header) { return; }
+
+	munmap(m_header, m_size);
+	shm_unlink(m_name.c_str());
+	TrackDeallocation(ExportMemory, m_size);
+
+	m_header = NULL;
+	m_size = 0;
+}
+
+
+/* Publish:
+*  --------
+*	Writes into the slot after the latest, marking it odd for
+*	the duration. The writer never waits for readers: one still
+*	reading the slot finds out from Valid.
+*/
+void SnapshotPublisher::Publish(const World& world)
+{
+	if(!m_header) { return; }
+
+	uint64_t published = m_header->published;
+	SnapshotSlot* slot = Slot(m_header, published);
+
+	uint32_t sequence = slot->sequence;
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	SnapshotBoid* boid = slot->boids();
+	uint32_t numBoids = 0;
+	uint32_t totalBoids = 0;
+
+	Imath::V3f side, up, forward;
+
+	for(unsigned int f=0; f < world.flocks.size(); ++f)
+	{
+		const Flock::BoidList& boids = world.flocks[f]->boids();
+
+		totalBoids += boids.size();
+
+		for(unsigned int b=0; b < boids.size() && numBoids < m_header->capacity; ++b, ++numBoids, ++boid)
+		{
+			const Boid& current = *boids[b];
+			current.Orientation(side, up, forward);
+
+			boid->pos[0] = current.pos().x; boid->pos[1] = current.pos().y; boid->pos[2] = current.pos().z;
+			boid->vel[0] = current.vel().x; boid->vel[1] = current.vel().y; boid->vel[2] = current.vel().z;
+			boid->up[0] = up.x; boid->up[1] = up.y; boid->up[2] = up.z;
+			boid->flock = world.flocks[f]->id();
+			boid->id = current.id();
+		}
+	}
+
+	slot->frame = world.frame;
+	slot->numBoids = numBoids;
+	slot->totalBoids = totalBoids;
+
+	__atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&m_header->published, published + 1, __ATOMIC_RELEASE);
+}
+
+
+/* Constructor:
+*  ------------
+*	Starts with nothing mapped.
+*/
+SnapshotReader::SnapshotReader()
+ :	m_header( NULL ),
+	m_size( 0 )
+{
+
+}
+
+
+SnapshotReader::~SnapshotReader()
+{
+	Close();
+}
+
+
+/* Open:
+*  -----
+*	Maps the header first to find out how big the whole
+*	thing is, then maps all of it.
+*/
+bool SnapshotReader::Open(const std::string& name)
+{
+	Close();
+
+	int file = shm_open(SharedName(name).c_str(), O_RDONLY, 0);
+	if(file < 0) { return false; }
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+
+	void* memory = mmap(NULL, sizeof(SnapshotHeader), PROT_READ, MAP_SHARED, file, 0);
+
+	if(memory != MAP_FAILED)
+	{
+		memcpy(&header, memory, sizeof(header));
+		munmap(memory, sizeof(SnapshotHeader));
+	}
+
+	if(memcmp(header.magic, s_snapshotMagic, sizeof(s_snapshotMagic)) != 0 || header.version != s_snapshotVersion)
+	{
+		close(file);
+		return false;
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	m_size = sizeof(SnapshotHeader) + header.numSlots * header.slotSize;
+	memory = mmap(NULL, m_size, PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+
+	if(memory == MAP_FAILED) { return false; }
+
+	m_header = static_cast<const SnapshotHeader*>(memory);
+
+	return true;
+}
+
+
+void SnapshotReader::Close()
+{
+	if(!m_header) { return; }
+
+	munmap(const_cast<SnapshotHeader*>(m_header), m_size);
+
+	m_header = NULL;
+	m_size = 0;
+}
+
+
+/* Latest:
+*  -------
+*	Takes the sequence before anything else is read from the
+*	slot. An odd sequence means the writer has lapped the
+*	reader and is already filling the slot again.
+*/
+const SnapshotSlot* SnapshotReader::Latest(uint32_t& sequence) const
+{
+	if(!m_header) { return NULL; }
+
+	uint64_t published = __atomic_load_n(&m_header->published, __ATOMIC_ACQUIRE);
+	if(published == 0) { return NULL; }
+
+	const SnapshotSlot* slot = Slot(const_cast<SnapshotHeader*>(m_header), published - 1);
+
+	sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+	return (sequence & 1) ? NULL : slot;
+}
+
+
+/* Valid:
+*  ------
+*	The fence keeps the reads of the slot before the second
+*	look at the sequence.
+*/
+bool SnapshotReader::Valid(const SnapshotSlot* slot, uint32_t sequence) const
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+} // Flock
@@ -0,0 +1,137 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <string>
+#include <stdint.h>
+
+/*!
+\file Snapshot.h
+\brief publishes the state of every boid each frame to POSIX shared memory, for other processes
+	to read in place without copying and without ever holding up the simulation
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+
+/*! One boid as published. The side axis is up crossed with the direction of the velocity */
+struct SnapshotBoid
+{
+	float pos[3];
+	float vel[3];
+	float up[3];
+	uint32_t flock;
+	uint32_t id;
+};
+
+/*! One frame in the ring, followed in memory by its boids */
+struct SnapshotSlot
+{
+	/*! Odd while the frame is being written. A reader that sees the same even value before and
+		after reading the frame read it whole */
+	uint32_t sequence;
+
+	uint32_t frame;
+
+	/*! Number of boids stored in the slot */
+	uint32_t numBoids;
+
+	/*! Number of boids in the world. More than numBoids if the slot was too small */
+	uint32_t totalBoids;
+
+	const SnapshotBoid* boids() const { return reinterpret_cast<const SnapshotBoid*>(this + 1); };
+	SnapshotBoid* boids() { return reinterpret_cast<SnapshotBoid*>(this + 1); };
+};
+
+/*! Start of the shared memory, followed by the slots */
+struct SnapshotHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t numSlots;
+
+	/*! Most boids each slot can hold */
+	uint32_t capacity;
+
+	/*! Bytes from the start of one slot to the next */
+	uint64_t slotSize;
+
+	/*! Number of frames published. The latest is in slot (published - 1) % numSlots */
+	uint64_t published;
+};
+
+class SnapshotPublisher
+{
+public:
+
+	/*! Default empty constructor for the class. Nothing is published until Open */
+	SnapshotPublisher();
+
+	/*! \brief destructor removes the shared memory */
+	~SnapshotPublisher();
+
+	/*! \brief method used to create the shared memory, replacing any left with the same name
+		\param name - the shared memory object's name, such as /flock
+		\param numSlots - the number of frames kept. Readers have until the writer comes back
+		round to a slot to finish with it
+		\param capacity - the most boids published each frame
+		\return false if the shared memory could not be created */
+	bool Open(const std::string& name, unsigned int numSlots, unsigned int capacity);
+
+	/*! \brief method used to unmap and remove the shared memory */
+	void Close();
+
+	/*! \brief method used to write the world's boids into the next slot. Called by World::Update
+		after each frame once set as the world's snapshot
+		\param world - the world to publish */
+	void Publish(const World& world);
+
+private:
+
+	SnapshotHeader* m_header;
+	size_t m_size;
+	std::string m_name;
+};
+
+class SnapshotReader
+{
+public:
+
+	/*! Default empty constructor for the class */
+	SnapshotReader();
+
+	/*! \brief destructor unmaps the shared memory */
+	~SnapshotReader();
+
+	/*! \brief method used to map shared memory created by a SnapshotPublisher, read only
+		\param name - the name given to SnapshotPublisher::Open
+		\return false if it does not exist yet or is not a snapshot */
+	bool Open(const std::string& name);
+
+	void Close();
+
+	/*! \brief method used to find the latest frame, to be read in place
+		\param sequence - filled in with the slot's sequence, to pass to Valid once done
+		\return the slot, or null if nothing has been published or the writer has already started
+		overwriting it */
+	const SnapshotSlot* Latest(uint32_t& sequence) const;
+
+	/*! \brief method used to check that a slot returned by Latest was not overwritten while it was
+		being read. If not, anything read from it is discarded and Latest called again
+		\param slot - the slot read
+		\param sequence - the sequence given by Latest
+		\return true if everything read from the slot is whole */
+	bool Valid(const SnapshotSlot* slot, uint32_t sequence) const;
+
+private:
+
+	const SnapshotHeader* m_header;
+	size_t m_size;
+};
+
+}; // Flock
+
+#endif
@@ -0,0 +1,424 @@
+#include "SoftwareRenderer.h"
+
+#include "World.h"
+#include "Flock.h"
+#include "Boid.h"
+#include "Object.h"
+#include "Particle.h"
+#include "Transform.h"
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+/*!
+\file SoftwareRenderer.cpp
+\brief contains methods for the software renderer class
+\author Michael Jones
+\version 1
+\date 06/02/06
+*/
+
+namespace Flock {
+
+namespace {
+
+const float s_toDegrees = 57.295779524f;
+
+/*! Ambient level, the same as the viewer's GL_LIGHT_MODEL_AMBIENT */
+const float s_ambient = 0.2f;
+
+/*! The colour every shadow is drawn in */
+const Imath::Color4<float> s_shadowColour(0.1f, 0.3f, 0.1f, 1.0f);
+
+void AddTriangle(std::vector<Imath::V3f>& mesh, const Imath::V3f& a, const Imath::V3f& b, const Imath::V3f& c)
+{
+	mesh.push_back(a);
+	mesh.push_back(b);
+	mesh.push_back(c);
+}
+
+} // namespace
+
+
+/* Camera Constructor:
+*  -------------------
+*	Same view as the viewer sets up in InitialiseGL.
+*/
+SoftwareRenderer::Camera::Camera()
+ :	eye( 30.0f, 30.0f, 30.0f ),
+	look( 0.0f, 0.0f, 0.0f ),
+	up( 0.0f, 1.0f, 0.0f ),
+	fov( 45.0f ),
+	nearPlane( 0.5f ),
+	farPlane( 150.0f )
+{
+
+}
+
+
+/* Constructor:
+*  ------------
+*	Sets up the image buffers and builds the meshes, which
+*	match the shapes the immediate mode Draw methods use.
+*/
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height)
+ :	m_width( std::max(width, 1u) ),
+	m_height( std::max(height, 1u) ),
+	m_focal( 1.0f ),
+	m_aspect( 1.0f )
+{
+	m_pixels.resize(m_width * m_height * 3);
+	m_depth.resize(m_width * m_height);
+
+	// Boid: glutSolidCone(0.5, 1, 4, 1)
+	Imath::V3f apex(0.0f, 0.0f, 1.0f);
+	Imath::V3f centre(0.0f, 0.0f, 0.0f);
+	Imath::V3f base[4] = { Imath::V3f(0.0f, 0.5f, 0.0f), Imath::V3f(0.5f, 0.0f, 0.0f),
+		Imath::V3f(0.0f, -0.5f, 0.0f), Imath::V3f(-0.5f, 0.0f, 0.0f) };
+
+	for(unsigned int i=0; i < 4; ++i)
+	{
+		AddTriangle(m_coneMesh, base[(i + 1) % 4], base[i], apex);
+		AddTriangle(m_coneMesh, base[i], base[(i + 1) % 4], centre);
+	}
+
+	// Object: glutSolidSphere(radius, 9, 9)
+	const unsigned int slices = 9, stacks = 9;
+
+	for(unsigned int j=0; j < stacks; ++j)
+	{
+		float lower = float(M_PI) * j / stacks;
+		float upper = float(M_PI) * (j + 1) / stacks;
+
+		for(unsigned int i=0; i < slices; ++i)
+		{
+			float left = 2.0f * float(M_PI) * i / slices;
+			float right = 2.0f * float(M_PI) * (i + 1) / slices;
+
+			Imath::V3f corners[4] = {
+				Imath::V3f(std::sin(lower) * std::cos(left), std::sin(lower) * std::sin(left), std::cos(lower)),
+				Imath::V3f(std::sin(upper) * std::cos(left), std::sin(upper) * std::sin(left), std::cos(upper)),
+				Imath::V3f(std::sin(upper) * std::cos(right), std::sin(upper) * std::sin(right), std::cos(upper)),
+				Imath::V3f(std::sin(lower) * std::cos(right), std::sin(lower) * std::sin(right), std::cos(lower)) };
+
+			for(unsigned int c=0; c < 4; ++c) { corners[c] *= Object::radius(); }
+
+			AddTriangle(m_sphereMesh, corners[0], corners[1], corners[2]);
+			AddTriangle(m_sphereMesh, corners[0], corners[2], corners[3]);
+		}
+	}
+
+	// Particle: an octahedron, about as round as glutSolidSphere(0.1, 3, 3)
+	float r = 0.1f;
+	Imath::V3f points[6] = { Imath::V3f(r, 0, 0), Imath::V3f(0, 0, r), Imath::V3f(-r, 0, 0),
+		Imath::V3f(0, 0, -r), Imath::V3f(0, r, 0), Imath::V3f(0, -r, 0) };
+
+	for(unsigned int i=0; i < 4; ++i)
+	{
+		AddTriangle(m_particleMesh, points[(i + 1) % 4], points[i], points[4]);
+		AddTriangle(m_particleMesh, points[i], points[(i + 1) % 4], points[5]);
+	}
+
+	// Shadows, all facing up
+	AddTriangle(m_boidShadowMesh, Imath::V3f(0.0f, 0.0f, 1.0f), Imath::V3f(0.5f, 0.0f, -0.3f), Imath::V3f(-0.5f, 0.0f, -0.3f));
+
+	for(float ang=0; ang < 6.3f; ang += 0.1f)
+	{
+		AddTriangle(m_objectShadowMesh, Imath::V3f(0.0f, 0.0f, 0.0f),
+			Imath::V3f(Object::radius() * std::sin(ang), 0.0f, Object::radius() * std::cos(ang)),
+			Imath::V3f(Object::radius() * std::sin(ang + 0.1f), 0.0f, Object::radius() * std::cos(ang + 0.1f)));
+	}
+
+	AddTriangle(m_particleShadowMesh, Imath::V3f(0.1f, 0.0f, 0.1f), Imath::V3f(0.1f, 0.0f, -0.1f), Imath::V3f(-0.1f, 0.0f, -0.1f));
+	AddTriangle(m_particleShadowMesh, Imath::V3f(0.1f, 0.0f, 0.1f), Imath::V3f(-0.1f, 0.0f, -0.1f), Imath::V3f(-0.1f, 0.0f, 0.1f));
+}
+
+
+/* Capture:
+*  --------
+*	Copies out what Display would draw. Only reads the world,
+*	so it is safe as long as the world isn't being updated.
+*/
+void SoftwareRenderer::Capture(const World& world, unsigned int number, Frame& frame)
+{
+	frame.number = number;
+	frame.min = Imath::V3f(world.minX, world.minY, world.minZ);
+	frame.max = Imath::V3f(world.maxX, world.maxY, world.maxZ);
+
+	frame.boids.clear();
+	frame.particles.clear();
+	frame.objects.clear();
+
+	Frame::Body body;
+
+	std::vector<Flock*>::const_iterator currentFlock = world.flocks.begin();
+	std::vector<Flock*>::const_iterator endFlock = world.flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		const Imath::Color4<float>& colour = (*currentFlock)->colour();
+
+		// Flock::Draw passes the channels in r, b, g order, kept so the pictures match
+		body.colour = Imath::Color4<float>(colour.r, colour.b, colour.g, colour.a);
+		body.floorHeight = world.minY;
+
+		const Flock::BoidList& boids = (*currentFlock)->boids();
+
+		for(unsigned int b=0; b < boids.size(); ++b)
+		{
+			body.pos = boids[b]->pos();
+			boids[b]->Orientation(body.side, body.up, body.forward);
+			frame.boids.push_back(body);
+		}
+
+		const Flock::ParticleList& particles = (*currentFlock)->particles();
+
+		for(unsigned int p=0; p < particles.size(); ++p)
+		{
+			body.pos = particles[p]->Pos;
+			body.colour = particles[p]->colour;
+			body.floorHeight = particles[p]->floorHeight;
+			frame.particles.push_back(body);
+		}
+	}
+
+	for(unsigned int o=0; o < world.objects.size(); ++o)
+	{
+		frame.objects.push_back(world.objects[o]->pos());
+	}
+
+	for(unsigned int o=0; o < world.movingObjects.size(); ++o)
+	{
+		frame.objects.push_back(world.movingObjects.pos(o));
+	}
+}
+
+
+/* Render:
+*  -------
+*	Clears the image and draws the frame in the same order
+*	as Display: ground, objects, then each boid and particle
+*	with its shadow.
+*/
+void SoftwareRenderer::Render(const Frame& frame)
+{
+	std::fill(m_pixels.begin(), m_pixels.end(), 0);
+	std::fill(m_depth.begin(), m_depth.end(), 0.0f);
+
+	m_forward = camera.look - camera.eye;
+	m_forward.normalize();
+	m_right = m_forward.cross(camera.up);
+	m_right.normalize();
+	m_upward = m_right.cross(m_forward);
+
+	m_focal = 1.0f / std::tan(camera.fov * 0.5f / s_toDegrees);
+	m_aspect = float(m_width) / float(m_height);
+
+	// Ground, one unit below the floor as in World::DrawGround
+	float groundY = frame.min.y - 1.0f;
+	Imath::Color4<float> green(0.0f, 1.0f, 0.0f, 1.0f);
+
+	Imath::V3f corners[4] = { Imath::V3f(frame.min.x, groundY, frame.min.z), Imath::V3f(frame.min.x, groundY, frame.max.z),
+		Imath::V3f(frame.max.x, groundY, frame.max.z), Imath::V3f(frame.max.x, groundY, frame.min.z) };
+
+	DrawTriangle(corners[0], corners[1], corners[2], green);
+	DrawTriangle(corners[0], corners[2], corners[3], green);
+
+	Imath::Color4<float> white(1.0f, 1.0f, 1.0f, 1.0f);
+
+	for(unsigned int o=0; o < frame.objects.size(); ++o)
+	{
+		const Imath::V3f& pos = frame.objects[o];
+
+		Transform body;
+		body.Translate(pos.x, pos.y, pos.z);
+		DrawMesh(m_sphereMesh, body, white);
+
+		Transform shadow;
+		shadow.Translate(pos.x, frame.min.y + 0.01f, pos.z);
+		DrawMesh(m_objectShadowMesh, shadow, s_shadowColour);
+	}
+
+	for(unsigned int b=0; b < frame.boids.size(); ++b)
+	{
+		const Frame::Body& boid = frame.boids[b];
+
+		// The same rotation as Boid::Draw
+		Transform body;
+		body.Translate(boid.pos.x, boid.pos.y, boid.pos.z);
+		body.Basis(boid.side, boid.up, boid.forward);
+		body.Scale(1.0f, 0.3f, 0.3f);
+		DrawMesh(m_coneMesh, body, boid.colour);
+
+		Transform shadow;
+		shadow.Translate(boid.pos.x, boid.floorHeight + 0.1f, boid.pos.z);
+		shadow.Face(boid.forward);
+		shadow.Scale(1.0f, 1.0f, std::fabs(0.5f - (std::asin(boid.forward.y) * s_toDegrees / 90.0f) / 2));
+		DrawMesh(m_boidShadowMesh, shadow, s_shadowColour);
+	}
+
+	for(unsigned int p=0; p < frame.particles.size(); ++p)
+	{
+		const Frame::Body& particle = frame.particles[p];
+
+		Transform body;
+		body.Translate(particle.pos.x, particle.pos.y, particle.pos.z);
+		DrawMesh(m_particleMesh, body, particle.colour);
+
+		Transform shadow;
+		shadow.Translate(particle.pos.x, particle.floorHeight + 0.1f, particle.pos.z);
+		DrawMesh(m_particleShadowMesh, shadow, s_shadowColour);
+	}
+}
+
+
+/* DrawMesh:
+*  ---------
+*	Transforms each triangle of a mesh into the world and draws it.
+*/
+void SoftwareRenderer::DrawMesh(const std::vector<Imath::V3f>& mesh, const Transform& transform, const Imath::Color4<float>& colour)
+{
+	for(unsigned int v=0; v + 2 < mesh.size(); v += 3)
+	{
+		DrawTriangle(transform.Apply(&mesh[v].x), transform.Apply(&mesh[v + 1].x), transform.Apply(&mesh[v + 2].x), colour);
+	}
+}
+
+
+/* DrawTriangle:
+*  -------------
+*	Lights the triangle, moves it into camera space, clips it
+*	against the near plane and projects what is left.
+*/
+void SoftwareRenderer::DrawTriangle(const Imath::V3f& a, const Imath::V3f& b, const Imath::V3f& c, const Imath::Color4<float>& colour)
+{
+	// Flat shading, lit from the eye like light 0 in the viewer
+	Imath::V3f normal = (b - a).cross(c - a);
+	float length = normal.length();
+	float diffuse = length > 0.0f ? std::max(-normal.dot(m_forward) / length, 0.0f) : 0.0f;
+	float light = s_ambient + diffuse;
+
+	unsigned char rgb[3] = {
+		(unsigned char)(std::min(std::max(colour.r * light, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(std::min(std::max(colour.g * light, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(std::min(std::max(colour.b * light, 0.0f), 1.0f) * 255.0f + 0.5f) };
+
+	const Imath::V3f* world[3] = { &a, &b, &c };
+	Imath::V3f view[3];
+
+	for(unsigned int i=0; i < 3; ++i)
+	{
+		Imath::V3f offset = *world[i] - camera.eye;
+		view[i] = Imath::V3f(offset.dot(m_right), offset.dot(m_upward), offset.dot(m_forward));
+	}
+
+	// Clip against the near plane, which can turn the triangle into a quad
+	Imath::V3f clipped[4];
+	unsigned int count = 0;
+
+	for(unsigned int i=0; i < 3; ++i)
+	{
+		const Imath::V3f& current = view[i];
+		const Imath::V3f& next = view[(i + 1) % 3];
+
+		bool currentIn = current.z >= camera.nearPlane;
+		bool nextIn = next.z >= camera.nearPlane;
+
+		if(currentIn) { clipped[count++] = current; }
+
+		if(currentIn != nextIn)
+		{
+			float t = (camera.nearPlane - current.z) / (next.z - current.z);
+			clipped[count++] = current + (next - current) * t;
+		}
+	}
+
+	if(count < 3) { return; }
+
+	// Project to pixels, keeping 1/z for the depth test
+	Imath::V3f screen[4];
+
+	for(unsigned int i=0; i < count; ++i)
+	{
+		float inverse = 1.0f / clipped[i].z;
+
+		screen[i].x = (clipped[i].x * m_focal / m_aspect * inverse + 1.0f) * 0.5f * m_width;
+		screen[i].y = (1.0f - clipped[i].y * m_focal * inverse) * 0.5f * m_height;
+		screen[i].z = inverse;
+	}
+
+	FillTriangle(screen[0], screen[1], screen[2], rgb);
+
+	if(count == 4) { FillTriangle(screen[0], screen[2], screen[3], rgb); }
+}
+
+
+/* FillTriangle:
+*  -------------
+*	Tests each pixel centre in the triangle's bounds against
+*	its three edges. Both windings are filled since the viewer
+*	doesn't cull back faces.
+*/
+void SoftwareRenderer::FillTriangle(const Imath::V3f& a, const Imath::V3f& b, const Imath::V3f& c, const unsigned char* rgb)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if(area == 0.0f) { return; }
+
+	int minX = std::max(int(std::floor(std::min(a.x, std::min(b.x, c.x)))), 0);
+	int maxX = std::min(int(std::ceil(std::max(a.x, std::max(b.x, c.x)))), int(m_width) - 1);
+	int minY = std::max(int(std::floor(std::min(a.y, std::min(b.y, c.y)))), 0);
+	int maxY = std::min(int(std::ceil(std::max(a.y, std::max(b.y, c.y)))), int(m_height) - 1);
+
+	float farDepth = 1.0f / camera.farPlane;
+
+	for(int y=minY; y <= maxY; ++y)
+	{
+		float py = y + 0.5f;
+
+		for(int x=minX; x <= maxX; ++x)
+		{
+			float px = x + 0.5f;
+
+			float wa = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+			float wb = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+			float wc = 1.0f - wa - wb;
+
+			if(wa < 0.0f || wb < 0.0f || wc < 0.0f) { continue; }
+
+			float depth = wa * a.z + wb * b.z + wc * c.z;
+			unsigned int index = y * m_width + x;
+
+			if(depth < farDepth || depth <= m_depth[index]) { continue; }
+
+			m_depth[index] = depth;
+			m_pixels[index * 3] = rgb[0];
+			m_pixels[index * 3 + 1] = rgb[1];
+			m_pixels[index * 3 + 2] = rgb[2];
+		}
+	}
+}
+
+
+/* WritePPM:
+*  ---------
+*	Binary PPM, top row first.
+*/
+bool SoftwareRenderer::WritePPM(const std::string& filename) const
+{
+	std::ofstream image(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if(!image.is_open())
+	{
+		std::cout << "Unable to write " << filename << std::endl;
+		return false;
+	}
+
+	image << "P6\n" << m_width << " " << m_height << "\n255\n";
+	image.write(reinterpret_cast<const char*>(&m_pixels[0]), m_pixels.size());
+
+	return image.good();
+}
+
+} // Flock
@@ -0,0 +1,126 @@
+#ifndef __SOFTWARERENDERER_H__
+#define __SOFTWARERENDERER_H__
+
+#include <vector>
+#include <string>
+
+#include <ImathVec.h>
+#include <ImathColor.h>
+
+/*!
+\file SoftwareRenderer.h
+\brief draws the viewer's picture of the world on the CPU, for machines with no display or GPU
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+class World;
+class Transform;
+
+class SoftwareRenderer
+{
+public:
+
+	/*! A copy of everything drawn in one frame, so the world can carry on updating while it is rendered */
+	struct Frame
+	{
+		/*! A boid or particle: where it is, its axes and its colour */
+		struct Body
+		{
+			Imath::V3f pos;
+			Imath::V3f side;
+			Imath::V3f up;
+			Imath::V3f forward;
+			Imath::Color4<float> colour;
+			float floorHeight;
+		};
+
+		unsigned int number;
+
+		Imath::V3f min;
+		Imath::V3f max;
+
+		std::vector<Body> boids;
+		std::vector<Body> particles;
+		std::vector<Imath::V3f> objects;
+	};
+
+	/*! The viewpoint, defaulting to the one set up in the viewer's InitialiseGL */
+	struct Camera
+	{
+		Camera();
+
+		Imath::V3f eye;
+		Imath::V3f look;
+		Imath::V3f up;
+
+		/*! Vertical field of view in degrees */
+		float fov;
+		float nearPlane;
+		float farPlane;
+	};
+
+	/*! \brief constructor for the class
+		\param width - width of the image in pixels
+		\param height - height of the image in pixels */
+	SoftwareRenderer(unsigned int width, unsigned int height);
+
+	/*! \brief method used to copy the drawable state of the world
+		\param world - the world to copy
+		\param number - the frame number to store with the copy
+		\param frame - filled out with the copy. Its storage is reused between calls */
+	static void Capture(const World& world, unsigned int number, Frame& frame);
+
+	/*! \brief method used to draw the ground, objects, boids, particles and shadows of a frame,
+		the same as the viewer's Display function */
+	void Render(const Frame& frame);
+
+	/*! \brief method used to write the last image rendered as a binary PPM
+		\param filename - the file to write
+		\return false if the file could not be written */
+	bool WritePPM(const std::string& filename) const;
+
+	Camera camera;
+
+	unsigned int width() const { return m_width; };
+	unsigned int height() const { return m_height; };
+
+private:
+
+	/*! \brief draws a triangle given in world space. Flat shaded with a light at the eye,
+		like the viewer's default light 0 */
+	void DrawTriangle(const Imath::V3f& a, const Imath::V3f& b, const Imath::V3f& c, const Imath::Color4<float>& colour);
+
+	/*! \brief rasterises a triangle already projected to the screen. x and y are in pixels, z is depth */
+	void FillTriangle(const Imath::V3f& a, const Imath::V3f& b, const Imath::V3f& c, const unsigned char* rgb);
+
+	/*! \brief draws a list of triangles, every three points being one triangle, through a transform */
+	void DrawMesh(const std::vector<Imath::V3f>& mesh, const Transform& transform, const Imath::Color4<float>& colour);
+
+	unsigned int m_width;
+	unsigned int m_height;
+
+	/*! World to camera space and the projection scale, set up at the start of each Render */
+	Imath::V3f m_right;
+	Imath::V3f m_upward;
+	Imath::V3f m_forward;
+	float m_focal;
+	float m_aspect;
+
+	std::vector<unsigned char> m_pixels;
+	std::vector<float> m_depth;
+
+	std::vector<Imath::V3f> m_coneMesh;
+	std::vector<Imath::V3f> m_sphereMesh;
+	std::vector<Imath::V3f> m_particleMesh;
+	std::vector<Imath::V3f> m_boidShadowMesh;
+	std::vector<Imath::V3f> m_objectShadowMesh;
+	std::vector<Imath::V3f> m_particleShadowMesh;
+};
+
+}; // Flock
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef __TRANSFORM_H__
+#define __TRANSFORM_H__
+
+#include <cmath>
+#include <cstring>
+
+#include <ImathVec.h>
+
+/*!
+\file Transform.h
+\brief affine transform built up the same way as the OpenGL matrix stack
+\author Michael Jones
+\version 1
+\date 17/03/06
+*/
+
+namespace Flock {
+
+/*! Three rows of an affine transform. Each call post-multiplies, like glTranslate,
+	glRotate and glScale, so the last transform added applies to the mesh first */
+class Transform
+{
+public:
+
+	/*! Default constructor, starts as the identity */
+	Transform()
+	{
+		memset(m_rows, 0, sizeof(m_rows));
+		m_rows[0][0] = m_rows[1][1] = m_rows[2][2] = 1.0f;
+	}
+
+	void Translate(float x, float y, float z)
+	{
+		float t[3][4] = { { 1, 0, 0, x }, { 0, 1, 0, y }, { 0, 0, 1, z } };
+		Multiply(t);
+	}
+
+	/*! \brief same as glRotatef
+		\param angle - the angle in degrees
+		\param x, y, z - the axis, which need not be unit length */
+	void Rotate(float angle, float x, float y, float z)
+	{
+		float length = std::sqrt(x*x + y*y + z*z);
+		if(length == 0.0f) { return; }
+
+		x /= length; y /= length; z /= length;
+
+		float radians = angle * 0.017453292519943f;
+		float c = std::cos(radians);
+		float s = std::sin(radians);
+		float d = 1.0f - c;
+
+		float r[3][4] = {
+			{ x*x*d + c,   x*y*d - z*s, x*z*d + y*s, 0 },
+			{ y*x*d + z*s, y*y*d + c,   y*z*d - x*s, 0 },
+			{ x*z*d - y*s, y*z*d + x*s, z*z*d + c,   0 } };
+
+		Multiply(r);
+	}
+
+	/*! \brief rotates into a frame given by its axes, which should be unit length and at right angles */
+	void Basis(const Imath::V3f& x, const Imath::V3f& y, const Imath::V3f& z)
+	{
+		float b[3][4] = { { x.x, y.x, z.x, 0 }, { x.y, y.y, z.y, 0 }, { x.z, y.z, z.z, 0 } };
+		Multiply(b);
+	}
+
+	/*! \brief turns about the y axis to face along a direction, the same as glRotatef(yaw, 0, 1, 0)
+		with yaw = atan2(direction.x, direction.z) */
+	void Face(const Imath::V3f& direction)
+	{
+		float length = std::sqrt(direction.x*direction.x + direction.z*direction.z);
+		if(length == 0.0f) { return; }
+
+		float s = direction.x / length;
+		float c = direction.z / length;
+
+		float r[3][4] = { { c, 0, s, 0 }, { 0, 1, 0, 0 }, { -s, 0, c, 0 } };
+		Multiply(r);
+	}
+
+	void Scale(float x, float y, float z)
+	{
+		float s[3][4] = { { x, 0, 0, 0 }, { 0, y, 0, 0 }, { 0, 0, z, 0 } };
+		Multiply(s);
+	}
+
+	/*! \brief transforms a point */
+	Imath::V3f Apply(const float* point) const
+	{
+		return Imath::V3f(
+			m_rows[0][0] * point[0] + m_rows[0][1] * point[1] + m_rows[0][2] * point[2] + m_rows[0][3],
+			m_rows[1][0] * point[0] + m_rows[1][1] * point[1] + m_rows[1][2] * point[2] + m_rows[1][3],
+			m_rows[2][0] * point[0] + m_rows[2][1] * point[1] + m_rows[2][2] * point[2] + m_rows[2][3]);
+	}
+
+	void CopyTo(float rows[3][4]) const { memcpy(rows, m_rows, sizeof(m_rows)); }
+
+private:
+
+	void Multiply(const float other[3][4])
+	{
+		float result[3][4];
+
+		for(unsigned int i=0; i < 3; ++i)
+		{
+			for(unsigned int j=0; j < 4; ++j)
+			{
+				result[i][j] = m_rows[i][0] * other[0][j] + m_rows[i][1] * other[1][j] + m_rows[i][2] * other[2][j];
+			}
+			result[i][3] += m_rows[i][3];
+		}
+
+		memcpy(m_rows, result, sizeof(m_rows));
+	}
+
+	float m_rows[3][4];
+};
+
+}; // Flock
+
+#endif
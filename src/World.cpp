@@ -1,6 +1,18 @@
 #include "World.h"
 #include "Flock.h"
 #include "Object.h"
+#include "Domain.h"
+#include "Snapshot.h"
+#include "Serialise.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
 
 #include <GL/gl.h>
 #include <GL/glu.h>
@@ -15,13 +27,447 @@
 
 namespace Flock {
 
+/*! Identifies checkpoint files and the layout version they were written with */
+static const char s_checkpointMagic[4] = { 'F', 'L', 'C', 'K' };
+static const unsigned int s_checkpointVersion = 10;
+
 /* Constructor:
 *  ------------
-*	Empty
+*	Sets the frame count to zero and disables the hash log
 */
 World::World()
+ :	objectTreeDirty( true ),
+	objectFieldCellSize( 1.0f ),
+	frame( 0 ),
+	timeStep( 0.04f ),
+	subSteps( 1 ),
+	integrator( SemiImplicitEuler ),
+	batchIntegration( false ),
+	mortonSortInterval( 0 ),
+	seed( 0 ),
+	domain( NULL ),
+	hashLog( NULL ),
+	snapshot( NULL ),
+	memoryBudget( 0 ),
+	overMemoryBudget( false )
+{
+	arenas.push_back(new Arena());
+}
+
+
+/* Destructor:
+*  -----------
+*	Frees the arenas. Everything else is left to Clear, as
+*	it always has been.
+*/
+World::~World()
 {
+	for(unsigned int a=0; a < arenas.size(); ++a)
+	{
+		delete arenas[a];
+	}
+}
+
+
+/* Update:
+*  -------
+*	Moves the obstacles, then runs the update for each flock in
+*	turn, once per sub-step, and advances the frame. The work done is counted in stats.
+*	When the world is split into domains the boids near the
+*	boundaries are exchanged around every step, and if that
+*	fails the step stops there.
+*/
+bool World::Update(Imath::V3f& target)
+{
+	stats.Reset();
+
+	unsigned long long allocations[NumMemorySubsystems];
+
+	for(unsigned int s=0; s < NumMemorySubsystems; ++s)
+		allocations[s] = MemoryUsage(MemorySubsystem(s)).allocations;
+
+	movingObjects.Update(*this);
+	UpdateObjectTree();
+
+#ifdef _OPENMP
+	// One arena for each thread the behaviours might run on
+	while(arenas.size() < (unsigned int)omp_get_max_threads())
+		arenas.push_back(new Arena());
+#endif
+
+	for(unsigned int step=0; step < subSteps; ++step)
+	{
+		for(unsigned int a=0; a < arenas.size(); ++a)
+			arenas[a]->Reset();
+
+		if(domain && !domain->BeginStep()) { return false; }
+
+		std::vector<Flock*>::iterator currentFlock = flocks.begin();
+		std::vector<Flock*>::iterator endFlock = flocks.end();
+
+		for(; currentFlock != endFlock; ++currentFlock)
+		{
+			(*currentFlock)->Update(target);
+		}
+
+		if(domain && !domain->EndStep()) { return false; }
+
+		for(unsigned int a=0; a < arenas.size(); ++a)
+		{
+			stats.arenaPeak = std::max<unsigned long long>(stats.arenaPeak, arenas[a]->peak());
+			stats.arenaHeapAllocations += arenas[a]->heapAllocations();
+		}
+	}
+
+	++frame;
+
+	unsigned long long totalBytes = 0;
+
+	for(unsigned int s=0; s < NumMemorySubsystems; ++s)
+	{
+		MemoryCounters counters = MemoryUsage(MemorySubsystem(s));
+
+		stats.memoryBytes[s] = counters.bytes;
+		stats.memoryAllocations[s] = counters.allocations - allocations[s];
+		totalBytes += counters.bytes;
+	}
+
+	if(memoryBudget && totalBytes > memoryBudget && !overMemoryBudget)
+	{
+		std::cout << "Warning: " << totalBytes << " bytes held at frame " << frame 
+			<< " is over the memory budget of " << memoryBudget << " bytes" << std::endl;
+		WriteMemoryReport(std::cout);
+	}
+
+	overMemoryBudget = memoryBudget && totalBytes > memoryBudget;
+
+	if(hashLog)
+	{
+		WriteHashes(*hashLog);
+	}
+
+	if(snapshot)
+	{
+		snapshot->Publish(*this);
+	}
+
+	return true;
+}
+
+
+/* arena:
+*  ------
+*	Picks the arena by OpenMP thread number.
+*/
+Arena& World::arena()
+{
+#ifdef _OPENMP
+	return *arenas[omp_get_thread_num()];
+#else
+	return *arenas[0];
+#endif
+}
+
+
+/* UpdateObjectTree:
+*  -----------------
+*	Moves the objects that have a velocity then rebuilds or
+*	refits the object hierarchy to match.
+*/
+void World::UpdateObjectTree()
+{
+	bool moved = false;
+
+	std::vector<Object*>::iterator currentObject = objects.begin();
+	std::vector<Object*>::iterator endObject = objects.end();
+
+	for(; currentObject != endObject; ++currentObject)
+	{
+		if((*currentObject)->moving())
+		{
+			(*currentObject)->Update();
+			moved = true;
+		}
+	}
+
+	if(objectTreeDirty)
+	{
+		objectTree.Build(objects);
+		objectField.Clear();
+		objectTreeDirty = false;
+	}
+	else if(moved)
+	{
+		objectTree.Refit(objects);
+	}
+
+	if(objectField.empty())
+	{
+		BakeObjectField();
+	}
+}
+
+
+/* BakeObjectField:
+*  ----------------
+*	Bakes the distance field if any flock avoids objects with it.
+*	The field only needs to reach as far as the flocks look.
+*/
+void World::BakeObjectField()
+{
+	float band = 0.0f;
+
+	std::vector<Flock*>::iterator currentFlock = flocks.begin();
+	std::vector<Flock*>::iterator endFlock = flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		if((*currentFlock)->behaviour().objectAvoidanceMode == Flock::DistanceFieldAvoidance)
+			band = std::max(band, (*currentFlock)->objectTestRadius());
+	}
+
+	if(band <= 0.0f || objects.empty()) { return; }
+
+	objectField.Bake(objects, objectTree, Imath::V3f(minX, minY, minZ), Imath::V3f(maxX, maxY, maxZ), 
+		objectFieldCellSize, band);
+}
+
+
+/* WriteHashes:
+*  ------------
+*	Writes one line per flock of the form "frame flockID hash"
+*	which the hashcompare tool reads back.
+*/
+void World::WriteHashes(std::ostream& out) const
+{
+	std::vector<Flock*>::const_iterator currentFlock = flocks.begin();
+	std::vector<Flock*>::const_iterator endFlock = flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		out << frame << " " << (*currentFlock)->id() << " " 
+			<< std::hex << std::setfill('0') << std::setw(16) << (*currentFlock)->Hash() 
+			<< std::dec << std::setfill(' ') << "\n";
+	}
+}
+
+
+/* WriteMemoryReport:
+*  ------------------
+*	Writes the counts gathered at the end of the last update,
+*	so the report matches stats.
+*/
+void World::WriteMemoryReport(std::ostream& out) const
+{
+	for(unsigned int s=0; s < NumMemorySubsystems; ++s)
+	{
+		out << frame << " " << MemorySubsystemName(MemorySubsystem(s)) << " "
+			<< stats.memoryBytes[s] << " " << stats.memoryAllocations[s] << "\n";
+	}
+}
+
+
+/* Clear:
+*  ------
+*	Deletes all the flocks and objects owned by the world
+*	and removes the moving objects.
+*/
+void World::Clear()
+{
+	std::vector<Flock*>::iterator currentFlock = flocks.begin();
+	std::vector<Flock*>::iterator endFlock = flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		delete (*currentFlock);
+	}
+	flocks.clear();
+
+	std::vector<Object*>::iterator currentObject = objects.begin();
+	std::vector<Object*>::iterator endObject = objects.end();
+
+	for(; currentObject != endObject; ++currentObject)
+	{
+		delete (*currentObject);
+	}
+	objects.clear();
+	objectTreeDirty = true;
+	objectField.Clear();
+
+	movingObjects.Clear();
+
+	frame = 0;
+}
+
+
+/* SaveCheckpoint:
+*  ---------------
+*	Writes a header, the world bounds and frame, then each
+*	object, the moving objects and each flock in order.
+*/
+bool World::SaveCheckpoint(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if(!out.is_open())
+	{
+		std::cout << "Unable to write checkpoint " << filename << std::endl;
+		return false;
+	}
+
+	out.write(s_checkpointMagic, sizeof(s_checkpointMagic));
+	Write(out, s_checkpointVersion);
+	
+	// Guard against reading a checkpoint from a build with a different behaviour layout
+	unsigned int behaviourSize = sizeof(Flock::Behaviour);
+	Write(out, behaviourSize);
+
+	Write(out, maxX);
+	Write(out, minX);
+	Write(out, maxY);
+	Write(out, minY);
+	Write(out, maxZ);
+	Write(out, minZ);
+	Write(out, frame);
+	Write(out, timeStep);
+	Write(out, subSteps);
+
+	unsigned int integratorID = integrator;
+	Write(out, integratorID);
+
+	Write(out, lod.enabled);
+	Write(out, lod.centre);
+	Write(out, lod.distance);
+	Write(out, lod.interval);
+	Write(out, lod.neighbourRefresh);
+
+	Write(out, sleeping.enabled);
+	Write(out, sleeping.threshold);
+	Write(out, sleeping.settleSteps);
+	Write(out, sleeping.wakeInterval);
+	Write(out, batchIntegration);
+	Write(out, mortonSortInterval);
+	Write(out, objectFieldCellSize);
+
+	unsigned int numObjects = objects.size();
+	Write(out, numObjects);
+
+	std::vector<Object*>::const_iterator currentObject = objects.begin();
+	std::vector<Object*>::const_iterator endObject = objects.end();
+
+	for(; currentObject != endObject; ++currentObject)
+	{
+		(*currentObject)->Save(out);
+	}
+
+	movingObjects.Save(out);
+
+	unsigned int numFlocks = flocks.size();
+	Write(out, numFlocks);
+
+	std::vector<Flock*>::const_iterator currentFlock = flocks.begin();
+	std::vector<Flock*>::const_iterator endFlock = flocks.end();
+
+	for(; currentFlock != endFlock; ++currentFlock)
+	{
+		(*currentFlock)->Save(out);
+	}
+
+	return out.good();
+}
+
+
+/* LoadCheckpoint:
+*  ---------------
+*	Clears the world and rebuilds it from a checkpoint.
+*/
+bool World::LoadCheckpoint(const std::string& filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+
+	if(!in.is_open())
+	{
+		std::cout << "Checkpoint " << filename << " not found" << std::endl;
+		return false;
+	}
+
+	char magic[4];
+	unsigned int version = 0;
+	unsigned int behaviourSize = 0;
+
+	in.read(magic, sizeof(magic));
+	Read(in, version);
+	Read(in, behaviourSize);
+
+	if(!in.good() || !std::equal(magic, magic + 4, s_checkpointMagic) 
+		|| version != s_checkpointVersion || behaviourSize != sizeof(Flock::Behaviour))
+	{
+		std::cout << "Error: " << filename << " is not a compatible checkpoint" << std::endl;
+		return false;
+	}
+
+	Clear();
+
+	Read(in, maxX);
+	Read(in, minX);
+	Read(in, maxY);
+	Read(in, minY);
+	Read(in, maxZ);
+	Read(in, minZ);
+	Read(in, frame);
+	Read(in, timeStep);
+	Read(in, subSteps);
+
+	unsigned int integratorID = 0;
+	Read(in, integratorID);
+	integrator = Integrator(integratorID);
+
+	Read(in, lod.enabled);
+	Read(in, lod.centre);
+	Read(in, lod.distance);
+	Read(in, lod.interval);
+	Read(in, lod.neighbourRefresh);
+
+	Read(in, sleeping.enabled);
+	Read(in, sleeping.threshold);
+	Read(in, sleeping.settleSteps);
+	Read(in, sleeping.wakeInterval);
+	Read(in, batchIntegration);
+	Read(in, mortonSortInterval);
+	Read(in, objectFieldCellSize);
+
+	unsigned int numObjects = 0;
+	Read(in, numObjects);
+
+	for(unsigned int o=0; o < numObjects && in.good(); ++o)
+	{
+		Object* newObject = new Object(*this, 0.0f, 0.0f, 0.0f);
+		newObject->Load(in);
+		AddObject(newObject);
+	}
+
+	// Arrays of different lengths are as bad as running out of data
+	if(!movingObjects.Load(in))
+		in.setstate(std::ios::failbit);
+
+	unsigned int numFlocks = 0;
+	Read(in, numFlocks);
+
+	for(unsigned int f=0; f < numFlocks && in.good(); ++f)
+	{
+		Flock* newFlock = new Flock(f, *this);
+		newFlock->Load(in);
+		AddFlock(newFlock);
+	}
+
+	if(!in.good())
+	{
+		std::cout << "Error: checkpoint " << filename << " is truncated" << std::endl;
+		Clear();
+		return false;
+	}
 
+	return true;
 }
 
 
@@ -42,6 +488,7 @@ void World::AddFlock(Flock* addFlock)
 void World::AddObject(Object* addObject)
 {
 	objects.push_back(addObject);
+	objectTreeDirty = true;
 }
 
 
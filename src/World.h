@@ -3,6 +3,16 @@
 
 #include "Flock.h"
 #include "Object.h"
+#include "ObjectBVH.h"
+#include "DistanceField.h"
+#include "MovingObjects.h"
+#include "Arena.h"
+#include "Memory.h"
+
+#include <ImathVec.h>
+
+#include <string>
+#include <iosfwd>
 
 /*!
 \file World.h
@@ -16,6 +26,8 @@ namespace Flock {
 
 class Flock;
 class Object;
+class Domain;
+class SnapshotPublisher;
 
 class World 
 {
@@ -36,9 +48,284 @@ std::vector<Flock*> flocks;
 /*! STL vector with pointers to all the objects in the current configuration */
 std::vector<Object*> objects;
 
+/*! Hierarchy over the object positions used by the flocks' object avoidance. Kept in step with
+	objects by UpdateObjectTree */
+ObjectBVH objectTree;
+
+/*! Set whenever objects are added or removed so the next update rebuilds objectTree */
+bool objectTreeDirty;
+
+/*! Distance to the nearest static object, baked over the world bounds for flocks using
+	distance field object avoidance. Baked by UpdateObjectTree when first needed and
+	again whenever objects are added or removed */
+DistanceField objectField;
+
+/*! Spacing of the grid points in objectField */
+float objectFieldCellSize;
+
+/*! Obstacles that move every frame, kept apart from objects so that thousands of them can be
+	moved and gridded together without touching objectTree or objectField. The flocks avoid them
+	with the spherical rule whichever object avoidance mode they use */
+MovingObjects movingObjects;
+
+/*! Number of time steps the world has been updated for */
+unsigned int frame;
+
+/*! Ways of integrating the boids' motion */
+enum Integrator
+{
+	/*! Velocity is updated first and the new velocity moves the boid. The original scheme */
+	SemiImplicitEuler,
+
+	/*! Velocity Verlet, second order in position. Keeps more energy than semi-implicit Euler
+		at large steps */
+	VelocityVerlet
+};
+
+/*! Simulated seconds that each call to Update advances the world by */
+float timeStep;
+
+/*! Number of equal steps each call to Update is split into. The behaviours are run at every step */
+unsigned int subSteps;
+
+/*! Scheme used to integrate the boids' motion */
+Integrator integrator;
+
+/*! True integrates each flock's boids together with a vectorised kernel. Faster, but the
+	clamps use an approximate reciprocal square root, so results only match the per-boid
+	update to within a small tolerance */
+bool batchIntegration;
+
+/*! Number of steps between reordering each flock's boids along a Morton (Z-order) curve through
+	their positions, so that boids close in space sit close in memory. Zero keeps the boids in the
+	order they were created */
+unsigned int mortonSortInterval;
+
+/*! Settings for running flocks far from a point of interest, such as the camera, in less detail */
+struct LevelOfDetail
+{
+	LevelOfDetail()
+	 :	enabled( false ),
+		centre( 0.0f, 0.0f, 0.0f ),
+		neighbourRefresh( 4 )
+	{
+		distance[0] = 50.0f;
+		distance[1] = 100.0f;
+		interval[0] = 2;
+		interval[1] = 4;
+	}
+
+	/*! False runs every flock in full detail */
+	bool enabled;
+
+	/*! The point of interest. Flocks are given a level from the distance of their centre to it */
+	Imath::V3f centre;
+
+	/*! Distances beyond which flocks drop to level 1 and level 2. At level 1 the behaviours are
+		run every interval[0] steps and velocity matching is skipped. Level 2 runs them every
+		interval[1] steps and also reuses each boid's nearest neighbours for local flock centring */
+	float distance[2];
+
+	/*! Number of steps between running the behaviours at levels 1 and 2. The boids keep
+		moving with the acceleration from the last run in between */
+	unsigned int interval[2];
+
+	/*! Number of behaviour runs at level 2 between finding each boid's neighbours afresh */
+	unsigned int neighbourRefresh;
+};
+
+/*! Level of detail settings, disabled by default */
+LevelOfDetail lod;
+
+/*! Settings for letting boids that have settled into steady motion skip the behaviours */
+struct Sleeping
+{
+	Sleeping()
+	 :	enabled( false ),
+		threshold( 0.05f ),
+		settleSteps( 10 ),
+		wakeInterval( 8 )
+	{
+
+	}
+
+	/*! False keeps every boid awake */
+	bool enabled;
+
+	/*! Total acceleration from the behaviours below which a boid counts as quiet */
+	float threshold;
+
+	/*! Number of quiet steps in a row, with the same flock mates nearby, before a boid sleeps */
+	unsigned int settleSteps;
+
+	/*! Number of steps a boid sleeps for before waking to check its surroundings */
+	unsigned int wakeInterval;
+};
+
+/*! Sleep settings, disabled by default */
+Sleeping sleeping;
+
+/*! Seed passed to the boids as they are created. Zero keeps the original seeding by boid ID */
+unsigned long seed;
+
+/*! The slab of the world this process simulates when the world is split across processes, see
+	Domain. Null simulates the whole world here */
+Domain* domain;
+
+/*! Stream that a hash of each flock's state is written to every frame. Null disables the log */
+std::ostream* hashLog;
+
+/*! Shared memory that every boid is published to at the end of each frame, for other
+	processes to read. Null publishes nothing */
+SnapshotPublisher* snapshot;
+
+/*! Scratch memory for the behaviours, one arena per thread, reset at the start of every step.
+	Nothing allocated from them lasts beyond the step */
+std::vector<Arena*> arenas;
+
+/*! Work counters for a single update of the world */
+struct Stats
+{
+	Stats() { Reset(); }
+
+	void Reset()
+	{
+		boidSteps = 0;
+		neighbourTests = 0;
+		objectTests = 0;
+		heldSteps = 0;
+		sleepingSteps = 0;
+		sortedBoids = 0;
+		sortSeconds = 0.0;
+		spacingBefore = 0.0;
+		spacingAfter = 0.0;
+		behaviourSeconds = 0.0;
+		ghostBoids = 0;
+		migratedBoids = 0;
+		arenaPeak = 0;
+		arenaHeapAllocations = 0;
+
+		for(unsigned int s=0; s < NumMemorySubsystems; ++s)
+		{
+			memoryBytes[s] = 0;
+			memoryAllocations[s] = 0;
+		}
+	}
+
+	/*! Number of boids integrated */
+	unsigned long long boidSteps;
+
+	/*! Number of boid to boid distance tests, within and between flocks */
+	unsigned long long neighbourTests;
+
+	/*! Number of boid to object distance tests */
+	unsigned long long objectTests;
+
+	/*! Number of boid steps that reused the last acceleration instead of running the behaviours */
+	unsigned long long heldSteps;
+
+	/*! Number of boid steps taken asleep, coasting without running the behaviours */
+	unsigned long long sleepingSteps;
+
+	/*! Number of boids reordered along the Morton curve */
+	unsigned long long sortedBoids;
+
+	/*! Seconds spent reordering boids, the cost of mortonSortInterval */
+	double sortSeconds;
+
+	/*! Summed over the flocks reordered, the mean distance between boids next to each other in
+		memory before and after reordering. The drop shows how much closer neighbours were brought */
+	double spacingBefore, spacingAfter;
+
+	/*! Seconds spent running the behaviours. Comparing runs with and without reordering
+		gives its benefit */
+	double behaviourSeconds;
+
+	/*! Number of ghost boids received from neighbouring domains, summed over the steps */
+	unsigned long long ghostBoids;
+
+	/*! Number of boids handed to neighbouring domains after crossing a boundary */
+	unsigned long long migratedBoids;
+
+	/*! Most bytes of scratch memory any one thread's arena held at once during a step */
+	unsigned long long arenaPeak;
+
+	/*! Number of times an arena had to go to the heap for more memory. Zero once the arenas
+		have grown to fit a step */
+	unsigned long long arenaHeapAllocations;
+
+	/*! Bytes held by each subsystem at the end of the update, indexed by MemorySubsystem. The
+		counters are shared by the whole process, so with more than one world these include
+		the memory of the others, and of any renderer or snapshot not tied to a world */
+	unsigned long long memoryBytes[NumMemorySubsystems];
+
+	/*! Number of allocations each subsystem made during the update, indexed by MemorySubsystem.
+		Also process wide, so allocations made by other threads meanwhile are included */
+	unsigned long long memoryAllocations[NumMemorySubsystems];
+};
+
+/*! Counters for the most recent call to Update. Reset at the start of each update */
+Stats stats;
+
+/*! Bytes all the subsystems together may hold at the end of an update before a warning is
+	printed, with a breakdown by subsystem. Checked against stats.memoryBytes, so it budgets
+	the whole process rather than this world alone. Zero never warns */
+unsigned long long memoryBudget;
+
+/*! Set while the memory held is over memoryBudget, so the warning is only printed on crossing it */
+bool overMemoryBudget;
+
 /*! Default empty constructor for the class */
 World();
 
+/*! \brief destructor frees the scratch arenas. The flocks and objects are deleted by Clear */
+~World();
+
+/*! \brief this method runs the update for every flock, subSteps times, and advances the frame count
+	\param target - the goal position the flocks are centring on
+	\return false if the world is split into domains and a neighbour could not be reached. The
+	step is abandoned where it failed, without advancing the frame, and the world should not be
+	stepped again as this domain can no longer see the boids beyond its slab */
+bool Update(Imath::V3f& target);
+
+/*! \brief returns the scratch arena of the calling thread. Only valid during Update */
+Arena& arena();
+
+/*! \brief returns the length in seconds of each step the flocks take */
+float subStepSize() const { return timeStep / subSteps; };
+
+/*! \brief method used to write the current hash of each flock's state to a stream, one line per flock
+	\param out - the stream to write the hashes to */
+void WriteHashes(std::ostream& out) const;
+
+/*! \brief method used to write the memory held by each subsystem, as counted in stats for the
+	last update, one line per subsystem of the form "frame subsystem bytes allocations"
+	\param out - the stream to write the report to */
+void WriteMemoryReport(std::ostream& out) const;
+
+/*! \brief method used to move any moving objects and bring objectTree up to date. Rebuilds the
+	hierarchy if objects have been added or removed, otherwise refits it if any object moved.
+	Called by Update before the flocks are updated */
+void UpdateObjectTree();
+
+/*! \brief method used to bake objectField from the static objects. The field extends
+	as far from each object as the largest object test radius of the flocks using it */
+void BakeObjectField();
+
+/*! \brief this method deletes all the flocks, objects and moving objects in the world and resets the frame count */
+void Clear();
+
+/*! \brief method used to write the full state of the world to a binary checkpoint file
+	\param filename - the path of the checkpoint to write
+	\return false if the file could not be written */
+bool SaveCheckpoint(const std::string& filename) const;
+
+/*! \brief method used to replace the state of the world with a checkpoint written by SaveCheckpoint.
+	Any existing flocks and objects are deleted first.
+	\param filename - the path of the checkpoint to read
+	\return false if the file could not be read or is not a compatible checkpoint */
+bool LoadCheckpoint(const std::string& filename);
+
 /*! \brief this method draws a green ground plane at the base of the box.*/
 void DrawGround();
 